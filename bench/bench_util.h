@@ -0,0 +1,59 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES 1
+#else
+#define BENCH_HAVE_CYCLES 0
+#endif
+
+// Wall clock and (on x86) the TSC around a measured loop
+struct BenchTimer {
+    std::chrono::steady_clock::time_point start;
+    uint64_t startCycles;
+    
+    void begin() {
+        start = std::chrono::steady_clock::now();
+        startCycles = cycles();
+    }
+    
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    uint64_t elapsedCycles() const { return cycles() - startCycles; }
+    
+    static uint64_t cycles() {
+        #if BENCH_HAVE_CYCLES
+        return __rdtsc();
+        #else
+        return 0;
+        #endif
+    }
+};
+
+// Whole file into memory; exits on error
+static inline std::vector<char> readFile(const char* path) {
+    std::vector<char> data;
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(1);
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+#endif // BENCH_UTIL_H
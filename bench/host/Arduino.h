@@ -0,0 +1,49 @@
+#ifndef BENCH_HOST_ARDUINO_H
+#define BENCH_HOST_ARDUINO_H
+
+// Just enough of the Arduino core and FreeRTOS for the benchmarked
+// modules (kv_store.cpp) and the libraries they are compared against
+// (TinyGPSPlus) to build on the host. Serial output is discarded.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+typedef uint8_t byte;
+
+#ifndef PI
+#define PI          3.1415926535897932384626433832795
+#endif
+#define HALF_PI     1.5707963267948966192313216916398
+#define TWO_PI      6.283185307179586476925286766559
+#define DEG_TO_RAD  0.017453292519943295769236907684886
+#define RAD_TO_DEG  57.295779513082320876798154814105
+
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x)        ((x) * (x))
+
+unsigned long millis();
+
+class __FlashStringHelper;
+#define F(s)         (s)
+
+struct HostSerial {
+    template <typename T> void print(const T&, int = 0) {}
+    template <typename T> void println(const T&, int = 0) {}
+    void println() {}
+    void flush() {}
+};
+static HostSerial Serial __attribute__((unused));
+
+// Single-threaded host: the store's recursive mutex is a no-op
+typedef void* SemaphoreHandle_t;
+#define portMAX_DELAY                       0xFFFFFFFFUL
+#define xSemaphoreCreateRecursiveMutex()    ((SemaphoreHandle_t)1)
+#define xSemaphoreTakeRecursive(m, t)       ((void)(m), (void)(t), 1)
+#define xSemaphoreGiveRecursive(m)          ((void)(m), 1)
+
+#endif // BENCH_HOST_ARDUINO_H
@@ -0,0 +1,12 @@
+#ifndef BENCH_HOST_RADIOLIB_H
+#define BENCH_HOST_RADIOLIB_H
+
+// config.h pulls in region.h for its Region:: defaults; the benchmarks
+// never touch the band plans, so declaring them is enough.
+
+struct LoRaWANBand_t {};
+extern const LoRaWANBand_t EU868;
+extern const LoRaWANBand_t US915;
+extern const LoRaWANBand_t AS923;
+
+#endif // BENCH_HOST_RADIOLIB_H
@@ -0,0 +1,334 @@
+// Persistent-state write cost: the KV log (src/kv_store.cpp) against the
+// LittleFS files it replaced, both on the simulated NVMC (nvmc_sim.h).
+// The workload is the tracker's own: a session save per uplink, the last
+// fix every AIDING_EVERY uplinks, link statistics every LINK_STATS_EVERY
+// and a rejoin (nonces + session) every REJOIN_EVERY. Latency is NVMC busy
+// time per save, which on the nRF52840 stalls the CPU. Between uplinks the
+// store gets one maintain() step, as in STATE_SLEEP with the GPS off.
+
+#include "bench_util.h"
+#include "nvmc_sim.h"
+#include "../src/nvs.h"
+
+#if WITH_LITTLEFS
+extern "C" {
+#include "lfs.h"
+}
+#endif
+
+#define DEFAULT_UPLINKS     10000
+#define AIDING_EVERY        10
+#define LINK_STATS_EVERY    16          // LINK_STATS_SAVE_EVERY
+#define REJOIN_EVERY        500
+
+// One persistent store under test
+class Store {
+public:
+    virtual ~Store() {}
+    virtual const char* name() = 0;
+    virtual bool format() = 0;
+    virtual bool remount() = 0;
+    virtual bool save(uint8_t key, const void* data, uint16_t len) = 0;
+    virtual bool saveJoin(const void* nonces, const void* session) = 0;
+    virtual bool load(uint8_t key, void* data, uint16_t len) = 0;
+    virtual void maintain() {}
+};
+
+class KVBackend : public Store {
+public:
+    KVBackend() : store(&kvStore) {}
+    
+    const char* name() { return "KV log"; }
+    bool format() { return store->format(); }
+    
+    bool remount() {
+        // A second instance has only what begin() rebuilds from flash
+        store = &remounted;
+        return remounted.begin();
+    }
+    
+    bool save(uint8_t key, const void* data, uint16_t len) { return store->put(key, data, len); }
+    
+    bool saveJoin(const void* nonces, const void* session) {
+        // One transaction, as LoRaWANModule::join() writes it
+        store->beginBatch();
+        store->put(NVS_KEY_NONCES, nonces, LORAWAN_NONCES_SIZE);
+        store->put(NVS_KEY_SESSION, session, LORAWAN_SESSION_SIZE);
+        return store->commitBatch();
+    }
+    
+    bool load(uint8_t key, void* data, uint16_t len) { return store->get(key, data, len); }
+    void maintain() { store->maintain(); }
+    
+private:
+    KVStore* store;
+    KVStore remounted;
+};
+
+#if WITH_LITTLEFS
+// InternalFS as the Adafruit nRF52 core sets it up: littlefs v1 with
+// 128-byte blocks over a one-page write cache. The cache is erased and
+// reprogrammed as a whole page when it is flushed (sync, or an access to
+// another page), and skipped if the page did not change.
+#define INTERNALFS_BLOCK_SIZE      128
+#define INTERNALFS_BLOCK_COUNT     (NVMC_SIM_PAGES * NVMC_SIM_PAGE_SIZE / INTERNALFS_BLOCK_SIZE)
+
+struct PageCache {
+    int32_t page;
+    uint8_t buf[NVMC_SIM_PAGE_SIZE];
+};
+
+static PageCache cache = { -1, {} };
+
+static uint32_t pageAddr(int32_t page) {
+    return NVMC_SIM_BASE + (uint32_t)page * NVMC_SIM_PAGE_SIZE;
+}
+
+static void cacheFlush() {
+    if (cache.page < 0) return;
+    uint32_t addr = pageAddr(cache.page);
+    if (memcmp(nvmc.ptr(addr), cache.buf, NVMC_SIM_PAGE_SIZE) != 0) {
+        nvmc.erasePage(addr);
+        for (uint32_t i = 0; i < NVMC_SIM_PAGE_SIZE; i += 4) {
+            uint32_t word;
+            memcpy(&word, cache.buf + i, 4);
+            if (word != 0xFFFFFFFF) nvmc.writeWord(addr + i, word);
+        }
+    }
+    cache.page = -1;
+}
+
+static uint8_t* cacheFor(uint32_t addr) {
+    int32_t page = (int32_t)((addr - NVMC_SIM_BASE) / NVMC_SIM_PAGE_SIZE);
+    if (cache.page != page) {
+        cacheFlush();
+        memcpy(cache.buf, nvmc.ptr(pageAddr(page)), NVMC_SIM_PAGE_SIZE);
+        cache.page = page;
+    }
+    return cache.buf + (addr - pageAddr(page));
+}
+
+static uint32_t blockAddr(lfs_block_t block, lfs_off_t off) {
+    return NVMC_SIM_BASE + block * INTERNALFS_BLOCK_SIZE + off;
+}
+
+static int lfsRead(const struct lfs_config*, lfs_block_t block, lfs_off_t off, void* buffer, lfs_size_t size) {
+    uint32_t addr = blockAddr(block, off);
+    int32_t page = (int32_t)((addr - NVMC_SIM_BASE) / NVMC_SIM_PAGE_SIZE);
+    const uint8_t* src = cache.page == page ? cache.buf + (addr - pageAddr(page)) : nvmc.ptr(addr);
+    memcpy(buffer, src, size);
+    return 0;
+}
+
+static int lfsProg(const struct lfs_config*, lfs_block_t block, lfs_off_t off, const void* buffer, lfs_size_t size) {
+    memcpy(cacheFor(blockAddr(block, off)), buffer, size);
+    return 0;
+}
+
+static int lfsErase(const struct lfs_config*, lfs_block_t block) {
+    memset(cacheFor(blockAddr(block, 0)), 0xFF, INTERNALFS_BLOCK_SIZE);
+    return 0;
+}
+
+static int lfsSync(const struct lfs_config*) {
+    cacheFlush();
+    return 0;
+}
+
+class LittleFSBackend : public Store {
+public:
+    LittleFSBackend() {
+        memset(&config, 0, sizeof(config));
+        config.read = lfsRead;
+        config.prog = lfsProg;
+        config.erase = lfsErase;
+        config.sync = lfsSync;
+        config.read_size = INTERNALFS_BLOCK_SIZE;
+        config.prog_size = INTERNALFS_BLOCK_SIZE;
+        config.block_size = INTERNALFS_BLOCK_SIZE;
+        config.block_count = INTERNALFS_BLOCK_COUNT;
+        config.lookahead = 128;
+    }
+    
+    const char* name() { return "LittleFS"; }
+    
+    bool format() {
+        cache.page = -1;
+        if (lfs_format(&lfs, &config) != 0) return false;
+        cacheFlush();
+        return lfs_mount(&lfs, &config) == 0;
+    }
+    
+    bool remount() {
+        lfs_unmount(&lfs);
+        cacheFlush();
+        cache.page = -1;
+        return lfs_mount(&lfs, &config) == 0;
+    }
+    
+    bool save(uint8_t key, const void* data, uint16_t len) {
+        // NVSStorage before the KV store: open for write, seek(0), write, close
+        lfs_file_t file;
+        if (lfs_file_open(&lfs, &file, path(key), LFS_O_RDWR | LFS_O_CREAT) != 0) return false;
+        lfs_file_seek(&lfs, &file, 0, LFS_SEEK_SET);
+        lfs_ssize_t written = lfs_file_write(&lfs, &file, data, len);
+        bool ok = lfs_file_close(&lfs, &file) == 0 && written == len;
+        cacheFlush();       // InternalFS data is on flash once close() returns
+        return ok;
+    }
+    
+    bool saveJoin(const void* nonces, const void* session) {
+        // Two files; a reset in between leaves them out of step
+        return save(NVS_KEY_NONCES, nonces, LORAWAN_NONCES_SIZE) &&
+               save(NVS_KEY_SESSION, session, LORAWAN_SESSION_SIZE);
+    }
+    
+    bool load(uint8_t key, void* data, uint16_t len) {
+        lfs_file_t file;
+        if (lfs_file_open(&lfs, &file, path(key), LFS_O_RDONLY) != 0) return false;
+        lfs_ssize_t read = lfs_file_read(&lfs, &file, data, len);
+        lfs_file_close(&lfs, &file);
+        return read == len;
+    }
+    
+private:
+    lfs_t lfs;
+    struct lfs_config config;
+    
+    static const char* path(uint8_t key) {
+        // NVSStorage's old file names
+        switch (key) {
+            case NVS_KEY_NONCES:    return "/lorawan_nonces";
+            case NVS_KEY_SESSION:   return "/lorawan_session";
+            case NVS_KEY_LASTFIX:   return "/gps_lastfix";
+            case NVS_KEY_LINKSTATS: return "/link_stats";
+            default:                return "/other";
+        }
+    }
+};
+#endif
+
+// Outcome of one store over the workload
+struct KVResult {
+    uint32_t saves;
+    uint64_t busyUs;
+    uint32_t worstUs;
+    uint32_t worstSleepUs;
+    uint32_t erases;
+    uint32_t hottestPage;
+    uint32_t overwrites;
+    bool readback;
+};
+
+template <typename T>
+static void vary(T& value, uint32_t n) {
+    // Change a few bytes per save, as counters and positions do
+    uint8_t* p = (uint8_t*)&value;
+    p[n % sizeof(value)] = (uint8_t)n;
+    p[(n * 7 + 3) % sizeof(value)] ^= (uint8_t)(n >> 3);
+}
+
+static KVResult run(Store& store, uint32_t uplinks) {
+    KVResult r;
+    memset(&r, 0, sizeof(r));
+    nvmc.reset();
+    if (!store.format()) {
+        fprintf(stderr, "%s: format failed\n", store.name());
+        exit(1);
+    }
+    uint64_t formatUs = nvmc.stats().busyUs;
+    uint32_t formatErases = nvmc.stats().erases;
+    
+    struct { uint8_t b[LORAWAN_NONCES_SIZE]; } nonces;
+    struct { uint8_t b[LORAWAN_SESSION_SIZE]; } session;
+    GPSFixRecord fix;
+    LinkStatsRecord linkStats;
+    memset(&nonces, 0x11, sizeof(nonces));
+    memset(&session, 0x22, sizeof(session));
+    memset(&fix, 0x33, sizeof(fix));
+    memset(&linkStats, 0, sizeof(linkStats));
+    
+    bool ok = true;
+    for (uint32_t n = 0; n < uplinks; n++) {
+        uint64_t before = nvmc.stats().busyUs;
+        if (n % REJOIN_EVERY == 0) {
+            vary(nonces, n);
+            vary(session, n);
+            ok &= store.saveJoin(&nonces, &session);
+        } else {
+            vary(session, n);
+            ok &= store.save(NVS_KEY_SESSION, &session, sizeof(session));
+        }
+        uint32_t spent = (uint32_t)(nvmc.stats().busyUs - before);
+        r.saves++;
+        
+        if (n % AIDING_EVERY == 0) {
+            before = nvmc.stats().busyUs;
+            vary(fix, n);
+            ok &= store.save(NVS_KEY_LASTFIX, &fix, sizeof(fix));
+            spent += (uint32_t)(nvmc.stats().busyUs - before);
+            r.saves++;
+        }
+        if (n % LINK_STATS_EVERY == 0) {
+            before = nvmc.stats().busyUs;
+            vary(linkStats, n);
+            ok &= store.save(NVS_KEY_LINKSTATS, &linkStats, sizeof(linkStats));
+            spent += (uint32_t)(nvmc.stats().busyUs - before);
+            r.saves++;
+        }
+        
+        // Worst case of one uplink's worth of saves
+        if (spent > r.worstUs) r.worstUs = spent;
+        
+        before = nvmc.stats().busyUs;
+        store.maintain();
+        spent = (uint32_t)(nvmc.stats().busyUs - before);
+        if (spent > r.worstSleepUs) r.worstSleepUs = spent;
+    }
+    
+    r.busyUs = nvmc.stats().busyUs - formatUs;
+    r.erases = nvmc.stats().erases - formatErases;
+    r.hottestPage = nvmc.maxPageErases();
+    r.overwrites = nvmc.stats().overwrites;
+    
+    // What a reset would find
+    ok &= store.remount();
+    struct { uint8_t b[LORAWAN_SESSION_SIZE]; } sessionBack;
+    GPSFixRecord fixBack;
+    ok &= store.load(NVS_KEY_SESSION, &sessionBack, sizeof(sessionBack)) &&
+          memcmp(&sessionBack, &session, sizeof(session)) == 0;
+    ok &= store.load(NVS_KEY_LASTFIX, &fixBack, sizeof(fixBack)) &&
+          memcmp(&fixBack, &fix, sizeof(fix)) == 0;
+    r.readback = ok;
+    return r;
+}
+
+static void print(const char* name, const KVResult& r) {
+    printf("%-10s %7u %10.1f %9.2f %9.1f %9.1f %8u %9.1f %8u %9s\n", name, r.saves,
+           r.busyUs / 1000.0, r.busyUs / 1000.0 / r.saves, r.worstUs / 1000.0, r.worstSleepUs / 1000.0,
+           r.erases, r.erases * 1000.0 / r.saves, r.hottestPage,
+           r.readback ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+    uint32_t uplinks = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : DEFAULT_UPLINKS;
+    
+    printf("%u uplinks: session each, last fix every %u, link stats every %u, rejoin every %u\n",
+           uplinks, AIDING_EVERY, LINK_STATS_EVERY, REJOIN_EVERY);
+    printf("NVMC: %u us per word, %u ms per page erase\n\n",
+           NVMC_SIM_WRITE_US, NVMC_SIM_ERASE_US / 1000);
+    printf("%-10s %7s %10s %9s %9s %9s %8s %9s %8s %9s\n",
+           "store", "saves", "flash ms", "ms/save", "worst ms", "sleep ms", "erases", "per 1k", "hot page", "readback");
+    
+    KVBackend kv;
+    KVResult kvResult = run(kv, uplinks);
+    print(kv.name(), kvResult);
+    
+    #if WITH_LITTLEFS
+    LittleFSBackend lfs;
+    KVResult lfsResult = run(lfs, uplinks);
+    print(lfs.name(), lfsResult);
+    #endif
+    
+    return kvResult.readback ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// NMEA parser throughput: src/nmea.cpp against TinyGPSPlus on a logged
+// L76K stream. Both parsers see the same bytes, one at a time, as the
+// UART path feeds them; the log is replayed until each run takes at
+// least MIN_RUN_S so the figures are stable.
+
+#include "bench_util.h"
+#include "../src/nmea.h"
+
+#if WITH_TINYGPSPLUS
+#include <TinyGPS++.h>
+
+unsigned long millis() {
+    using namespace std::chrono;
+    return (unsigned long)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define MIN_RUN_S       0.5
+
+// Outcome of one parser over the log
+struct ParseResult {
+    const char* name;
+    double seconds;
+    uint64_t cycles;
+    uint32_t passes;
+    uint32_t committed;         // encode() returned true (first pass)
+    uint32_t failed;            // Checksum failures (first pass)
+    double lat;
+    double lon;
+};
+
+struct OurParser {
+    NMEAParser parser;
+    
+    bool encode(char c) { return parser.encode(c); }
+    uint32_t failed() { return parser.stats().failed; }
+    double lat() { return parser.fix().latitude / 1e7; }
+    double lon() { return parser.fix().longitude / 1e7; }
+};
+
+#if WITH_TINYGPSPLUS
+struct TinyParser {
+    TinyGPSPlus parser;
+    
+    bool encode(char c) { return parser.encode(c); }
+    uint32_t failed() { return parser.failedChecksum(); }
+    double lat() { return parser.location.lat(); }
+    double lon() { return parser.location.lng(); }
+};
+#endif
+
+template <typename P>
+static ParseResult run(const char* name, const std::vector<char>& log) {
+    ParseResult r;
+    r.name = name;
+    
+    // First pass on a fresh parser for the correctness columns
+    {
+        P p;
+        uint32_t committed = 0;
+        for (char c : log) {
+            if (p.encode(c)) committed++;
+        }
+        r.committed = committed;
+        r.failed = p.failed();
+        r.lat = p.lat();
+        r.lon = p.lon();
+    }
+    
+    // Timed passes; the sink keeps the loop from being optimised away
+    P p;
+    volatile uint32_t sink = 0;
+    BenchTimer timer;
+    timer.begin();
+    r.passes = 0;
+    do {
+        uint32_t committed = 0;
+        for (char c : log) {
+            committed += p.encode(c);
+        }
+        sink = sink + committed;
+        r.passes++;
+    } while (timer.seconds() < MIN_RUN_S);
+    r.cycles = timer.elapsedCycles();
+    r.seconds = timer.seconds();
+    return r;
+}
+
+static void print(const ParseResult& r, size_t bytes, uint32_t sentences) {
+    double totalSentences = (double)sentences * r.passes;
+    printf("%-12s %10.2f %12.1f", r.name,
+           bytes * (double)r.passes / r.seconds / 1e6,
+           r.seconds * 1e9 / totalSentences);
+    if (BENCH_HAVE_CYCLES) {
+        printf(" %12.0f", r.cycles / totalSentences);
+    } else {
+        printf(" %12s", "n/a");
+    }
+    printf(" %9u %7u  %.6f, %.6f\n", r.committed, r.failed, r.lat, r.lon);
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "data/l76k_drive.nmea";
+    std::vector<char> log = readFile(path);
+    
+    uint32_t sentences = 0;
+    for (char c : log) {
+        if (c == '$') sentences++;
+    }
+    
+    printf("%s: %zu bytes, %u sentences\n\n", path, log.size(), sentences);
+    printf("%-12s %10s %12s %12s %9s %7s  %s\n",
+           "parser", "MB/s", "ns/sentence", "cyc/sentence", "committed", "badsum", "last position");
+    
+    print(run<OurParser>("nmea.cpp", log), log.size(), sentences);
+    #if WITH_TINYGPSPLUS
+    print(run<TinyParser>("TinyGPSPlus", log), log.size(), sentences);
+    #endif
+    
+    return 0;
+}
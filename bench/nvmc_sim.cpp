@@ -0,0 +1,79 @@
+#include "nvmc_sim.h"
+#include "../src/kv_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+NVMCSim nvmc;
+
+NVMCSim::NVMCSim() {
+    reset();
+}
+
+void NVMCSim::reset() {
+    memset(mem, 0xFF, sizeof(mem));
+    memset(&counters, 0, sizeof(counters));
+}
+
+uint32_t NVMCSim::offset(uint32_t addr, uint32_t len) {
+    // Outside the region is a bug in the store, not a measurement
+    if (addr < NVMC_SIM_BASE || addr + len > NVMC_SIM_BASE + sizeof(mem)) {
+        fprintf(stderr, "NVMC access outside the region: 0x%05X\n", (unsigned)addr);
+        abort();
+    }
+    return addr - NVMC_SIM_BASE;
+}
+
+const uint8_t* NVMCSim::ptr(uint32_t addr) {
+    return (const uint8_t*)mem + offset(addr, 0);
+}
+
+void NVMCSim::writeWord(uint32_t addr, uint32_t word) {
+    uint32_t off = offset(addr, 4);
+    if (off & 3) {
+        fprintf(stderr, "NVMC unaligned write: 0x%05X\n", (unsigned)addr);
+        abort();
+    }
+    
+    uint32_t& cell = mem[off / 4];
+    if (cell != 0xFFFFFFFF) counters.overwrites++;
+    cell &= word;
+    counters.words++;
+    counters.busyUs += NVMC_SIM_WRITE_US;
+}
+
+void NVMCSim::erasePage(uint32_t addr) {
+    uint32_t page = offset(addr, 0) / NVMC_SIM_PAGE_SIZE;
+    memset(&mem[page * NVMC_SIM_PAGE_SIZE / 4], 0xFF, NVMC_SIM_PAGE_SIZE);
+    counters.erases++;
+    counters.pageErases[page]++;
+    counters.busyUs += NVMC_SIM_ERASE_US;
+}
+
+uint32_t NVMCSim::maxPageErases() const {
+    uint32_t most = 0;
+    for (uint8_t p = 0; p < NVMC_SIM_PAGES; p++) {
+        if (counters.pageErases[p] > most) most = counters.pageErases[p];
+    }
+    return most;
+}
+
+// KVStore's flash backend (kv_store.cpp leaves these out under KV_FLASH_SIM)
+
+const uint8_t* kvFlashSimPtr(uint32_t addr) {
+    return nvmc.ptr(addr);
+}
+
+void KVStore::program(uint32_t addr, const uint8_t* data, uint32_t len) {
+    // Same word loop as the NVMC version, trailing bytes left erased
+    for (uint32_t i = 0; i < len; i += 4) {
+        uint32_t word = 0xFFFFFFFF;
+        memcpy(&word, data + i, len - i < 4 ? len - i : 4);
+        nvmc.writeWord(addr + i, word);
+    }
+}
+
+void KVStore::erasePage(uint32_t addr) {
+    nvmc.erasePage(addr);
+    stats.pageErases++;
+}
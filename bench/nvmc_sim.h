@@ -0,0 +1,49 @@
+#ifndef NVMC_SIM_H
+#define NVMC_SIM_H
+
+#include <stdint.h>
+
+// Simulated nRF52840 NVMC over the seven pages at 0xED000 that the KV
+// store (and InternalFS before it) owns. Programming ANDs a word into
+// the array like NOR flash does, erasing sets a page to 0xFF. Every
+// operation is charged its datasheet worst case, so a save's latency is
+// the time the CPU would stall on the real part.
+#define NVMC_SIM_BASE           0xED000
+#define NVMC_SIM_PAGE_SIZE      4096
+#define NVMC_SIM_PAGES          7
+#define NVMC_SIM_WRITE_US       41          // tWRITE, one 32-bit word
+#define NVMC_SIM_ERASE_US       85000       // tERASEPAGE
+
+struct NVMCSimStats {
+    uint64_t busyUs;            // Time the NVMC was busy
+    uint32_t words;             // Words programmed
+    uint32_t overwrites;        // Words programmed that were not erased first
+    uint32_t erases;            // Page erases
+    uint32_t pageErases[NVMC_SIM_PAGES];
+};
+
+class NVMCSim {
+public:
+    NVMCSim();
+    
+    // Whole region back to erased, counters cleared
+    void reset();
+    
+    const uint8_t* ptr(uint32_t addr);
+    void writeWord(uint32_t addr, uint32_t word);
+    void erasePage(uint32_t addr);
+    
+    const NVMCSimStats& stats() const { return counters; }
+    uint32_t maxPageErases() const;
+    
+private:
+    uint32_t mem[NVMC_SIM_PAGES * NVMC_SIM_PAGE_SIZE / 4];
+    NVMCSimStats counters;
+    
+    uint32_t offset(uint32_t addr, uint32_t len);
+};
+
+// The one simulated part the benchmarked stores run on
+extern NVMCSim nvmc;
+
+#endif // NVMC_SIM_H
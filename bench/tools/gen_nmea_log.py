@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Write an L76K-style NMEA log for the parser benchmark.
+
+Same layout as the module's output with the tracker's PMTK314 setting:
+one burst per second of GNGGA, GNRMC, two GNGSA, GPGSV and GLGSV
+groups, CRLF line endings. The first 30 s have no fix (empty position
+fields, as during acquisition), then the track drives a loop around
+a fixed origin. A few sentences carry a bad checksum, as a noisy UART
+line would. The output is deterministic, so results stay comparable.
+"""
+
+import math
+import random
+import sys
+
+SECONDS = 300
+NO_FIX_S = 30
+ORIGIN_LAT = 52.370216
+ORIGIN_LON = 4.895168
+BAD_CHECKSUM_EVERY = 97
+
+
+def checksum(body):
+    c = 0
+    for ch in body.encode("ascii"):
+        c ^= ch
+    return c
+
+
+def sentence(body, corrupt=False):
+    c = checksum(body)
+    if corrupt:
+        c ^= 0x5A
+    return "$%s*%02X\r\n" % (body, c)
+
+
+def ddmm(value, lat):
+    hemi = ("N" if value >= 0 else "S") if lat else ("E" if value >= 0 else "W")
+    value = abs(value)
+    deg = int(value)
+    minutes = (value - deg) * 60
+    width = 2 if lat else 3
+    return "%0*d%08.5f" % (width, deg, minutes), hemi
+
+
+def gsv(talker, sats, rng):
+    out = []
+    groups = (len(sats) + 3) // 4
+    for g in range(groups):
+        fields = ["%sGSV" % talker, str(groups), str(g + 1), "%02d" % len(sats)]
+        for prn, elev, azim in sats[g * 4:g * 4 + 4]:
+            snr = rng.randint(18, 45)
+            fields += ["%02d" % prn, "%02d" % elev, "%03d" % azim, "%02d" % snr]
+        out.append(",".join(fields) + ",1")
+    return out
+
+
+def main(path):
+    rng = random.Random(2024)
+    gps_sats = [(prn, rng.randint(10, 85), rng.randint(0, 359)) for prn in (2, 5, 12, 13, 15, 18, 20, 24, 25, 29)]
+    glo_sats = [(prn, rng.randint(10, 85), rng.randint(0, 359)) for prn in (65, 66, 72, 73, 80, 81)]
+    lines = []
+    index = 0
+    lat, lon = ORIGIN_LAT, ORIGIN_LON
+    heading = 0.0
+    speed_kn = 0.0
+
+    for t in range(SECONDS):
+        hh, mm, ss = 10 + (t // 3600), (t // 60) % 60, t % 60
+        utc = "%02d%02d%02d.000" % (hh, mm, ss)
+        date = "150324"
+        fix = t >= NO_FIX_S
+
+        if fix:
+            # Loop of about 2 km at 20-50 km/h with a stop in the middle
+            phase = (t - NO_FIX_S) / float(SECONDS - NO_FIX_S)
+            stopped = 0.45 < phase < 0.55
+            speed_kn = 0.0 if stopped else 15.0 + 10.0 * math.sin(phase * 6.0)
+            heading = (phase * 360.0) % 360.0
+            dist = speed_kn * 0.514444
+            lat += dist * math.cos(math.radians(heading)) / 111320.0
+            lon += dist * math.sin(math.radians(heading)) / (111320.0 * math.cos(math.radians(lat)))
+            la, ns = ddmm(lat, True)
+            lo, ew = ddmm(lon, False)
+            used = 8 + rng.randint(0, 4)
+            hdop = 0.8 + rng.random() * 0.8
+            alt = 2.0 + rng.random() * 4.0
+            gga = "GNGGA,%s,%s,%s,%s,%s,1,%02d,%.2f,%.1f,M,46.9,M,," % (utc, la, ns, lo, ew, used, hdop, alt)
+            rmc = "GNRMC,%s,A,%s,%s,%s,%s,%.2f,%.2f,%s,,,A,V" % (utc, la, ns, lo, ew, speed_kn, heading, date)
+            gsa_gps = "GNGSA,A,3,02,05,12,13,15,18,20,24,,,,,%.2f,%.2f,1.20,1" % (hdop + 0.4, hdop)
+            gsa_glo = "GNGSA,A,3,65,66,72,73,,,,,,,,,%.2f,%.2f,1.20,2" % (hdop + 0.4, hdop)
+        else:
+            gga = "GNGGA,%s,,,,,0,00,25.5,,,,,," % utc
+            rmc = "GNRMC,%s,V,,,,,,,%s,,,N,V" % (utc, date)
+            gsa_gps = "GNGSA,A,1,,,,,,,,,,,,,25.5,25.5,25.5,1"
+            gsa_glo = "GNGSA,A,1,,,,,,,,,,,,,25.5,25.5,25.5,2"
+
+        burst = [gga, rmc, gsa_gps, gsa_glo] + gsv("GP", gps_sats, rng) + gsv("GL", glo_sats, rng)
+        for body in burst:
+            index += 1
+            lines.append(sentence(body, corrupt=(index % BAD_CHECKSUM_EVERY == 0)))
+
+    with open(path, "w", newline="") as f:
+        f.writelines(lines)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1] if len(sys.argv) > 1 else "data/l76k_drive.nmea")
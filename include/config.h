@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "../src/region.h"     // LORAWAN_DATARATE, JOIN_DR_* etc. expand to Region:: traits
 
 // ============================================
 // TTN LoRaWAN Configuration (OTAA)
@@ -68,40 +69,156 @@ uint8_t nwkKey[16] = {
 
 #define TTNMAPPER_PORT      1          // LoRaWAN uplink port
 
+// Batch mode: several fixes per uplink on BATCH_PORT (not a TTNMapper frame)
+#define BATCH_MODE          false      // true = queue fixes and send delta-encoded batches
+#define BATCH_PORT          2          // LoRaWAN port for batch frames
+#define BATCH_POINTS        8          // Send once this many fixes are queued (max 16)
+
+// Store-and-forward queue on the QSPI flash for fixes that failed to send
+#define FLASH_QUEUE_ENABLED         true
+#define FLASH_QUEUE_SECTORS         256       // 4 KB sectors used (1 MB, 32768 fixes)
+#define FLASH_QUEUE_PORT            3         // LoRaWAN port for replayed fixes
+#define FLASH_QUEUE_DRAIN_UPLINKS   2         // Confirmed replay uplinks per cycle
+#define FLASH_QUEUE_CONFIRMED_PER_DAY 4       // Replays per 24 h (each costs one of TTN's 10 downlinks)
+
 // ============================================
 // Transmission Settings
 // ============================================
 #define TX_INTERVAL_MS      (60 * 1000)       // 60 seconds for testing
 #define GPS_FIX_TIMEOUT_MS  15000             // 15 seconds for testing
 #define MIN_SATELLITES      4                 // Minimum satellites for valid fix
+#define TX_SLOT_ALIGN       true              // Start cycles on UTC multiples of TX_INTERVAL_MS
+
+// Adaptive reporting interval (RMC speed/course and displacement, see adaptive_interval.h)
+#define INTERVAL_ADAPTIVE           true      // false = fixed TX_INTERVAL_MS
+#define INTERVAL_MIN_MS             (20 * 1000UL)       // Fastest cycle (airtime budget still applies)
+#define INTERVAL_MAX_MS             (15 * 60 * 1000UL)  // Slowest cycle, when standing still
+#define INTERVAL_SPACING_M          250       // Target distance between reported points
+#define INTERVAL_MIN_DISPLACEMENT_M 50        // Fixes closer than this to the last report are not sent
+#define INTERVAL_MAX_SUPPRESSED     10        // Send anyway after this many suppressed fixes
+#define INTERVAL_MIN_SPEED_KMH      3.0f      // Below this the RMC speed is treated as noise
+#define INTERVAL_TURN_DEG           45.0f     // Heading change that halves the next interval
+
+// Fix acceptance (ConvergencePolicy); HDOP values are HDOP * 100
+#define FIX_POLICY_CONVERGENCE  true          // false = accept first fix with MIN_SATELLITES
+#define FIX_MAX_HDOP            500           // Hard floor: epochs above this are ignored
+#define FIX_TARGET_HDOP         150           // Accept immediately at or below this...
+#define FIX_TARGET_SATELLITES   6             // ...with at least this many satellites...
+#define FIX_TARGET_JITTER_M     10.0f         // ...and positions within this radius
+#define FIX_MIN_SAMPLES         3             // Epochs needed before judging jitter
+#define FIX_STALL_SAMPLES       4             // Epochs without HDOP improvement = converged
+#define FIX_HDOP_EPSILON        10            // Smallest HDOP change counted as improvement
+#define FIX_MAX_JITTER_M        25.0f         // Jitter allowed when accepting a converged fix
 
 // LoRaWAN settings
-#define LORAWAN_DATARATE    5                 // SF7BW125 (fastest for EU868)
-#define LORAWAN_TX_POWER    14                // dBm (max for EU868)
+// Region (band plan, DR table, duty cycle) comes from the REGION_* build flag, see region.h
+#define LORAWAN_DATARATE    Region::drDefault       // Fastest 125 kHz DR (SF7 in EU868/AS923)
+#define LORAWAN_TX_POWER    Region::txPowerDefault  // dBm (14 in EU868)
 #define LORAWAN_CONFIRMED   false             // Use unconfirmed uplinks for TTNMapper
+#define LORAWAN_ADR         true              // Let the network tune DR and TX power
+
+// Piggy-backed MAC requests (answered in the downlink, no extra uplink)
+#define LORAWAN_LINK_CHECK_INTERVAL_MS  (6*60*60*1000UL)  // LinkCheckReq after an answer (0 = off)
+#define LORAWAN_DEVICE_TIME_INTERVAL_MS (60*60*1000UL)    // Min time between DeviceTimeReqs (0 = off)
+#define LORAWAN_MAC_RETRY_MS            (15*60*1000UL)    // Unanswered: retry after this, doubling up to the interval
+#define LORAWAN_MAC_REQUESTS_PER_DAY    4                 // Uplinks carrying requests per 24 h (TTN: 10 downlinks/day)
+#define LORAWAN_DEVICE_TIME_ACCURACY_MS 100   // Assumed DeviceTimeAns error; asked when the RTC is worse
+
+// Link statistics per channel (persisted; 'l' on the serial console dumps them)
+#define LINK_STATS_ENABLED      true
+#define LINK_STATS_SAVE_EVERY   16            // Uplinks between NVS writes
+
+// Airtime budget (TTN fair use: 30 s time-on-air per rolling 24 h)
+#define AIRTIME_DAILY_BUDGET_MS 30000
+
+// Uplink engine
+#define LORA_TASK_STACK     1024              // Uplink task stack (words)
+#define LORA_HAL_YIELD_MS   5                 // Longest sleep per RadioLib yield() while waiting on DIO1
+#define LORA_UPLINK_TIMEOUT_MS 30000          // Upper bound for one async uplink (incl. duty-cycle wait)
+
+// Persistent storage (KV log in internal flash, see kv_store.h)
+#define NVS_MIGRATE_LITTLEFS    true          // Copy the old LittleFS files on the first boot
+
+// Session persistence (skip OTAA join after reboot)
+#define SESSION_RESTORE         true          // Restore the saved session at boot
+#define SESSION_SAVE_INTERVAL   1             // Save every N uplinks (FCntUp must not go back)
+#define SESSION_VERIFY_UPLINKS  3             // Confirmed uplinks without ACK before rejoining
 
-// Join retry settings
-#define JOIN_RETRY_INTERVAL 120000            // 2 minutes between join attempts (preserves gateway duty cycle)
-#define MAX_JOIN_RETRIES    10                // Maximum join attempts before reset
+// Join schedule (randomised exponential backoff, persisted across resets)
+#define JOIN_DR_FAST        Region::drDefault // DR for even attempts (SF7 in EU868)
+#define JOIN_DR_ROBUST      Region::drRobust  // Odd attempts sweep down to this DR (SF12 in EU868)
+#define JOIN_BACKOFF_BASE_MS    15000         // Backoff after the first failure
+#define JOIN_BACKOFF_MAX_MS     3600000       // Backoff ceiling (1 hour)
 
 // ============================================
 // GPS Settings
 // ============================================
 #define GPS_BAUD_RATE       9600
 #define GPS_UPDATE_RATE     1000              // 1 Hz update rate
+#define GPS_ACQ_BAUD_RATE   115200            // Baud rate for the acquisition profile
+#define GPS_ACQ_PROFILE     true              // Use GGA+RMC @ 115200 while waiting for a fix
+
+// Hot-start aiding (last fix + UTC injected with PMTK741 on wakeup)
+#define GPS_AIDING_ENABLED          true
+#define GPS_AIDING_SAVE_DISTANCE_M  1000      // Re-save last fix after moving this far
+#define GPS_AIDING_SAVE_INTERVAL_S  3600      // ...or after this long
+
+// Constellation selection (PMTK353), learned from TTFF per set
+#define CONSTELLATION_LEARNING      true      // false = always GPS+GLONASS
+#define CONSTELLATION_MIN_TRIALS    3         // Attempts per set before trusting its stats
+#define CONSTELLATION_EXPLORE_PCT   10        // Chance of trying a non-best set
+#define CONSTELLATION_REGION_KM     300       // Relearn after moving this far
+#define CONSTELLATION_SAVE_EVERY    8         // Updates between NVS writes
+#define CONSTELLATION_TIMEOUT_PENALTY 2       // A timeout costs this many times its duration
 
 // ============================================
 // Power Management
 // ============================================
+// GPS power-state cost model (L76K currents in uA, TTFF in ms)
+#define GPS_CURRENT_ACQ_UA      41000         // Acquisition / tracking
+#define GPS_CURRENT_STANDBY_UA  1000          // PMTK161 standby
+#define GPS_CURRENT_BACKUP_UA   20            // PMTK225,4 backup (RTC + backup RAM)
+#define GPS_TTFF_STANDBY_MS     1000          // PMTK161 standby, ephemeris valid (tracking state kept)
+#define GPS_TTFF_HOT_MS         2000          // PMTK225 backup, ephemeris still valid
+#define GPS_TTFF_WARM_MS        25000         // Time + almanac known, ephemeris stale
+#define GPS_TTFF_COLD_MS        35000         // Nothing retained
+#define GPS_EPHEMERIS_VALID_S   7200          // Broadcast ephemeris usable for a hot start
+#define POWER_DCDC_REG0     false             // REG0 DC/DC (only used when powered from VDDH)
+#define POWER_DCDC_REG1     true              // REG1 DC/DC (needs the DCC inductor)
+#define POWER_RAIL_SETTLE_MS 5                // 3V3 rail rise time after PIN_POWER_EN
+#define POWER_LOG_STATS     true              // Print per-domain on-time every sleep
 #define ENABLE_DEEP_SLEEP   true              // Use deep sleep between transmissions
 #define BATTERY_CHECK       true              // Include battery voltage in payload
 
+// Sleep service (System ON between cycles)
+#define SLEEP_WAKE_BUTTON   true              // User button ends a sleep and shows the status screen
+#define SYSTEM_OFF_ENABLED  true              // Power down through long sleeps, woken by the PCF8563
+#define SYSTEM_OFF_MIN_MS   (10 * 60 * 1000UL) // Shorter sleeps stay in System ON
+#define EXT_RTC_BOOT_UNCERTAINTY_MS 10000     // Assumed PCF8563 error when it seeds the timebase at boot
+
+// Motion detection (BMP280 pressure trend)
+#define MOTION_ENABLED              true
+#define MOTION_SAMPLE_INTERVAL_MS   30000     // Pressure sample period while sleeping
+#define MOTION_THRESHOLD_PA         12        // ~1 m of elevation change
+#define MOTION_STATIONARY_SAMPLES   10        // Quiet samples before declaring stationary
+#define MOTION_STATIONARY_REUSE     true      // true = resend last fix, false = skip cycle
+#define MOTION_MAX_SKIPPED          10        // Force a real fix after this many stationary cycles
+
 // ============================================
 // Display Settings
 // ============================================
 #define DISPLAY_ENABLED     true              // Enable e-paper display updates
 #define DISPLAY_ROTATION    3                 // 0, 1, 2, or 3 (90° increments) - 3 = 90° left
 
+// ============================================
+// Task Pipeline (stack sizes in words)
+// ============================================
+#define GPS_TASK_STACK          1024          // Fix acquisition (NMEA parsing, fix policy)
+#define DISPLAY_TASK_STACK      1024          // E-paper refresh (GFX text rendering)
+#define STORAGE_TASK_STACK      768           // QSPI flash queue writes
+#define PIPELINE_STORAGE_WAIT_MS 2000         // Max wait for pending flash writes before a replay
+#define TASK_LOG_STATS          true          // Log stack high-water marks and busy time before each sleep
+
 // ============================================
 // Debug Settings
 // ============================================
@@ -0,0 +1,96 @@
+#include "adaptive_interval.h"
+#include "../include/config.h"
+
+AdaptiveInterval adaptiveInterval;
+
+#define EARTH_RADIUS_M      6371000.0
+
+AdaptiveInterval::AdaptiveInterval() {
+    memset(&state, 0, sizeof(state));
+    state.speedKmh = -1.0f;
+}
+
+double AdaptiveInterval::distanceM(double lat1, double lon1, double lat2, double lon2) {
+    // Haversine: stays accurate down to the metre-level thresholds used here
+    double dLat = (lat2 - lat1) * DEG_TO_RAD;
+    double dLon = (lon2 - lon1) * DEG_TO_RAD;
+    double a = sin(dLat / 2) * sin(dLat / 2) +
+               cos(lat1 * DEG_TO_RAD) * cos(lat2 * DEG_TO_RAD) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * EARTH_RADIUS_M * atan2(sqrt(a), sqrt(1 - a));
+}
+
+float AdaptiveInterval::headingChange(float from, float to) {
+    float d = fabsf(to - from);
+    return d > 180.0f ? 360.0f - d : d;
+}
+
+bool AdaptiveInterval::update(const GPSData& fix) {
+    // Smooth over two fixes: one slow fix (traffic light) only halves the estimate
+    if (fix.speed >= 0) {
+        state.speedKmh = state.speedKmh < 0 ? (float)fix.speed : (state.speedKmh + (float)fix.speed) / 2;
+    }
+    
+    if (!state.hasReport) return true;
+    
+    // RMC course is noise while standing still
+    bool moving = fix.speed >= INTERVAL_MIN_SPEED_KMH;
+    state.turned = moving && headingChange(state.reportCourse, (float)fix.course) >= INTERVAL_TURN_DEG;
+    
+    double moved = distanceM(state.reportLat, state.reportLon, fix.latitude, fix.longitude);
+    if (moved >= INTERVAL_MIN_DISPLACEMENT_M || state.suppressed >= INTERVAL_MAX_SUPPRESSED) {
+        return true;
+    }
+    
+    state.suppressed++;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Interval] Moved "));
+    Serial.print((uint32_t)moved);
+    Serial.print(F(" m since the last report, suppressed ("));
+    Serial.print(state.suppressed);
+    Serial.print(F("/"));
+    Serial.print(INTERVAL_MAX_SUPPRESSED);
+    Serial.println(F(")"));
+    #endif
+    
+    return false;
+}
+
+void AdaptiveInterval::markReported(const GPSData& fix) {
+    state.reportLat = fix.latitude;
+    state.reportLon = fix.longitude;
+    if (fix.speed >= INTERVAL_MIN_SPEED_KMH) {
+        state.reportCourse = (float)fix.course;
+    }
+    state.hasReport = true;
+    state.suppressed = 0;
+}
+
+uint32_t AdaptiveInterval::nextInterval() {
+    if (state.speedKmh < 0) return TX_INTERVAL_MS;
+    
+    // Time to cover the spacing: m / (km/h) * 3600 = ms
+    uint32_t interval = INTERVAL_MAX_MS;
+    if (state.speedKmh >= INTERVAL_MIN_SPEED_KMH) {
+        float ms = INTERVAL_SPACING_M * 3600.0f / state.speedKmh;
+        interval = ms < INTERVAL_MAX_MS ? (uint32_t)ms : INTERVAL_MAX_MS;
+    }
+    if (state.turned) {
+        interval /= 2;
+    }
+    if (interval < INTERVAL_MIN_MS) {
+        interval = INTERVAL_MIN_MS;
+    }
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Interval] Speed "));
+    Serial.print(state.speedKmh, 1);
+    Serial.print(F(" km/h"));
+    if (state.turned) Serial.print(F(", turned"));
+    Serial.print(F(" -> "));
+    Serial.print(interval / 1000);
+    Serial.println(F(" s"));
+    #endif
+    
+    return interval;
+}
@@ -0,0 +1,57 @@
+#ifndef ADAPTIVE_INTERVAL_H
+#define ADAPTIVE_INTERVAL_H
+
+#include <Arduino.h>
+#include "gps.h"
+
+// Controller state carried across a System OFF power-down (see checkpoint.h)
+struct IntervalRecord {
+    float speedKmh;                 // EWMA of RMC speed, negative until known
+    bool turned;                    // Heading changed since the last report
+    bool hasReport;
+    double reportLat;               // Last reported point
+    double reportLon;
+    float reportCourse;
+    uint16_t suppressed;            // Fixes not sent since the last report
+};
+
+// Reporting interval from speed and displacement.
+// The interval is the time to cover INTERVAL_SPACING_M at the smoothed RMC
+// speed, clamped to INTERVAL_MIN_MS..INTERVAL_MAX_MS, and halved after a
+// heading change of INTERVAL_TURN_DEG so corners get a point. A fresh fix
+// closer than INTERVAL_MIN_DISPLACEMENT_M to the last reported point is
+// not sent (at most INTERVAL_MAX_SUPPRESSED times in a row). The airtime
+// ledger still stretches the result when the budget requires it.
+class AdaptiveInterval {
+public:
+    AdaptiveInterval();
+    
+    // Feed a fresh fix; false if it adds nothing to the map
+    bool update(const GPSData& fix);
+    
+    // A fix went to the radio or the store-and-forward queue
+    void markReported(const GPSData& fix);
+    
+    // Interval until the next cycle (TX_INTERVAL_MS while the speed is unknown)
+    uint32_t nextInterval();
+    
+    float getSpeedKmh() { return state.speedKmh; }
+    uint16_t getSuppressed() { return state.suppressed; }
+    
+    // Great-circle distance in metres
+    static double distanceM(double lat1, double lon1, double lat2, double lon2);
+    
+    // Carry the state over a System OFF power-down
+    void save(IntervalRecord& record) { record = state; }
+    void restore(const IntervalRecord& record) { state = record; }
+    
+private:
+    IntervalRecord state;
+    
+    static float headingChange(float from, float to);
+};
+
+// Global adaptive interval instance
+extern AdaptiveInterval adaptiveInterval;
+
+#endif // ADAPTIVE_INTERVAL_H
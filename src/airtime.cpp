@@ -0,0 +1,120 @@
+#include "airtime.h"
+#include "timebase.h"
+#include "region.h"
+#include "../include/config.h"
+
+#define MS_PER_HOUR     3600000UL
+#define MS_PER_DAY      (24 * MS_PER_HOUR)
+
+// LoRaWAN MAC overhead: MHDR + FHDR (no FOpts) + FPort + MIC
+#define LORAWAN_PHY_OVERHEAD    13
+
+AirtimeLedger::AirtimeLedger() : clockOffsetMs(0) {
+    for (uint8_t i = 0; i < AIRTIME_BUCKETS; i++) {
+        bucketHour[i] = 0xFFFFFFFF;
+        bucketMs[i] = 0;
+    }
+}
+
+static uint64_t monotonicMs() {
+    // RTC2 ticks: keep counting through sleep, unaffected by UTC corrections
+    return timebase.ticks() * 1000 / TIMEBASE_HZ;
+}
+
+uint64_t AirtimeLedger::clockMs() {
+    return monotonicMs() + clockOffsetMs;
+}
+
+uint32_t AirtimeLedger::currentHour() {
+    return (uint32_t)(clockMs() / MS_PER_HOUR);
+}
+
+void AirtimeLedger::save(AirtimeRecord& record) {
+    record.clockMs = clockMs();
+    memcpy(record.bucketHour, bucketHour, sizeof(bucketHour));
+    memcpy(record.bucketMs, bucketMs, sizeof(bucketMs));
+}
+
+void AirtimeLedger::restore(const AirtimeRecord& record, uint32_t offMs) {
+    // Continue the saved clock, so the buckets age through the power-down
+    clockOffsetMs = record.clockMs + offMs - monotonicMs();
+    memcpy(bucketHour, record.bucketHour, sizeof(bucketHour));
+    memcpy(bucketMs, record.bucketMs, sizeof(bucketMs));
+}
+
+void AirtimeLedger::record(uint32_t toaMs) {
+    uint32_t hour = currentHour();
+    uint8_t i = hour % AIRTIME_BUCKETS;
+    if (bucketHour[i] != hour) {
+        bucketHour[i] = hour;
+        bucketMs[i] = 0;
+    }
+    bucketMs[i] += toaMs;
+}
+
+uint32_t AirtimeLedger::getUsedMs() {
+    uint32_t hour = currentHour();
+    uint32_t used = 0;
+    for (uint8_t i = 0; i < AIRTIME_BUCKETS; i++) {
+        if (bucketHour[i] != 0xFFFFFFFF && hour - bucketHour[i] < AIRTIME_BUCKETS) {
+            used += bucketMs[i];
+        }
+    }
+    return used;
+}
+
+uint32_t AirtimeLedger::getRemainingMs() {
+    uint32_t used = getUsedMs();
+    return used < AIRTIME_DAILY_BUDGET_MS ? AIRTIME_DAILY_BUDGET_MS - used : 0;
+}
+
+uint32_t AirtimeLedger::msUntilAllowed(uint32_t toaMs) {
+    uint32_t used = getUsedMs();
+    if (used + toaMs <= AIRTIME_DAILY_BUDGET_MS) return 0;
+    
+    // Walk the buckets oldest first until enough airtime has aged out
+    uint64_t now = clockMs();
+    uint32_t hour = currentHour();
+    for (uint8_t age = AIRTIME_BUCKETS - 1; age > 0; age--) {
+        uint32_t h = hour - age;
+        uint8_t i = h % AIRTIME_BUCKETS;
+        if (bucketHour[i] != h) continue;
+        
+        used -= bucketMs[i];
+        if (used + toaMs <= AIRTIME_DAILY_BUDGET_MS) {
+            // This bucket leaves the window at the end of hour h + 24
+            uint64_t expires = (uint64_t)(h + AIRTIME_BUCKETS) * MS_PER_HOUR;
+            return (uint32_t)(expires - now);
+        }
+    }
+    
+    // Only the current hour is left: wait for it to age out entirely
+    return (uint32_t)((uint64_t)(hour + AIRTIME_BUCKETS) * MS_PER_HOUR - now);
+}
+
+uint32_t AirtimeLedger::intervalFor(uint32_t toaMs, uint32_t minIntervalMs) {
+    // Spread the daily budget evenly: uplinks/day = budget / toa
+    uint32_t interval = (uint32_t)((uint64_t)MS_PER_DAY * toaMs / AIRTIME_DAILY_BUDGET_MS);
+    return interval > minIntervalMs ? interval : minIntervalMs;
+}
+
+uint32_t AirtimeLedger::timeOnAir(uint8_t datarate, uint8_t payloadLen) {
+    // DR -> SF/BW from the compiled-in band plan
+    uint8_t sf = Region::spreadingFactor(datarate);
+    uint32_t bwKHz = Region::bandwidthKHz(datarate);
+    
+    // Symbol time in us, low data rate optimisation for SF11/12 @ 125 kHz
+    uint32_t tSym = ((uint32_t)1 << sf) * 1000 / bwKHz;
+    uint8_t de = (sf >= 11 && bwKHz == 125) ? 1 : 0;
+    
+    // Semtech AN1200.13, explicit header, CRC on, CR 4/5, 8 preamble symbols
+    int32_t pl = payloadLen + LORAWAN_PHY_OVERHEAD;
+    int32_t num = 8 * pl - 4 * sf + 28 + 16;
+    int32_t den = 4 * (sf - 2 * de);
+    int32_t blocks = num > 0 ? (num + den - 1) / den : 0;
+    uint32_t symbols = 8 + blocks * 5;
+    
+    // Preamble is 8 + 4.25 symbols
+    uint32_t us = (8 * tSym + tSym * 17 / 4) + symbols * tSym;
+    return (us + 999) / 1000;
+}
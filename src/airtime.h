@@ -0,0 +1,55 @@
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <Arduino.h>
+
+#define AIRTIME_BUCKETS     24          // One bucket per hour of the rolling day
+
+// Ledger carried across a System OFF power-down (see checkpoint.h)
+struct AirtimeRecord {
+    uint64_t clockMs;                       // Ledger clock when saved
+    uint32_t bucketHour[AIRTIME_BUCKETS];
+    uint32_t bucketMs[AIRTIME_BUCKETS];
+};
+
+// Rolling 24 h time-on-air ledger for the TTN fair-use budget.
+// Uplink airtime is booked into hourly buckets on the timebase clock;
+// a bucket drops out of the sum once it is a day old.
+class AirtimeLedger {
+public:
+    AirtimeLedger();
+    
+    // Book the time-on-air of an uplink that went out
+    void record(uint32_t toaMs);
+    
+    // Airtime used in the last 24 h / still available
+    uint32_t getUsedMs();
+    uint32_t getRemainingMs();
+    
+    // Time until an uplink of toaMs fits the budget (0 = now)
+    uint32_t msUntilAllowed(uint32_t toaMs);
+    
+    // Shortest interval that spends no more than the budget per day,
+    // never below minIntervalMs
+    uint32_t intervalFor(uint32_t toaMs, uint32_t minIntervalMs);
+    
+    // Analytic LoRa time-on-air (ms) for an application payload at a DR of the
+    // compiled-in region (region.h)
+    static uint32_t timeOnAir(uint8_t datarate, uint8_t payloadLen);
+    
+    // Carry the ledger over a power-down that lasted offMs
+    void save(AirtimeRecord& record);
+    void restore(const AirtimeRecord& record, uint32_t offMs);
+    
+    // Ledger clock: RTC2 plus the time spent in System OFF
+    uint64_t clockMs();
+
+private:
+    uint32_t bucketHour[AIRTIME_BUCKETS];   // Hour number the bucket holds
+    uint32_t bucketMs[AIRTIME_BUCKETS];
+    uint64_t clockOffsetMs;                 // Added to RTC2, which restarts after System OFF
+    
+    uint32_t currentHour();
+};
+
+#endif // AIRTIME_H
@@ -0,0 +1,99 @@
+#include "checkpoint.h"
+#include "../include/config.h"
+
+Checkpoint checkpoint;
+
+// nRF52840 RAM: RAM0..RAM7 hold two 4 KB sections each, RAM8 six of 32 KB
+#define RAM_BASE                0x20000000UL
+#define RAM_SMALL_BLOCKS_END    0x00010000UL
+#define RAM_SMALL_BLOCK_SIZE    0x2000
+#define RAM_SMALL_SECTION_SIZE  0x1000
+#define RAM_LARGE_BLOCK         8
+#define RAM_LARGE_SECTION_SIZE  0x8000
+
+// Not zeroed by the startup code, so it survives the System OFF wake reset
+static CheckpointData retained __attribute__((section(".noinit")));
+
+Checkpoint::Checkpoint() {
+    memset(&data, 0, sizeof(data));
+}
+
+uint16_t Checkpoint::seal(const CheckpointData& cp) {
+    // CRC-16/CCITT over the fields after crc
+    const uint8_t* p = (const uint8_t*)&cp.cycleCount;
+    size_t len = sizeof(cp) - offsetof(CheckpointData, cycleCount);
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)p[i] << 8;
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+void Checkpoint::retain(const void* addr, size_t len) {
+    // System OFF powers RAM down unless a section's retention bit is set.
+    // The SoftDevice is not enabled, so POWER is written directly.
+    uint32_t start = (uint32_t)((uintptr_t)addr - RAM_BASE);
+    uint32_t end = start + len;
+    for (uint32_t offset = start; offset < end; ) {
+        uint32_t block, section, next;
+        if (offset < RAM_SMALL_BLOCKS_END) {
+            block = offset / RAM_SMALL_BLOCK_SIZE;
+            section = offset % RAM_SMALL_BLOCK_SIZE / RAM_SMALL_SECTION_SIZE;
+            next = (offset / RAM_SMALL_SECTION_SIZE + 1) * RAM_SMALL_SECTION_SIZE;
+        } else {
+            block = RAM_LARGE_BLOCK;
+            section = (offset - RAM_SMALL_BLOCKS_END) / RAM_LARGE_SECTION_SIZE;
+            next = RAM_SMALL_BLOCKS_END + (section + 1) * RAM_LARGE_SECTION_SIZE;
+        }
+        NRF_POWER->RAM[block].POWERSET = POWER_RAM_POWERSET_S0RETENTION_Msk << section;
+        offset = next;
+    }
+}
+
+void Checkpoint::save(uint32_t cycleCount, const GPSData& lastFix, uint32_t sleepMs,
+                      uint32_t rtcAtSleep, bool utcValid) {
+    memset(&retained, 0, sizeof(retained));
+    retained.cycleCount = cycleCount;
+    retained.lastFix = lastFix;
+    retained.sleepMs = sleepMs;
+    retained.rtcAtSleep = rtcAtSleep;
+    retained.utcValid = utcValid;
+    retained.gpsProfile = gpsModule.getProfile();
+    gpsPower.save(retained.gpsPower);
+    adaptiveInterval.save(retained.interval);
+    loraModule.save(retained.lora);
+    
+    retained.size = sizeof(retained);
+    retained.crc = seal(retained);
+    retained.magic = CHECKPOINT_MAGIC;
+    
+    retain(&retained, sizeof(retained));
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Checkpoint] Saved cycle "));
+    Serial.print(cycleCount);
+    Serial.print(F(", "));
+    Serial.print(sizeof(retained));
+    Serial.println(F(" bytes retained"));
+    #endif
+}
+
+bool Checkpoint::load() {
+    bool fromOff = (readResetReason() & POWER_RESETREAS_OFF_Msk) != 0;
+    bool valid = fromOff &&
+                 retained.magic == CHECKPOINT_MAGIC &&
+                 retained.size == sizeof(retained) &&
+                 retained.crc == seal(retained);
+    
+    if (valid) {
+        data = retained;
+    }
+    
+    // One use only: a later reset of any kind must not resume from it
+    retained.magic = 0;
+    
+    return valid;
+}
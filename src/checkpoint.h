@@ -0,0 +1,56 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Arduino.h>
+#include "gps.h"
+#include "gps_power.h"
+#include "lora.h"
+#include "adaptive_interval.h"
+
+#define CHECKPOINT_MAGIC        0x54504B43  // "CKPT"
+
+// Application state carried through System OFF
+struct CheckpointData {
+    uint32_t magic;
+    uint16_t size;                  // sizeof(CheckpointData): another build's layout never matches
+    uint16_t crc;                   // CRC-16/CCITT of everything after this field
+    uint32_t cycleCount;
+    GPSData lastFix;
+    uint32_t sleepMs;               // Requested sleep
+    uint32_t rtcAtSleep;            // PCF8563 time at power-down
+    bool utcValid;                  // PCF8563 was set from the timebase, so it holds UTC
+    uint8_t gpsProfile;
+    GPSPowerRecord gpsPower;
+    IntervalRecord interval;
+    LoRaCheckpoint lora;
+};
+
+// Retained-RAM checkpoint for System OFF.
+// save() fills a .noinit copy from the modules, seals it with a CRC and
+// keeps its RAM sections powered through System OFF. After the wake reset,
+// load() accepts it only if the reset came from System OFF and magic, size
+// and CRC match, then invalidates it so it is used once. A mismatch (power
+// loss, new firmware, bootloader clobbering RAM) means a normal boot.
+class Checkpoint {
+public:
+    Checkpoint();
+    
+    // Before System OFF: everything but the PCF8563 fields comes from the modules
+    void save(uint32_t cycleCount, const GPSData& lastFix, uint32_t sleepMs,
+              uint32_t rtcAtSleep, bool utcValid);
+    
+    // After reset: true if this boot resumes from System OFF
+    bool load();
+    const CheckpointData& get() { return data; }
+    
+private:
+    CheckpointData data;            // Copy taken by load()
+    
+    static uint16_t seal(const CheckpointData& cp);
+    static void retain(const void* addr, size_t len);
+};
+
+// Global checkpoint instance
+extern Checkpoint checkpoint;
+
+#endif // CHECKPOINT_H
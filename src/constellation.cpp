@@ -0,0 +1,201 @@
+#include "constellation.h"
+#include "../include/config.h"
+
+ConstellationSelector constellations;
+
+static const char* const SET_COMMANDS[CONSTELLATION_SET_COUNT] = {
+    "PMTK353,1,0,0,0,0",    // GPS
+    "PMTK353,1,1,0,0,0",    // GPS + GLONASS
+    "PMTK353,1,0,0,0,1",    // GPS + BeiDou
+    "PMTK353,1,1,0,0,1"     // GPS + GLONASS + BeiDou
+};
+
+static const char* const SET_NAMES[CONSTELLATION_SET_COUNT] = {
+    "GPS", "GPS+GLONASS", "GPS+BeiDou", "GPS+GLONASS+BeiDou"
+};
+
+// Relative acquisition current (permille of GPS only); each extra
+// constellation keeps another correlator bank busy
+static const uint16_t SET_CURRENT[CONSTELLATION_SET_COUNT] = {
+    1000, 1100, 1100, 1200
+};
+
+ConstellationSelector::ConstellationSelector() : unsaved(0) {
+    resetStats(0, 0);
+}
+
+void ConstellationSelector::begin() {
+    #if CONSTELLATION_LEARNING
+    if (!nvsStorage.loadConstellations(record) || record.current >= CONSTELLATION_SET_COUNT) {
+        resetStats(0, 0);
+    }
+    
+    #if DEBUG_SERIAL
+    printStats();
+    #endif
+    #endif
+}
+
+void ConstellationSelector::resetStats(int32_t lat, int32_t lon) {
+    memset(&record, 0, sizeof(record));
+    record.current = CONSTELLATION_GPS_GLONASS;
+    record.anchorLat = lat;
+    record.anchorLon = lon;
+}
+
+const char* ConstellationSelector::getCommand(uint8_t set) {
+    return SET_COMMANDS[set < CONSTELLATION_SET_COUNT ? set : CONSTELLATION_GPS_GLONASS];
+}
+
+const char* ConstellationSelector::getName(uint8_t set) {
+    return SET_NAMES[set < CONSTELLATION_SET_COUNT ? set : CONSTELLATION_GPS_GLONASS];
+}
+
+uint32_t ConstellationSelector::cost(uint8_t set) {
+    // Expected acquisition charge: relative TTFF times relative current
+    const ConstellationStats& s = record.sets[set];
+    uint32_t c = s.ttffPermille * SET_CURRENT[set] / 1000;
+    
+    // The EWMA forgets timeouts after a few fixes; the failure rate does not
+    if (s.trials > 0) c = c * (s.trials + s.failures) / s.trials;
+    
+    // A set that converges quickly to an unusable geometry is no bargain
+    if (s.hdop > FIX_MAX_HDOP) c *= 2;
+    
+    return c;
+}
+
+bool ConstellationSelector::select() {
+    #if CONSTELLATION_LEARNING
+    uint8_t previous = record.current;
+    uint8_t next = previous;
+    
+    // Try every set a few times before trusting the statistics
+    bool untried = false;
+    for (uint8_t i = 0; i < CONSTELLATION_SET_COUNT; i++) {
+        if (record.sets[i].trials < CONSTELLATION_MIN_TRIALS) {
+            next = i;
+            untried = true;
+            break;
+        }
+    }
+    
+    if (!untried) {
+        uint8_t best = 0;
+        for (uint8_t i = 1; i < CONSTELLATION_SET_COUNT; i++) {
+            if (cost(i) < cost(best)) best = i;
+        }
+        next = best;
+        
+        // Epsilon-greedy: occasionally re-check one of the others
+        if (random(100) < CONSTELLATION_EXPLORE_PCT) {
+            next = (best + 1 + random(CONSTELLATION_SET_COUNT - 1)) % CONSTELLATION_SET_COUNT;
+        }
+    }
+    
+    record.current = next;
+    
+    #if DEBUG_SERIAL
+    if (next != previous) {
+        Serial.print(F("[Constellation] Switching to "));
+        Serial.print(getName(next));
+        Serial.println(untried ? F(" (learning)") : (cost(next) > cost(previous) ? F(" (exploring)") : F("")));
+    }
+    #endif
+    
+    return next != previous;
+    #else
+    return false;
+    #endif
+}
+
+void ConstellationSelector::update(uint32_t ttffPermille) {
+    ConstellationStats& s = record.sets[record.current];
+    
+    // EWMA (1/4 weight), seeded by the first sample
+    s.ttffPermille = s.trials == 0 ? ttffPermille : (s.ttffPermille * 3 + ttffPermille) / 4;
+    if (s.trials < 0xFFFF) s.trials++;
+}
+
+void ConstellationSelector::recordFix(uint32_t ttffMs, uint32_t expectedMs, const GPSData& data) {
+    #if CONSTELLATION_LEARNING
+    int32_t lat = (int32_t)(data.latitude * 1e7);
+    int32_t lon = (int32_t)(data.longitude * 1e7);
+    
+    bool anchored = record.anchorLat != 0 || record.anchorLon != 0;
+    if (anchored) {
+        // Equirectangular distance is plenty at this threshold
+        float dLat = (lat - record.anchorLat) / 1e7f;
+        float dLon = (lon - record.anchorLon) / 1e7f * cosf(data.latitude * DEG_TO_RAD);
+        float km = sqrtf(dLat * dLat + dLon * dLon) * 111.2f;
+        
+        if (km > CONSTELLATION_REGION_KM) {
+            #if DEBUG_SERIAL
+            Serial.print(F("[Constellation] Moved "));
+            Serial.print(km, 0);
+            Serial.println(F(" km - relearning"));
+            #endif
+            
+            // The attempt that just finished still says something about here
+            uint8_t current = record.current;
+            resetStats(lat, lon);
+            record.current = current;
+            save(true);
+        }
+    } else {
+        record.anchorLat = lat;
+        record.anchorLon = lon;
+    }
+    
+    if (expectedMs == 0) expectedMs = 1;
+    update(ttffMs * 1000 / expectedMs);
+    
+    ConstellationStats& s = record.sets[record.current];
+    uint16_t hdop = (uint16_t)(data.hdop * 100);
+    s.hdop = s.hdop == 0 ? hdop : (s.hdop * 3 + hdop) / 4;  // Seeded by the first fix
+    
+    save(false);
+    #endif
+}
+
+void ConstellationSelector::recordTimeout(uint32_t timeoutMs, uint32_t expectedMs) {
+    #if CONSTELLATION_LEARNING
+    // The whole timeout was spent and the fix still has to be bought on a
+    // later attempt: charge more than any fix that arrived in time could
+    if (expectedMs == 0) expectedMs = 1;
+    uint32_t spentMs = timeoutMs > expectedMs ? timeoutMs : expectedMs;
+    update(spentMs * 1000 / expectedMs * CONSTELLATION_TIMEOUT_PENALTY);
+    
+    ConstellationStats& s = record.sets[record.current];
+    if (s.failures < 0xFFFF) s.failures++;
+    
+    save(false);
+    #endif
+}
+
+void ConstellationSelector::save(bool force) {
+    // Statistics move slowly; batch the flash writes
+    if (!force && ++unsaved < CONSTELLATION_SAVE_EVERY) return;
+    unsaved = 0;
+    nvsStorage.saveConstellations(record);
+}
+
+void ConstellationSelector::printStats() {
+    #if DEBUG_SERIAL
+    for (uint8_t i = 0; i < CONSTELLATION_SET_COUNT; i++) {
+        const ConstellationStats& s = record.sets[i];
+        Serial.print(F("[Constellation] "));
+        Serial.print(i == record.current ? F("* ") : F("  "));
+        Serial.print(getName(i));
+        Serial.print(F(": TTFF "));
+        Serial.print(s.ttffPermille / 10.0, 1);
+        Serial.print(F("% of expected, HDOP "));
+        Serial.print(s.hdop / 100.0, 2);
+        Serial.print(F(", "));
+        Serial.print(s.trials);
+        Serial.print(F(" tries, "));
+        Serial.print(s.failures);
+        Serial.println(F(" timeouts"));
+    }
+    #endif
+}
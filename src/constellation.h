@@ -0,0 +1,58 @@
+#ifndef CONSTELLATION_H
+#define CONSTELLATION_H
+
+#include <Arduino.h>
+#include "gps.h"
+#include "nvs.h"
+
+// GNSS constellation sets selectable with PMTK353
+enum ConstellationSet {
+    CONSTELLATION_GPS,
+    CONSTELLATION_GPS_GLONASS,
+    CONSTELLATION_GPS_BEIDOU,
+    CONSTELLATION_GPS_GLONASS_BEIDOU
+};
+
+// Learns which constellation set acquires with the least energy where the
+// unit operates. Each set keeps an EWMA of TTFF (normalised to the expected
+// TTFF for the start type, so hot and cold starts are comparable), HDOP and
+// its timeout rate, persisted in NVS. Mostly the cheapest set is used; now and then another
+// one is tried. Statistics restart when the unit moves to a new region.
+class ConstellationSelector {
+public:
+    ConstellationSelector();
+    
+    // Load learned statistics from NVS
+    void begin();
+    
+    // Pick the set for the next fix attempt; true if it changed
+    bool select();
+    uint8_t getCurrent() { return record.current; }
+    
+    // PMTK353 sentence body and display name for a set
+    static const char* getCommand(uint8_t set);
+    static const char* getName(uint8_t set);
+    
+    // Fix attempt outcome for the current set
+    void recordFix(uint32_t ttffMs, uint32_t expectedMs, const GPSData& data);
+    void recordTimeout(uint32_t timeoutMs, uint32_t expectedMs);
+    
+    void printStats();
+    
+    // Write batched updates now (before a System OFF power-down)
+    void flush() { if (unsaved) save(true); }
+
+private:
+    ConstellationRecord record;
+    uint8_t unsaved;            // Updates since the last NVS write
+    
+    uint32_t cost(uint8_t set);
+    void update(uint32_t ttffPermille);
+    void resetStats(int32_t lat, int32_t lon);
+    void save(bool force);
+};
+
+// Global constellation selector instance
+extern ConstellationSelector constellations;
+
+#endif // CONSTELLATION_H
@@ -1,5 +1,7 @@
 #include "display.h"
 #include "../include/pins.h"
+#include "power.h"
+#include "task_monitor.h"
 #include "../include/config.h"
 #include <Fonts/FreeMonoBold9pt7b.h>
 
@@ -8,7 +10,21 @@ Display display;
 // E-paper uses its own SPI bus (NRF_SPIM2) - separate from LoRa!
 static SPIClass* dispPort = nullptr;
 
-Display::Display() : isInitialized(false), epd(nullptr) {
+Display::Display()
+    : isInitialized(false),
+      awake(false),
+      epd(nullptr),
+      task(nullptr),
+      queue(nullptr),
+      monitorSlot(-1) {
+}
+
+// POWER_EPD hook: the controller hibernates when released and is reset
+// out of it by GxEPD2 on the next refresh
+static void epdPower(bool on) {
+    if (!on) {
+        display.hibernate();
+    }
 }
 
 bool Display::begin() {
@@ -33,6 +49,7 @@ bool Display::begin() {
     epd->epd2.selectSPI(*dispPort, SPISettings(4000000, MSBFIRST, SPI_MODE0));
     
     // Initialize display
+    wake();
     dispPort->begin();
     epd->init(0);  // 0 = no serial debug
     
@@ -42,6 +59,18 @@ bool Display::begin() {
     epd->setFullWindow();
     
     isInitialized = true;
+    power.setHook(POWER_EPD, epdPower);
+    
+    // Refreshes run in their own task from here on
+    queue = xQueueCreate(DISPLAY_QUEUE_DEPTH, sizeof(DisplayRequest));
+    if (queue && xTaskCreate(taskMain, "display", DISPLAY_TASK_STACK, this, TASK_PRIO_LOW, &task) == pdPASS) {
+        monitorSlot = taskMonitor.add(task, "display", DISPLAY_TASK_STACK);
+    } else {
+        task = nullptr;
+        #if DEBUG_SERIAL
+        Serial.println(F("[Display] Task not started, refreshing inline"));
+        #endif
+    }
     
     #if DEBUG_SERIAL
     Serial.println(F("[Display] E-paper initialized"));
@@ -56,7 +85,136 @@ void Display::clear() {
 }
 
 void Display::sleep() {
+    DisplayRequest request = {};
+    request.screen = SCREEN_SLEEP;
+    post(request);
+}
+
+void Display::post(const DisplayRequest& request) {
     if (!isInitialized) return;
+    
+    if (task == nullptr) {
+        draw(request);
+        return;
+    }
+    
+    if (xQueueSend(queue, &request, 0) != pdTRUE) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[Display] Queue full, screen dropped"));
+        #endif
+    }
+}
+
+void Display::draw(const DisplayRequest& request) {
+    switch (request.screen) {
+        case SCREEN_STARTUP:        drawStartup(); break;
+        case SCREEN_JOINING:        drawJoining(request.value, request.datarate); break;
+        case SCREEN_JOINED:         drawJoined(); break;
+        case SCREEN_JOIN_FAILED:    drawJoinFailed(request.value); break;
+        case SCREEN_GPS_SEARCHING:  drawGPSSearching(); break;
+        case SCREEN_GPS_FIX:        drawGPSFix(request.gps); break;
+        case SCREEN_TRANSMITTING:   drawTransmitting(request.value); break;
+        case SCREEN_STATUS:         drawStatus(request.gps, request.loraState, request.value); break;
+        case SCREEN_ERROR:          drawError(request.message); break;
+        case SCREEN_SLEEP:
+            if (awake) {
+                awake = false;
+                power.release(POWER_EPD);
+            }
+            break;
+    }
+}
+
+void Display::taskMain(void* arg) {
+    Display* self = (Display*)arg;
+    DisplayRequest request;
+    DisplayRequest next;
+    
+    for (;;) {
+        xQueueReceive(self->queue, &request, portMAX_DELAY);
+        
+        // Skip screens a newer one already replaces (a sleep request ends the run)
+        while (request.screen != SCREEN_SLEEP &&
+               xQueuePeek(self->queue, &next, 0) == pdTRUE && next.screen != SCREEN_SLEEP) {
+            xQueueReceive(self->queue, &request, 0);
+        }
+        
+        taskMonitor.busyBegin(self->monitorSlot);
+        self->draw(request);
+        taskMonitor.busyEnd(self->monitorSlot);
+    }
+}
+
+void Display::showStartup() {
+    DisplayRequest request = {};
+    request.screen = SCREEN_STARTUP;
+    post(request);
+}
+
+void Display::showJoining(uint32_t attempt, uint8_t datarate) {
+    DisplayRequest request = {};
+    request.screen = SCREEN_JOINING;
+    request.value = attempt;
+    request.datarate = datarate;
+    post(request);
+}
+
+void Display::showJoined() {
+    DisplayRequest request = {};
+    request.screen = SCREEN_JOINED;
+    post(request);
+}
+
+void Display::showJoinFailed(uint32_t retrySeconds) {
+    DisplayRequest request = {};
+    request.screen = SCREEN_JOIN_FAILED;
+    request.value = retrySeconds;
+    post(request);
+}
+
+void Display::showGPSSearching() {
+    DisplayRequest request = {};
+    request.screen = SCREEN_GPS_SEARCHING;
+    post(request);
+}
+
+void Display::showGPSFix(GPSData data) {
+    DisplayRequest request = {};
+    request.screen = SCREEN_GPS_FIX;
+    request.gps = data;
+    post(request);
+}
+
+void Display::showTransmitting(uint32_t count) {
+    DisplayRequest request = {};
+    request.screen = SCREEN_TRANSMITTING;
+    request.value = count;
+    post(request);
+}
+
+void Display::showStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCount) {
+    DisplayRequest request = {};
+    request.screen = SCREEN_STATUS;
+    request.gps = gpsData;
+    request.loraState = loraState;
+    request.value = txCount;
+    post(request);
+}
+
+void Display::showError(const char* message) {
+    DisplayRequest request = {};
+    request.screen = SCREEN_ERROR;
+    request.message = message;
+    post(request);
+}
+
+void Display::wake() {
+    if (awake) return;
+    awake = true;
+    power.acquire(POWER_EPD);
+}
+
+void Display::hibernate() {
     epd->hibernate();
 }
 
@@ -98,15 +256,18 @@ float Display::getBatteryVoltage() {
     // Read battery voltage from ADC
     // T-Echo has voltage divider: VBAT -> 1M -> ADC -> 1M -> GND
     analogReadResolution(12);  // 12-bit ADC
+    power.acquire(POWER_SAADC);
     int raw = analogRead(VBAT_PIN);
+    power.release(POWER_SAADC);
     
     // Convert to voltage: (raw / 4096) * 3.6V * 2 (voltage divider)
     float voltage = (raw / 4096.0) * 3.6 * 2.0;
     return voltage;
 }
 
-void Display::showStartup() {
+void Display::drawStartup() {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -126,8 +287,9 @@ void Display::showStartup() {
     } while (epd->nextPage());
 }
 
-void Display::showJoining(uint8_t attempt, uint8_t maxAttempts) {
+void Display::drawJoining(uint32_t attempt, uint8_t datarate) {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -146,13 +308,15 @@ void Display::showJoining(uint8_t attempt, uint8_t maxAttempts) {
         epd->setCursor(10, 100);
         epd->print(F("Attempt: "));
         epd->print(attempt);
-        epd->print(F("/"));
-        epd->print(maxAttempts);
+        epd->print(F(" (DR"));
+        epd->print(datarate);
+        epd->print(F(")"));
     } while (epd->nextPage());
 }
 
-void Display::showJoined() {
+void Display::drawJoined() {
     if (!isInitialized) return;
+    wake();
     
     #if DEBUG_SERIAL
     Serial.println(F("[Display] showJoined() start"));
@@ -180,8 +344,9 @@ void Display::showJoined() {
     #endif
 }
 
-void Display::showJoinFailed() {
+void Display::drawJoinFailed(uint32_t retrySeconds) {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -197,12 +362,15 @@ void Display::showJoinFailed() {
         epd->setCursor(10, 110);
         epd->print(F("Check credentials"));
         epd->setCursor(10, 125);
-        epd->print(F("Restarting..."));
+        epd->print(F("Retry in "));
+        epd->print(retrySeconds);
+        epd->print(F("s"));
     } while (epd->nextPage());
 }
 
-void Display::showGPSSearching() {
+void Display::drawGPSSearching() {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -220,8 +388,9 @@ void Display::showGPSSearching() {
     } while (epd->nextPage());
 }
 
-void Display::showGPSFix(GPSData data) {
+void Display::drawGPSFix(GPSData data) {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -254,8 +423,9 @@ void Display::showGPSFix(GPSData data) {
     } while (epd->nextPage());
 }
 
-void Display::showTransmitting(uint32_t count) {
+void Display::drawTransmitting(uint32_t count) {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -270,8 +440,9 @@ void Display::showTransmitting(uint32_t count) {
     } while (epd->nextPage());
 }
 
-void Display::showStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCount) {
+void Display::drawStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCount) {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -286,6 +457,14 @@ void Display::showStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCou
         switch (loraState) {
             case LORA_JOINED:
                 epd->print(F("Joined"));
+                // Coverage from the last LinkCheckAns
+                if (loraModule.hasLinkCheck()) {
+                    epd->print(F(" GW "));
+                    epd->print(loraModule.getGatewayCount());
+                    epd->print(F(" +"));
+                    epd->print(loraModule.getLinkMargin());
+                    epd->print(F("dB"));
+                }
                 break;
             case LORA_JOINING:
                 epd->print(F("Joining..."));
@@ -302,6 +481,15 @@ void Display::showStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCou
         epd->print(F("TX Count: "));
         epd->print(txCount);
         
+        // Data rate and power (network-chosen when ADR is on)
+        if (loraState == LORA_JOINED) {
+            epd->print(F(" DR"));
+            epd->print(loraModule.getDatarate());
+            epd->print(F(" "));
+            epd->print(loraModule.getTxPower());
+            epd->print(F("dBm"));
+        }
+        
         // GPS status
         epd->setCursor(5, 60);
         epd->print(F("GPS: "));
@@ -333,8 +521,9 @@ void Display::showStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCou
     } while (epd->nextPage());
 }
 
-void Display::showError(const char* message) {
+void Display::drawError(const char* message) {
     if (!isInitialized) return;
+    wake();
     
     epd->setFullWindow();
     epd->firstPage();
@@ -12,32 +12,83 @@
 #define GxEPD2_DRIVER_CLASS GxEPD2_154_D67
 #define MAX_DISPLAY_BUFFER_SIZE 5000
 
+#define DISPLAY_QUEUE_DEPTH 4           // Pending screen requests
+
+// Screens the display task draws
+enum DisplayScreen {
+    SCREEN_STARTUP,
+    SCREEN_JOINING,
+    SCREEN_JOINED,
+    SCREEN_JOIN_FAILED,
+    SCREEN_GPS_SEARCHING,
+    SCREEN_GPS_FIX,
+    SCREEN_TRANSMITTING,
+    SCREEN_STATUS,
+    SCREEN_ERROR,
+    SCREEN_SLEEP            // Not a screen: release POWER_EPD
+};
+
+struct DisplayRequest {
+    DisplayScreen screen;
+    uint32_t value;         // Join attempt, retry seconds or TX count
+    uint8_t datarate;
+    LoRaWANState loraState;
+    GPSData gps;
+    const char* message;    // SCREEN_ERROR, must outlive the request
+};
+
+// E-paper front end. A full refresh takes about 2 s, so the show*() calls
+// only queue a request and return; a display task draws them in order.
+// A screen that is already superseded by a newer one in the queue is
+// skipped. Without the task (creation failed) the calls draw directly.
 class Display {
 public:
     Display();
     
-    // Initialization
+    // Initialization (also starts the display task)
     bool begin();
     
-    // Display operations
+    // Display operations (queued)
     void showStartup();
-    void showJoining(uint8_t attempt, uint8_t maxAttempts);
+    void showJoining(uint32_t attempt, uint8_t datarate);
     void showJoined();
-    void showJoinFailed();
+    void showJoinFailed(uint32_t retrySeconds);
     void showGPSSearching();
     void showGPSFix(GPSData data);
     void showTransmitting(uint32_t count);
     void showStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCount);
     void showError(const char* message);
     
-    // Power management
+    // Power management (sleep releases POWER_EPD after the queued screens;
+    // the domain hook hibernates)
     void sleep();
+    void hibernate();
     void clear();
 
 private:
     GxEPD2_BW<GxEPD2_DISPLAY_CLASS, GxEPD2_DISPLAY_CLASS::HEIGHT>* epd;
     bool isInitialized;
+    bool awake;                 // POWER_EPD held (controller out of hibernate)
+    
+    // Display task and its request queue
+    TaskHandle_t task;
+    QueueHandle_t queue;
+    int8_t monitorSlot;
+    void post(const DisplayRequest& request);
+    void draw(const DisplayRequest& request);
+    static void taskMain(void* arg);
+    
+    void drawStartup();
+    void drawJoining(uint32_t attempt, uint8_t datarate);
+    void drawJoined();
+    void drawJoinFailed(uint32_t retrySeconds);
+    void drawGPSSearching();
+    void drawGPSFix(GPSData data);
+    void drawTransmitting(uint32_t count);
+    void drawStatus(GPSData gpsData, LoRaWANState loraState, uint32_t txCount);
+    void drawError(const char* message);
     
+    void wake();
     void drawHeader();
     void drawBattery(float voltage);
     float getBatteryVoltage();
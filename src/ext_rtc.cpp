@@ -0,0 +1,186 @@
+#include "ext_rtc.h"
+#include <Wire.h>
+#include "../include/pins.h"
+#include "../include/config.h"
+
+ExternalRTC extRtc;
+
+// PCF8563 registers
+#define PCF8563_REG_CTRL1       0x00
+#define PCF8563_REG_CTRL2       0x01
+#define PCF8563_REG_SECONDS     0x02        // 0x02..0x08: seconds..years
+#define PCF8563_REG_ALARM       0x09        // 0x09..0x0C: minute, hour, day, weekday
+#define PCF8563_REG_CLKOUT      0x0D
+#define PCF8563_REG_TIMER_CTRL  0x0E
+#define PCF8563_REG_TIMER       0x0F
+
+#define PCF8563_CTRL2_TIE       0x01
+#define PCF8563_CTRL2_AIE       0x02
+#define PCF8563_CTRL2_TF        0x04
+#define PCF8563_CTRL2_AF        0x08
+#define PCF8563_SECONDS_VL      0x80        // Oscillator stopped, time not reliable
+#define PCF8563_MONTH_CENTURY   0x80
+#define PCF8563_ALARM_DISABLE   0x80
+#define PCF8563_TIMER_ENABLE    0x80
+#define PCF8563_TIMER_1HZ       0x02
+#define PCF8563_TIMER_1_60HZ    0x03
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+// Inverse of daysFromCivil()
+static void civilFromDays(int32_t z, int32_t& y, uint32_t& m, uint32_t& d) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int32_t)yoe + era * 400 + (m <= 2);
+}
+
+ExternalRTC::ExternalRTC() : present(false) {
+}
+
+bool ExternalRTC::begin() {
+    // Same bus as the BMP280 (motion.cpp); setting the pins again is harmless
+    Wire.setPins(I2C_SDA, I2C_SCL);
+    Wire.begin();
+    
+    uint8_t ctrl[2];
+    if (!readRegisters(PCF8563_REG_CTRL1, ctrl, sizeof(ctrl))) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[RTC] PCF8563 not found"));
+        #endif
+        return false;
+    }
+    present = true;
+    
+    // Oscillator running, CLKOUT off (it draws current on the open pin)
+    writeRegister(PCF8563_REG_CTRL1, 0x00);
+    writeRegister(PCF8563_REG_CLKOUT, 0x00);
+    
+    #if DEBUG_SERIAL
+    uint32_t utc;
+    Serial.print(F("[RTC] PCF8563 found, "));
+    if (readTime(utc)) {
+        Serial.print(F("time "));
+        Serial.println(utc);
+    } else {
+        Serial.println(F("time not set"));
+    }
+    #endif
+    
+    return true;
+}
+
+bool ExternalRTC::readTime(uint32_t& utc) {
+    uint8_t r[7];
+    if (!present || !readRegisters(PCF8563_REG_SECONDS, r, sizeof(r))) return false;
+    if (r[0] & PCF8563_SECONDS_VL) return false;
+    
+    // The century flag marks 2100+; years count from 2000
+    int32_t year = 2000 + fromBCD(r[6]) + ((r[5] & PCF8563_MONTH_CENTURY) ? 100 : 0);
+    int32_t days = daysFromCivil(year, fromBCD(r[5] & 0x1F), fromBCD(r[3] & 0x3F));
+    utc = (uint32_t)days * 86400 + fromBCD(r[2] & 0x3F) * 3600 +
+          fromBCD(r[1] & 0x7F) * 60 + fromBCD(r[0] & 0x7F);
+    return true;
+}
+
+bool ExternalRTC::setTime(uint32_t utc) {
+    if (!present) return false;
+    
+    int32_t year;
+    uint32_t month, day;
+    uint32_t days = utc / 86400;
+    uint32_t secs = utc % 86400;
+    civilFromDays((int32_t)days, year, month, day);
+    
+    uint8_t r[7];
+    r[0] = toBCD(secs % 60);                    // Writing the seconds also clears VL
+    r[1] = toBCD(secs / 60 % 60);
+    r[2] = toBCD(secs / 3600);
+    r[3] = toBCD(day);
+    r[4] = (uint8_t)((days + 4) % 7);           // 1970-01-01 was a Thursday
+    r[5] = toBCD(month) | (year >= 2100 ? PCF8563_MONTH_CENTURY : 0);
+    r[6] = toBCD(year % 100);
+    return writeRegisters(PCF8563_REG_SECONDS, r, sizeof(r));
+}
+
+bool ExternalRTC::armWake(uint32_t seconds) {
+    if (!present || seconds == 0) return false;
+    
+    clearWake();
+    
+    // The timer's first period is shortened by up to one source tick, so
+    // both timer ranges wake early rather than late
+    if (seconds <= EXT_RTC_TIMER_MAX * 60UL) {
+        bool fine = seconds <= EXT_RTC_TIMER_MAX;
+        uint8_t count = fine ? seconds : seconds / 60;
+        return writeRegister(PCF8563_REG_TIMER, count) &&
+               writeRegister(PCF8563_REG_TIMER_CTRL,
+                             PCF8563_TIMER_ENABLE | (fine ? PCF8563_TIMER_1HZ : PCF8563_TIMER_1_60HZ)) &&
+               writeRegister(PCF8563_REG_CTRL2, PCF8563_CTRL2_TIE);
+    }
+    
+    // Longer: alarm at the start of the target minute. Matching on the day of
+    // the month wakes early past a month, which the caller sleeps out.
+    uint32_t now;
+    if (!readTime(now)) return false;
+    
+    int32_t year;
+    uint32_t month, day;
+    uint32_t target = now + seconds;
+    uint32_t secs = target % 86400;
+    civilFromDays((int32_t)(target / 86400), year, month, day);
+    
+    uint8_t alarm[4];
+    alarm[0] = toBCD(secs / 60 % 60);
+    alarm[1] = toBCD(secs / 3600);
+    alarm[2] = toBCD(day);
+    alarm[3] = PCF8563_ALARM_DISABLE;           // Weekday not matched
+    return writeRegisters(PCF8563_REG_ALARM, alarm, sizeof(alarm)) &&
+           writeRegister(PCF8563_REG_CTRL2, PCF8563_CTRL2_AIE);
+}
+
+void ExternalRTC::clearWake() {
+    if (!present) return;
+    
+    // Flags are cleared by writing 0; with both interrupts off INT floats
+    writeRegister(PCF8563_REG_CTRL2, 0x00);
+    writeRegister(PCF8563_REG_TIMER_CTRL, 0x00);
+    
+    uint8_t alarm[4] = { PCF8563_ALARM_DISABLE, PCF8563_ALARM_DISABLE,
+                         PCF8563_ALARM_DISABLE, PCF8563_ALARM_DISABLE };
+    writeRegisters(PCF8563_REG_ALARM, alarm, sizeof(alarm));
+}
+
+bool ExternalRTC::readRegisters(uint8_t reg, uint8_t* buf, uint8_t len) {
+    Wire.beginTransmission(EXT_RTC_ADDRESS);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0) return false;
+    
+    if (Wire.requestFrom((uint8_t)EXT_RTC_ADDRESS, len) != len) return false;
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = Wire.read();
+    }
+    return true;
+}
+
+bool ExternalRTC::writeRegisters(uint8_t reg, const uint8_t* buf, uint8_t len) {
+    Wire.beginTransmission(EXT_RTC_ADDRESS);
+    Wire.write(reg);
+    for (uint8_t i = 0; i < len; i++) {
+        Wire.write(buf[i]);
+    }
+    return Wire.endTransmission() == 0;
+}
@@ -0,0 +1,49 @@
+#ifndef EXT_RTC_H
+#define EXT_RTC_H
+
+#include <Arduino.h>
+
+#define EXT_RTC_ADDRESS         0x51
+#define EXT_RTC_TIMER_MAX       255         // Countdown register is 8 bits
+#define EXT_RTC_EPOCH           946684800UL // 2000-01-01, earliest date it holds
+#define EXT_RTC_UTC_FLOOR       1704067200UL // 2024-01-01: anything earlier was never set from UTC
+
+// PCF8563 on the sensor I2C bus, the only clock that runs in System OFF.
+// Its open-drain INT output (RTC_INT_PIN) is the System OFF wake source:
+// the countdown timer covers up to 255 s at 1 Hz and 255 min at 1/60 Hz,
+// the minute/hour/day alarm anything longer. INT stays low until
+// clearWake() resets the flag, so a wake cannot be missed.
+// The clock is kept in UTC, set from the timebase before each power-down.
+class ExternalRTC {
+public:
+    ExternalRTC();
+    
+    // Probe 0x51 and stop CLKOUT; the wake flags are left for the caller
+    bool begin();
+    bool isPresent() { return present; }
+    
+    // Calendar as Unix seconds; false if the oscillator stopped (VL flag)
+    bool readTime(uint32_t& utc);
+    bool setTime(uint32_t utc);
+    
+    // Pull INT low in about seconds (never later); false if not armed
+    bool armWake(uint32_t seconds);
+    
+    // Release INT and disarm the timer and the alarm
+    void clearWake();
+    
+private:
+    bool present;
+    
+    bool readRegisters(uint8_t reg, uint8_t* buf, uint8_t len);
+    bool writeRegisters(uint8_t reg, const uint8_t* buf, uint8_t len);
+    bool writeRegister(uint8_t reg, uint8_t value) { return writeRegisters(reg, &value, 1); }
+    
+    static uint8_t toBCD(uint8_t value) { return (uint8_t)((value / 10) << 4 | value % 10); }
+    static uint8_t fromBCD(uint8_t value) { return (uint8_t)((value >> 4) * 10 + (value & 0x0F)); }
+};
+
+// Global external RTC instance
+extern ExternalRTC extRtc;
+
+#endif // EXT_RTC_H
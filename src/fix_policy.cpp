@@ -0,0 +1,91 @@
+#include "fix_policy.h"
+#include "../include/config.h"
+
+FirstFixPolicy firstFixPolicy;
+ConvergencePolicy convergencePolicy;
+
+// Metres per 1e-7 degree of latitude
+#define METRES_PER_E7       0.0111319f
+
+void FirstFixPolicy::reset() {
+    samples = 0;
+    jitterM = 0.0f;
+}
+
+bool FirstFixPolicy::addSample(const FixSample& sample) {
+    samples++;
+    return sample.satellites >= MIN_SATELLITES;
+}
+
+ConvergencePolicy::ConvergencePolicy() {
+    reset();
+}
+
+void ConvergencePolicy::reset() {
+    head = 0;
+    count = 0;
+    bestHdop = 0xFFFF;
+    sinceImprovement = 0;
+    samples = 0;
+    jitterM = 0.0f;
+}
+
+float ConvergencePolicy::computeJitter() {
+    // Largest distance of a windowed position from the window mean
+    int64_t sumLat = 0;
+    int64_t sumLon = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        sumLat += window[i].latitude;
+        sumLon += window[i].longitude;
+    }
+    int32_t meanLat = (int32_t)(sumLat / count);
+    int32_t meanLon = (int32_t)(sumLon / count);
+    
+    float lonScale = cosf(meanLat * 1e-7f * (float)DEG_TO_RAD);
+    float worst = 0.0f;
+    for (uint8_t i = 0; i < count; i++) {
+        float dy = (window[i].latitude - meanLat) * METRES_PER_E7;
+        float dx = (window[i].longitude - meanLon) * METRES_PER_E7 * lonScale;
+        float d = sqrtf(dx * dx + dy * dy);
+        if (d > worst) worst = d;
+    }
+    return worst;
+}
+
+bool ConvergencePolicy::addSample(const FixSample& sample) {
+    samples++;
+    
+    // Epochs below the hard floor restart the window
+    if (sample.satellites < MIN_SATELLITES || sample.hdop > FIX_MAX_HDOP) {
+        head = 0;
+        count = 0;
+        bestHdop = 0xFFFF;
+        sinceImprovement = 0;
+        return false;
+    }
+    
+    window[head] = sample;
+    head = (head + 1) % FIX_POLICY_WINDOW;
+    if (count < FIX_POLICY_WINDOW) count++;
+    
+    if (sample.hdop + FIX_HDOP_EPSILON < bestHdop) {
+        bestHdop = sample.hdop;
+        sinceImprovement = 0;
+    } else {
+        sinceImprovement++;
+    }
+    
+    if (count < FIX_MIN_SAMPLES) return false;
+    
+    jitterM = computeJitter();
+    
+    // Good enough: all quality targets met
+    if (sample.hdop <= FIX_TARGET_HDOP &&
+        sample.satellites >= FIX_TARGET_SATELLITES &&
+        jitterM <= FIX_TARGET_JITTER_M) {
+        return true;
+    }
+    
+    // Converged: HDOP has stopped improving and the position is steady
+    return sinceImprovement >= FIX_STALL_SAMPLES && jitterM <= FIX_MAX_JITTER_M;
+}
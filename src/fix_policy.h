@@ -0,0 +1,68 @@
+#ifndef FIX_POLICY_H
+#define FIX_POLICY_H
+
+#include <Arduino.h>
+
+// One navigation epoch as seen by a fix policy
+struct FixSample {
+    int32_t latitude;       // Degrees * 1e7
+    int32_t longitude;      // Degrees * 1e7
+    uint16_t hdop;          // HDOP * 100
+    uint8_t satellites;
+};
+
+// Decides when a stream of epochs is good enough to stop the GPS
+class FixPolicy {
+public:
+    virtual ~FixPolicy() {}
+    
+    // Start of a new acquisition
+    virtual void reset() = 0;
+    
+    // Feed one epoch; returns true when the fix should be accepted
+    virtual bool addSample(const FixSample& sample) = 0;
+    
+    virtual const char* name() const = 0;
+    
+    // Diagnostics for the last evaluated epoch
+    uint8_t getSampleCount() const { return samples; }
+    float getJitter() const { return jitterM; }
+
+protected:
+    uint8_t samples = 0;
+    float jitterM = 0.0f;
+};
+
+// Accept the first epoch with MIN_SATELLITES (original behaviour)
+class FirstFixPolicy : public FixPolicy {
+public:
+    void reset() override;
+    bool addSample(const FixSample& sample) override;
+    const char* name() const override { return "first"; }
+};
+
+// Accept once quality targets are met or the solution stops improving
+#define FIX_POLICY_WINDOW   8
+
+class ConvergencePolicy : public FixPolicy {
+public:
+    ConvergencePolicy();
+    
+    void reset() override;
+    bool addSample(const FixSample& sample) override;
+    const char* name() const override { return "convergence"; }
+
+private:
+    FixSample window[FIX_POLICY_WINDOW];
+    uint8_t head;
+    uint8_t count;
+    uint16_t bestHdop;
+    uint8_t sinceImprovement;
+    
+    float computeJitter();
+};
+
+extern FirstFixPolicy firstFixPolicy;
+extern ConvergencePolicy convergencePolicy;
+
+#endif // FIX_POLICY_H
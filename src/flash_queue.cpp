@@ -0,0 +1,266 @@
+#include "flash_queue.h"
+#include "../include/config.h"
+
+FlashQueue flashQueue;
+
+static_assert(sizeof(FlashQueueRecord) == FLASH_QUEUE_RECORD_SIZE, "flash record size");
+
+// On-board GD25Q16C on the variant's QSPI pins
+static Adafruit_FlashTransport_QSPI flashTransport;
+static Adafruit_SPIFlash flash(&flashTransport);
+
+// Offset of the CRC: everything before it is covered
+#define RECORD_CRC_SPAN     offsetof(FlashQueueRecord, crc)
+
+// SPI NOR deep power-down (~1 uA instead of ~15 uA standby)
+#define FLASH_CMD_DEEP_POWER_DOWN   0xB9
+#define FLASH_CMD_RELEASE_POWER_DOWN 0xAB
+
+FlashQueue::FlashQueue()
+    : ready(false),
+      slotCount(0),
+      head(0),
+      tail(0),
+      nextSeq(1),
+      pending(0),
+      dropped(0),
+      peekCount(0) {
+}
+
+bool FlashQueue::begin() {
+    if (!flash.begin()) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[Queue] QSPI flash not found"));
+        #endif
+        return false;
+    }
+    
+    uint32_t sectors = flash.size() / FLASH_QUEUE_SECTOR_SIZE;
+    if (sectors > FLASH_QUEUE_SECTORS) sectors = FLASH_QUEUE_SECTORS;
+    slotCount = sectors * FLASH_QUEUE_RECORDS_PER_SECTOR;
+    
+    recover();
+    ready = true;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Queue] Flash "));
+    Serial.print(flash.size() / 1024);
+    Serial.print(F(" KB, "));
+    Serial.print(slotCount);
+    Serial.print(F(" slots, "));
+    Serial.print(pending);
+    Serial.println(F(" fixes pending"));
+    #endif
+    
+    sleep();
+    return true;
+}
+
+void FlashQueue::wake() {
+    flashTransport.runCommand(FLASH_CMD_RELEASE_POWER_DOWN);
+    delayMicroseconds(30);
+}
+
+void FlashQueue::sleep() {
+    flash.waitUntilReady();
+    flashTransport.runCommand(FLASH_CMD_DEEP_POWER_DOWN);
+}
+
+uint16_t FlashQueue::crc16(const uint8_t* data, size_t len) {
+    // CRC-16/CCITT-FALSE
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+bool FlashQueue::readSlot(uint32_t slot, FlashQueueRecord& record) {
+    uint32_t n = flash.readBuffer(slot * FLASH_QUEUE_RECORD_SIZE, (uint8_t*)&record, sizeof(record));
+    return n == sizeof(record);
+}
+
+bool FlashQueue::isValid(const FlashQueueRecord& record) {
+    return record.commit == FLASH_QUEUE_COMMIT &&
+           record.crc == crc16((const uint8_t*)&record, RECORD_CRC_SPAN);
+}
+
+void FlashQueue::recover() {
+    FlashQueueRecord r;
+    uint32_t sectors = slotCount / FLASH_QUEUE_RECORDS_PER_SECTOR;
+    
+    // Newest and oldest sectors by the sequence number of their first record
+    bool any = false;
+    uint32_t newest = 0, newestSeq = 0;
+    uint32_t oldest = 0, oldestSeq = 0xFFFFFFFF;
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (!readSlot(s * FLASH_QUEUE_RECORDS_PER_SECTOR, r) || !isValid(r)) continue;
+        if (!any || r.seq > newestSeq) {
+            newest = s;
+            newestSeq = r.seq;
+        }
+        if (r.seq < oldestSeq) {
+            oldest = s;
+            oldestSeq = r.seq;
+        }
+        any = true;
+    }
+    
+    if (!any) {
+        head = tail = 0;
+        nextSeq = 1;
+        pending = 0;
+        return;
+    }
+    
+    // Head: first never-programmed slot in the newest sector. Torn records
+    // (programmed but not committed) are skipped, never reused.
+    uint32_t first = newest * FLASH_QUEUE_RECORDS_PER_SECTOR;
+    head = first + FLASH_QUEUE_RECORDS_PER_SECTOR;
+    nextSeq = newestSeq + 1;
+    for (uint32_t slot = first; slot < first + FLASH_QUEUE_RECORDS_PER_SECTOR; slot++) {
+        readSlot(slot, r);
+        if (r.seq == 0xFFFFFFFF && r.commit == 0xFF) {
+            head = slot;
+            break;
+        }
+        if (isValid(r) && r.seq >= nextSeq) nextSeq = r.seq + 1;
+    }
+    head %= slotCount;
+    
+    // Tail: first committed, undelivered record from the oldest sector on.
+    // Delivery is FIFO, so a sector whose last record is delivered is done.
+    pending = 0;
+    tail = head;
+    for (uint32_t i = 0; i < sectors; i++) {
+        uint32_t s = (oldest + i) % sectors;
+        uint32_t base = s * FLASH_QUEUE_RECORDS_PER_SECTOR;
+        
+        bool done = readSlot(base + FLASH_QUEUE_RECORDS_PER_SECTOR - 1, r) && isValid(r) && r.delivered == 0x00;
+        
+        for (uint32_t slot = base; !done && slot < base + FLASH_QUEUE_RECORDS_PER_SECTOR; slot++) {
+            if (slot == head) break;
+            readSlot(slot, r);
+            if (isValid(r) && r.delivered == 0xFF) {
+                tail = slot;
+                pending = nextSeq - r.seq;
+                return;
+            }
+        }
+        if (s == newest) break;
+    }
+}
+
+void FlashQueue::eraseForHead() {
+    uint32_t sector = head / FLASH_QUEUE_RECORDS_PER_SECTOR;
+    uint32_t base = sector * FLASH_QUEUE_RECORDS_PER_SECTOR;
+    
+    // Wrapping onto undelivered records: drop them and move the tail on
+    if (pending > 0 && tail / FLASH_QUEUE_RECORDS_PER_SECTOR == sector) {
+        FlashQueueRecord r;
+        uint32_t lost = 0;
+        for (uint32_t slot = tail; slot < base + FLASH_QUEUE_RECORDS_PER_SECTOR; slot++) {
+            readSlot(slot, r);
+            if (isValid(r) && r.delivered == 0xFF) lost++;
+        }
+        pending = pending > lost ? pending - lost : 0;
+        dropped += lost;
+        tail = (base + FLASH_QUEUE_RECORDS_PER_SECTOR) % slotCount;
+        
+        #if DEBUG_SERIAL
+        Serial.print(F("[Queue] Full - dropped "));
+        Serial.print(lost);
+        Serial.println(F(" oldest fixes"));
+        #endif
+    }
+    
+    flash.eraseSector(sector);
+    flash.waitUntilReady();
+}
+
+bool FlashQueue::push(const uint8_t* payload, uint32_t utc) {
+    if (!ready) return false;
+    wake();
+    
+    if (head % FLASH_QUEUE_RECORDS_PER_SECTOR == 0) {
+        eraseForHead();
+    }
+    
+    FlashQueueRecord r;
+    memset(&r, 0xFF, sizeof(r));
+    r.seq = nextSeq;
+    r.utc = utc;
+    memcpy(r.payload, payload, TTNMAPPER_PAYLOAD_SIZE);
+    r.crc = crc16((const uint8_t*)&r, RECORD_CRC_SPAN);
+    
+    // Body first, then the commit byte: a torn write stays uncommitted
+    uint32_t addr = head * FLASH_QUEUE_RECORD_SIZE;
+    flash.writeBuffer(addr, (const uint8_t*)&r, RECORD_CRC_SPAN + sizeof(r.crc));
+    flash.waitUntilReady();
+    uint8_t commit = FLASH_QUEUE_COMMIT;
+    flash.writeBuffer(addr + offsetof(FlashQueueRecord, commit), &commit, 1);
+    
+    if (pending == 0) tail = head;
+    head = (head + 1) % slotCount;
+    nextSeq++;
+    pending++;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Queue] Stored fix #"));
+    Serial.print(r.seq);
+    Serial.print(F(", "));
+    Serial.print(pending);
+    Serial.println(F(" pending"));
+    #endif
+    
+    sleep();
+    return true;
+}
+
+uint8_t FlashQueue::peek(FlashQueueRecord* records, uint8_t max) {
+    peekCount = 0;
+    if (!ready || pending == 0) return 0;
+    if (max > FLASH_QUEUE_PEEK_MAX) max = FLASH_QUEUE_PEEK_MAX;
+    wake();
+    
+    for (uint32_t slot = tail; slot != head && peekCount < max; slot = (slot + 1) % slotCount) {
+        if (!readSlot(slot, records[peekCount])) break;
+        if (isValid(records[peekCount]) && records[peekCount].delivered == 0xFF) {
+            peekSlots[peekCount++] = slot;
+        }
+    }
+    
+    sleep();
+    return peekCount;
+}
+
+void FlashQueue::markDelivered(uint8_t count) {
+    if (count > peekCount) count = peekCount;
+    if (count == 0) return;
+    wake();
+    
+    // 0xFF -> 0x00 needs no erase; a crash before this only means a resend
+    uint8_t delivered = 0x00;
+    for (uint8_t i = 0; i < count; i++) {
+        flash.writeBuffer(peekSlots[i] * FLASH_QUEUE_RECORD_SIZE + offsetof(FlashQueueRecord, delivered),
+                          &delivered, 1);
+        flash.waitUntilReady();
+    }
+    
+    tail = (peekSlots[count - 1] + 1) % slotCount;
+    pending = pending > count ? pending - count : 0;
+    peekCount = 0;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Queue] "));
+    Serial.print(count);
+    Serial.print(F(" fixes acknowledged, "));
+    Serial.print(pending);
+    Serial.println(F(" pending"));
+    #endif
+    
+    sleep();
+}
@@ -0,0 +1,73 @@
+#ifndef FLASH_QUEUE_H
+#define FLASH_QUEUE_H
+
+#include <Arduino.h>
+#include <Adafruit_SPIFlash.h>
+#include "payload.h"
+
+#define FLASH_QUEUE_SECTOR_SIZE     4096
+#define FLASH_QUEUE_RECORD_SIZE     32
+#define FLASH_QUEUE_RECORDS_PER_SECTOR (FLASH_QUEUE_SECTOR_SIZE / FLASH_QUEUE_RECORD_SIZE)
+#define FLASH_QUEUE_COMMIT          0xA5
+#define FLASH_QUEUE_PEEK_MAX        16
+
+// One queued fix, 32 bytes in flash. Fields are programmed before the commit
+// byte, so a record torn by power loss never looks committed. Delivery is a
+// second 1 -> 0 program of the delivered byte: no erase needed.
+struct FlashQueueRecord {
+    uint32_t seq;                               // Monotonic, 0xFFFFFFFF = erased
+    uint32_t utc;                               // Fix time, 0 if unknown
+    uint8_t payload[TTNMAPPER_PAYLOAD_SIZE];    // TTNMapper-encoded fix
+    uint16_t crc;                               // CRC-16/CCITT of seq..payload
+    uint8_t commit;                             // FLASH_QUEUE_COMMIT once complete
+    uint8_t delivered;                          // 0xFF = pending, 0x00 = acknowledged
+    uint8_t reserved[FLASH_QUEUE_RECORD_SIZE - 21];
+} __attribute__((packed));
+
+// Store-and-forward queue of fixes that could not be sent, as a circular
+// log on the QSPI flash. The oldest sector is erased (and its undelivered
+// records dropped) when the log wraps.
+class FlashQueue {
+public:
+    FlashQueue();
+    
+    // Initialization: mount the flash and recover head/tail by scanning
+    bool begin();
+    bool isReady() { return ready; }
+    
+    // Append a fix
+    bool push(const uint8_t* payload, uint32_t utc);
+    
+    // Oldest pending records (at most max); markDelivered(n) acknowledges
+    // the first n of the last peek
+    uint8_t peek(FlashQueueRecord* records, uint8_t max);
+    void markDelivered(uint8_t count);
+    
+    uint32_t getPending() { return pending; }
+    uint32_t getDropped() { return dropped; }
+
+private:
+    bool ready;
+    uint32_t slotCount;
+    uint32_t head;              // Next slot to write
+    uint32_t tail;              // Oldest slot that may be pending
+    uint32_t nextSeq;
+    uint32_t pending;
+    uint32_t dropped;           // Pending records lost to wrap-around
+    
+    uint32_t peekSlots[FLASH_QUEUE_PEEK_MAX];
+    uint8_t peekCount;
+    
+    bool readSlot(uint32_t slot, FlashQueueRecord& record);
+    bool isValid(const FlashQueueRecord& record);
+    static uint16_t crc16(const uint8_t* data, size_t len);
+    void recover();
+    void eraseForHead();
+    void wake();
+    void sleep();
+};
+
+// Global flash queue instance
+extern FlashQueue flashQueue;
+
+#endif // FLASH_QUEUE_H
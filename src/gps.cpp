@@ -1,17 +1,58 @@
 #include "gps.h"
+#include "gps_uart.h"
+#include "timebase.h"
+#include "constellation.h"
+#include "power.h"
 #include "../include/pins.h"
 #include "../include/config.h"
 
 GPS gpsModule;
 
-GPS::GPS() : isEnabled(false) {
-    gpsSerial = &Serial1;  // Use Serial1 for GPS on nRF52840
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+// Inverse of daysFromCivil()
+static void civilFromDays(int32_t z, int32_t& y, uint32_t& m, uint32_t& d) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int32_t)yoe + era * 400 + (m <= 2);
+}
+
+GPS::GPS()
+    : isEnabled(false),
+      powerHeld(false),
+      locationMillis(0),
+      epochReady(false),
+      #if FIX_POLICY_CONVERGENCE
+      fixPolicy(&convergencePolicy),
+      #else
+      fixPolicy(&firstFixPolicy),
+      #endif
+      timeToAccept(0),
+      profile(GPS_PROFILE_FULL),
+      profileSince(0),
+      profileBytesSince(0),
+      hasAiding(false) {
+    memset(&aiding, 0, sizeof(aiding));
+    memset(profileStats, 0, sizeof(profileStats));
 }
 
 bool GPS::begin() {
     // Enable power to GPS module
-    pinMode(PIN_POWER_EN, OUTPUT);
-    digitalWrite(PIN_POWER_EN, HIGH);
+    holdPower(true);
     delay(100);
     
     // Configure GPS control pins
@@ -27,9 +68,12 @@ bool GPS::begin() {
     // Keep GPS awake
     digitalWrite(GPS_WAKEUP_PIN, HIGH);
     
-    // Initialize UART for GPS
-    // Serial1 pins are defined in variant.h: RX=P1.9, TX=P1.8
-    gpsSerial->begin(GPS_BAUD_RATE);
+    // Initialize UARTE1 + EasyDMA receive path for GPS (RX=P1.9, TX=P1.8)
+    // The reset above returns the module to its default baud rate
+    profile = GPS_PROFILE_FULL;
+    if (!gpsUart.begin(GPS_BAUD_RATE)) {
+        return false;
+    }
     
     delay(1000);  // Give GPS time to boot
     
@@ -42,10 +86,12 @@ bool GPS::begin() {
     // Check if GPS is sending any data
     uint32_t checkStart = millis();
     int bytesFound = 0;
-    while (millis() - checkStart < 2000) {
-        if (gpsSerial->available()) {
+    uint32_t checkElapsed;
+    while ((checkElapsed = millis() - checkStart) < 2000) {
+        gpsUart.waitForSentence(2000 - checkElapsed);
+        while (gpsUart.available()) {
             bytesFound++;
-            char c = gpsSerial->read();
+            char c = gpsUart.read();
             if (bytesFound < 100) Serial.print(c);
         }
     }
@@ -56,8 +102,23 @@ bool GPS::begin() {
     #endif
     
     // Configure GPS for optimal performance
+    constellations.begin();
     configureGPS();
     
+    // Load the last fix so the module does not have to cold-start
+    hasAiding = nvsStorage.loadLastFix(aiding) && aiding.utc != 0;
+    #if DEBUG_SERIAL
+    if (hasAiding) {
+        Serial.print(F("[GPS] Last fix loaded: "));
+        Serial.print(aiding.latitude / 1e7, 6);
+        Serial.print(F(", "));
+        Serial.print(aiding.longitude / 1e7, 6);
+        Serial.print(F(" @ "));
+        Serial.println(aiding.utc);
+    }
+    #endif
+    injectAiding();
+    
     isEnabled = true;
     
     #if DEBUG_SERIAL
@@ -67,12 +128,34 @@ bool GPS::begin() {
     return true;
 }
 
+bool GPS::resume(GPSProfile retained) {
+    // Latch the levels before driving the pins: a low RESET would wipe
+    // the ephemeris the module kept, a high WAKEUP would wake it now
+    digitalWrite(GPS_RESET_PIN, HIGH);
+    digitalWrite(GPS_WAKEUP_PIN, LOW);
+    pinMode(GPS_RESET_PIN, OUTPUT);
+    pinMode(GPS_WAKEUP_PIN, OUTPUT);
+    
+    // UART and power come back with gpsPower.leave() -> wakeup()
+    profile = retained < GPS_PROFILE_COUNT ? retained : GPS_PROFILE_FULL;
+    constellations.begin();
+    
+    hasAiding = nvsStorage.loadLastFix(aiding) && aiding.utc != 0;
+    isEnabled = true;
+    
+    #if DEBUG_SERIAL
+    Serial.println(F("[GPS] Resumed L76K GPS module"));
+    #endif
+    
+    return true;
+}
+
 void GPS::enable() {
     if (!isEnabled) {
-        digitalWrite(PIN_POWER_EN, HIGH);
+        holdPower(true);
         digitalWrite(GPS_WAKEUP_PIN, HIGH);
         delay(100);
-        gpsSerial->begin(GPS_BAUD_RATE);
+        gpsUart.begin(profileBaud(profile));
         isEnabled = true;
         
         #if DEBUG_SERIAL
@@ -84,7 +167,7 @@ void GPS::enable() {
 void GPS::disable() {
     if (isEnabled) {
         sleep();
-        gpsSerial->end();
+        gpsUart.end();
         digitalWrite(GPS_WAKEUP_PIN, LOW);
         isEnabled = false;
         
@@ -94,35 +177,141 @@ void GPS::disable() {
     }
 }
 
+void GPS::holdPower(bool on) {
+    // POWER_GPS is held while the module tracks (it keeps the rail up)
+    if (on == powerHeld) return;
+    powerHeld = on;
+    if (on) {
+        power.acquire(POWER_GPS);
+    } else {
+        power.release(POWER_GPS);
+    }
+}
+
 void GPS::sleep() {
     // Send standby command to L76K
     sendCommand("$PMTK161,0*28");  // Standby mode
     delay(100);
     digitalWrite(GPS_WAKEUP_PIN, LOW);
     
+    // Nothing to receive in standby; UARTE RX would keep HFCLK running
+    gpsUart.end();
+    holdPower(false);
+    
     #if DEBUG_SERIAL
     Serial.println(F("[GPS] Sleep mode"));
     #endif
 }
 
 void GPS::wakeup() {
+    holdPower(true);
     digitalWrite(GPS_WAKEUP_PIN, HIGH);
     delay(100);
+    gpsUart.begin(profileBaud(profile));
     
     // Send any byte to wake up from standby
-    gpsSerial->write(0xFF);
+    static const uint8_t wakeByte = 0xFF;
+    gpsUart.write(&wakeByte, 1);
     delay(100);
     
     #if DEBUG_SERIAL
     Serial.println(F("[GPS] Wakeup"));
     #endif
+    
+    injectAiding();
 }
 
-void GPS::configureGPS() {
-    // Set GPS+GLONASS mode for better accuracy
-    // PMTK353: GPS + GLONASS
-    sendCommand("$PMTK353,1,1,0,0,0*2A");
+void GPS::backup() {
+    // Backup mode: only the RTC and backup RAM stay powered, so ephemeris
+    // and time survive. The module leaves it when WAKEUP is driven high.
+    sendSentence("PMTK225,4");
     delay(100);
+    digitalWrite(GPS_WAKEUP_PIN, LOW);
+    gpsUart.end();
+    holdPower(false);
+    
+    #if DEBUG_SERIAL
+    Serial.println(F("[GPS] Backup mode"));
+    #endif
+}
+
+bool GPS::getUTC(uint32_t& utc) {
+    utc = timebase.nowUTC();
+    return utc != 0;
+}
+
+void GPS::injectAiding() {
+    #if GPS_AIDING_ENABLED
+    if (!hasAiding) return;
+    
+    // Position aiding without a current time does more harm than good.
+    // At boot the timebase is seeded from the PCF8563 when it holds UTC.
+    uint32_t utc;
+    if (!getUTC(utc)) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[GPS] No UTC reference yet, aiding skipped"));
+        #endif
+        return;
+    }
+    
+    int32_t year;
+    uint32_t month, day;
+    civilFromDays((int32_t)(utc / 86400), year, month, day);
+    uint32_t secs = utc % 86400;
+    
+    uint32_t lat = aiding.latitude < 0 ? -aiding.latitude : aiding.latitude;
+    uint32_t lon = aiding.longitude < 0 ? -aiding.longitude : aiding.longitude;
+    
+    // PMTK741: reference location and UTC for hot start
+    char body[80];
+    snprintf(body, sizeof(body), "PMTK741,%s%lu.%07lu,%s%lu.%07lu,%ld,%04ld,%02lu,%02lu,%02lu,%02lu,%02lu",
+             aiding.latitude < 0 ? "-" : "", (unsigned long)(lat / 10000000), (unsigned long)(lat % 10000000),
+             aiding.longitude < 0 ? "-" : "", (unsigned long)(lon / 10000000), (unsigned long)(lon % 10000000),
+             (long)(aiding.altitude / 100), (long)year, (unsigned long)month, (unsigned long)day,
+             (unsigned long)(secs / 3600), (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60));
+    sendSentence(body);
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[GPS] Aiding injected: "));
+    Serial.println(body);
+    #endif
+    #endif
+}
+
+void GPS::saveAiding() {
+    if (!hasValidFix()) return;
+    
+    const NMEAFix& fix = parser.fix();
+    uint32_t utc = 0;
+    if (!getUTC(utc)) return;
+    
+    if (hasAiding) {
+        // 1 m is ~90 units of 1e-7 degrees (latitude; longitude only gets smaller)
+        int32_t dLat = fix.latitude - aiding.latitude;
+        int32_t dLon = fix.longitude - aiding.longitude;
+        int32_t threshold = GPS_AIDING_SAVE_DISTANCE_M * 90;
+        bool moved = abs(dLat) > threshold || abs(dLon) > threshold;
+        bool stale = utc - aiding.utc > GPS_AIDING_SAVE_INTERVAL_S;
+        if (!moved && !stale) return;
+    }
+    
+    aiding.latitude = fix.latitude;
+    aiding.longitude = fix.longitude;
+    aiding.altitude = fix.altitude;
+    aiding.utc = utc;
+    hasAiding = true;
+    
+    nvsStorage.saveLastFix(aiding);
+}
+
+void GPS::applyConstellations() {
+    sendSentence(constellations.getCommand(constellations.getCurrent()));
+    delay(100);
+}
+
+void GPS::configureGPS() {
+    // PMTK353: constellation set (GPS+GLONASS unless learned otherwise)
+    applyConstellations();
     
     // Set update rate to 1Hz
     sendCommand("$PMTK220,1000*1F");
@@ -133,20 +322,164 @@ void GPS::configureGPS() {
     delay(100);
     
     #if DEBUG_SERIAL
-    Serial.println(F("[GPS] Configuration: GPS+GLONASS, 1Hz, GGA+RMC+GSA+GSV"));
+    Serial.print(F("[GPS] Configuration: "));
+    Serial.print(constellations.getName(constellations.getCurrent()));
+    Serial.println(F(", 1Hz, GGA+RMC+GSA+GSV"));
+    #endif
+    
+    profileSince = millis();
+    profileBytesSince = gpsUart.getStats().bytesReceived;
+    
+    #if GPS_ACQ_PROFILE
+    setProfile(GPS_PROFILE_ACQUISITION);
+    #endif
+}
+
+uint32_t GPS::profileBaud(GPSProfile p) {
+    return p == GPS_PROFILE_ACQUISITION ? GPS_ACQ_BAUD_RATE : GPS_BAUD_RATE;
+}
+
+void GPS::accountProfile() {
+    uint32_t now = millis();
+    uint32_t bytes = gpsUart.getStats().bytesReceived;
+    profileStats[profile].bytes += bytes - profileBytesSince;
+    profileStats[profile].activeMs += now - profileSince;
+    profileSince = now;
+    profileBytesSince = bytes;
+}
+
+bool GPS::setProfile(GPSProfile newProfile) {
+    if (newProfile == profile) return true;
+    
+    accountProfile();
+    
+    // Sentence selection first, at the current baud rate
+    if (newProfile == GPS_PROFILE_ACQUISITION) {
+        sendSentence("PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");   // RMC + GGA
+    } else {
+        sendSentence("PMTK314,0,1,0,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0");   // RMC + GGA + GSA + GSV
+    }
+    delay(100);
+    
+    uint32_t oldBaud = profileBaud(profile);
+    uint32_t newBaud = profileBaud(newProfile);
+    if (newBaud != oldBaud) {
+        char body[20];
+        snprintf(body, sizeof(body), "PMTK251,%lu", (unsigned long)newBaud);
+        sendSentence(body);
+        delay(100);
+        gpsUart.setBaudRate(newBaud);
+        
+        // Confirm the module followed; otherwise fall back to the old rate
+        uint32_t passed = parser.stats().passed;
+        uint32_t start = millis();
+        while (millis() - start < 2500 && parser.stats().passed == passed) {
+            gpsUart.waitForSentence(500);
+            drainUart();
+        }
+        if (parser.stats().passed == passed) {
+            #if DEBUG_SERIAL
+            Serial.print(F("[GPS] No sentences at "));
+            Serial.print(newBaud);
+            Serial.println(F(" baud, reverting"));
+            #endif
+            gpsUart.setBaudRate(oldBaud);
+            profileBytesSince = gpsUart.getStats().bytesReceived;
+            return false;
+        }
+    }
+    
+    profile = newProfile;
+    profileBytesSince = gpsUart.getStats().bytesReceived;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[GPS] Profile: "));
+    Serial.print(newProfile == GPS_PROFILE_ACQUISITION ? F("ACQ (GGA+RMC)") : F("FULL (GGA+RMC+GSA+GSV)"));
+    Serial.print(F(" @ "));
+    Serial.print(newBaud);
+    Serial.println(F(" baud"));
+    #endif
+    
+    return true;
+}
+
+void GPS::printProfileStats() {
+    #if DEBUG_SERIAL
+    accountProfile();
+    
+    for (uint8_t p = 0; p < GPS_PROFILE_COUNT; p++) {
+        const GPSProfileStats& st = profileStats[p];
+        if (st.activeMs == 0) continue;
+        
+        // 10 bit times per byte (8N1)
+        uint32_t baud = profileBaud((GPSProfile)p);
+        uint32_t bytesPerSec = (uint32_t)((uint64_t)st.bytes * 1000 / st.activeMs);
+        uint32_t uartMs = (uint32_t)((uint64_t)st.bytes * 10 * 1000 / baud);
+        
+        Serial.print(F("[GPS] Profile "));
+        Serial.print(p == GPS_PROFILE_ACQUISITION ? F("ACQ") : F("FULL"));
+        Serial.print(F(": "));
+        Serial.print(bytesPerSec);
+        Serial.print(F(" B/s, UART active "));
+        Serial.print(uartMs);
+        Serial.print(F(" ms of "));
+        Serial.print(st.activeMs);
+        Serial.print(F(" ms ("));
+        Serial.print(st.activeMs ? (float)uartMs * 100.0f / st.activeMs : 0.0f, 2);
+        Serial.println(F("%)"));
+    }
     #endif
 }
 
 void GPS::sendCommand(const char* cmd) {
-    gpsSerial->println(cmd);
-    gpsSerial->flush();
+    gpsUart.print(cmd);
+    gpsUart.print("\r\n");
 }
 
-bool GPS::update() {
-    while (gpsSerial->available() > 0) {
-        char c = gpsSerial->read();
-        gps.encode(c);
+void GPS::sendSentence(const char* body) {
+    // Wrap a sentence body as $<body>*<checksum>
+    uint8_t checksum = 0;
+    for (const char* p = body; *p; p++) {
+        checksum ^= (uint8_t)*p;
+    }
+    
+    char sentence[96];
+    snprintf(sentence, sizeof(sentence), "$%s*%02X", body, checksum);
+    sendCommand(sentence);
+}
+
+void GPS::feed(char c) {
+    if (!parser.encode(c) || !parser.lastHadLocation()) return;
+    
+    locationMillis = millis();
+    if (parser.lastSentence() == NMEAParser::SENTENCE_GGA) {
+        epochReady = true;
     }
+    
+    // Only trust RMC time once the receiver reports a valid fix
+    const NMEAFix& fix = parser.fix();
+    if (parser.lastSentence() == NMEAParser::SENTENCE_RMC && fix.dateValid && fix.timeValid) {
+        uint32_t hhmmss = fix.time / 100;
+        int32_t days = daysFromCivil(2000 + fix.date % 100, (fix.date / 100) % 100, fix.date / 10000);
+        timebase.onGPSTime((uint32_t)days * 86400 +
+                           (hhmmss / 10000) * 3600 + (hhmmss / 100 % 100) * 60 + hhmmss % 100);
+    }
+}
+
+void GPS::drainUart() {
+    int c;
+    while ((c = gpsUart.read()) >= 0) {
+        feed((char)c);
+    }
+}
+
+uint32_t GPS::locationAge() {
+    if (!parser.fix().locationValid) return 0xFFFFFFFF;
+    return millis() - locationMillis;
+}
+
+bool GPS::update() {
+    drainUart();
     return hasValidFix();
 }
 
@@ -157,21 +490,32 @@ bool GPS::waitForFix(uint32_t timeout_ms) {
     Serial.println(F("s)..."));
     #endif
     
+    #if GPS_ACQ_PROFILE
+    setProfile(GPS_PROFILE_ACQUISITION);
+    #endif
+    
     uint32_t startTime = millis();
     uint32_t lastPrint = 0;
     uint32_t bytesReceived = 0;
     
+    fixPolicy->reset();
+    epochReady = false;
+    
     while (millis() - startTime < timeout_ms) {
+        // Sleep until the UART ISR reports a complete sentence
+        uint32_t elapsed = millis() - startTime;
+        gpsUart.waitForSentence(timeout_ms - elapsed);
+        
         // Count and process bytes
-        while (gpsSerial->available() > 0) {
-            char c = gpsSerial->read();
+        int c;
+        while ((c = gpsUart.read()) >= 0) {
             bytesReceived++;
-            gps.encode(c);
+            feed((char)c);
             
             #if DEBUG_SERIAL
             // Print raw NMEA data for first 10 seconds
             if (millis() - startTime < 10000) {
-                Serial.print(c);
+                Serial.print((char)c);
             }
             #endif
         }
@@ -179,56 +523,103 @@ bool GPS::waitForFix(uint32_t timeout_ms) {
         #if DEBUG_SERIAL
         // Print status every 5 seconds
         if (millis() - lastPrint > 5000) {
+            GPSUartStats uartStats = gpsUart.getStats();
             Serial.println();
             Serial.print(F("[GPS] Bytes: "));
             Serial.print(bytesReceived);
             Serial.print(F(", Sats: "));
-            Serial.print(gps.satellites.value());
+            Serial.print(getSatellites());
             Serial.print(F(", HDOP: "));
-            Serial.print(gps.hdop.hdop());
+            Serial.print(getHDOP());
             Serial.print(F(", Valid: "));
             Serial.println(hasValidFix() ? F("YES") : F("NO"));
+            Serial.print(F("[GPS] Sentences: "));
+            Serial.print(uartStats.sentences);
+            Serial.print(F(", Checksum fail: "));
+            Serial.print(parser.stats().failed);
+            Serial.print(F(", Filtered: "));
+            Serial.print(parser.stats().filtered);
+            Serial.print(F(", Overruns: "));
+            Serial.print(uartStats.overruns);
+            Serial.print(F(", UART errors: "));
+            Serial.println(uartStats.hwErrors);
             lastPrint = millis();
         }
         #endif
         
-        if (hasValidFix()) {
+        if (!epochReady) continue;
+        epochReady = false;
+        if (!hasValidFix()) continue;
+        
+        const NMEAFix& fix = parser.fix();
+        FixSample sample = { fix.latitude, fix.longitude, fix.hdop, fix.satellites };
+        if (fixPolicy->addSample(sample)) {
+            timeToAccept = millis() - startTime;
+            
             #if DEBUG_SERIAL
             Serial.println(F("[GPS] Valid fix acquired!"));
+            Serial.print(F("[GPS] Accepted by "));
+            Serial.print(fixPolicy->name());
+            Serial.print(F(" policy after "));
+            Serial.print(timeToAccept);
+            Serial.print(F(" ms ("));
+            Serial.print(fixPolicy->getSampleCount());
+            Serial.print(F(" epochs, jitter "));
+            Serial.print(fixPolicy->getJitter(), 1);
+            Serial.println(F(" m)"));
+            GPSData data = getData();
             Serial.print(F("[GPS] Location: "));
-            Serial.print(gps.location.lat(), 6);
+            Serial.print(data.latitude, 6);
             Serial.print(F(", "));
-            Serial.print(gps.location.lng(), 6);
+            Serial.print(data.longitude, 6);
             Serial.print(F(", Alt: "));
-            Serial.print(gps.altitude.meters(), 1);
+            Serial.print(data.altitude, 1);
             Serial.println(F("m"));
             #endif
+            
+            saveAiding();
+            printProfileStats();
             return true;
         }
+    }
+    
+    // Never worse than the old behaviour: a usable fix at timeout is still taken
+    if (hasValidFix()) {
+        timeToAccept = millis() - startTime;
         
-        delay(100);
+        #if DEBUG_SERIAL
+        Serial.print(F("[GPS] Timeout - policy not satisfied, using last fix (HDOP "));
+        Serial.print(getHDOP(), 2);
+        Serial.println(F(")"));
+        #endif
+        
+        saveAiding();
+        printProfileStats();
+        return true;
     }
     
     #if DEBUG_SERIAL
     Serial.println(F("[GPS] Timeout - no valid fix"));
     #endif
+    printProfileStats();
     
     return false;
 }
 
 bool GPS::hasValidFix() {
-    return gps.location.isValid() && 
-           gps.location.age() < 2000 &&
-           gps.satellites.value() >= MIN_SATELLITES &&
-           gps.hdop.isValid();
+    const NMEAFix& fix = parser.fix();
+    return fix.locationValid &&
+           locationAge() < 2000 &&
+           fix.satellites >= MIN_SATELLITES &&
+           fix.hdopValid;
 }
 
 uint8_t GPS::getSatellites() {
-    return gps.satellites.value();
+    return parser.fix().satellites;
 }
 
 double GPS::getHDOP() {
-    return gps.hdop.hdop();
+    return parser.fix().hdop / 100.0;
 }
 
 GPSData GPS::getData() {
@@ -237,19 +628,29 @@ GPSData GPS::getData() {
     data.valid = hasValidFix();
     
     if (data.valid) {
-        data.latitude = gps.location.lat();
-        data.longitude = gps.location.lng();
-        data.altitude = gps.altitude.meters();
-        data.hdop = gps.hdop.hdop();
-        data.satellites = gps.satellites.value();
-        data.fixAge = gps.location.age();
+        // Single conversion from fixed point per accepted fix
+        const NMEAFix& fix = parser.fix();
+        data.latitude = fix.latitude / 1e7;
+        data.longitude = fix.longitude / 1e7;
+        data.altitude = fix.altitude / 100.0;
+        data.hdop = fix.hdop / 100.0;
+        data.speed = fix.speedValid ? fix.speed * 1.852 / 100.0 : -1.0;
+        data.course = fix.course / 100.0;
+        data.satellites = fix.satellites;
+        data.fixAge = locationAge();
+        
+        uint32_t now;
+        data.utc = getUTC(now) ? now - data.fixAge / 1000 : 0;
     } else {
         data.latitude = 0.0;
         data.longitude = 0.0;
         data.altitude = 0.0;
         data.hdop = 99.9;
+        data.speed = -1.0;
+        data.course = 0.0;
         data.satellites = 0;
         data.fixAge = 0xFFFFFFFF;
+        data.utc = 0;
     }
     
     return data;
@@ -2,7 +2,22 @@
 #define GPS_H
 
 #include <Arduino.h>
-#include <TinyGPSPlus.h>
+#include "nmea.h"
+#include "nvs.h"
+#include "fix_policy.h"
+
+// NMEA output profiles
+enum GPSProfile {
+    GPS_PROFILE_FULL,           // GGA+RMC+GSA+GSV @ GPS_BAUD_RATE (diagnostics)
+    GPS_PROFILE_ACQUISITION,    // GGA+RMC only @ GPS_ACQ_BAUD_RATE (fix wait)
+    GPS_PROFILE_COUNT
+};
+
+// Per-profile UART accounting
+struct GPSProfileStats {
+    uint32_t bytes;             // Bytes received while the profile was active
+    uint32_t activeMs;          // Time the profile was active
+};
 
 // GPS data structure
 struct GPSData {
@@ -10,9 +25,12 @@ struct GPSData {
     double longitude;
     double altitude;
     double hdop;
+    double speed;       // km/h over ground (RMC), negative if not reported
+    double course;      // Degrees true (RMC)
     uint8_t satellites;
     bool valid;
     uint32_t fixAge;
+    uint32_t utc;       // Unix time of the fix, 0 if unknown
 };
 
 class GPS {
@@ -22,11 +40,16 @@ public:
     // Initialization
     bool begin();
     
+    // Initialization after a System OFF wake: the module kept its
+    // configuration in standby/backup, so no reset and no output check
+    bool resume(GPSProfile retained);
+    
     // Power management
     void enable();
     void disable();
     void sleep();
     void wakeup();
+    void backup();
     
     // GPS operations
     bool waitForFix(uint32_t timeout_ms);
@@ -38,16 +61,59 @@ public:
     uint8_t getSatellites();
     double getHDOP();
     
-    // Direct access to TinyGPS++ object
-    TinyGPSPlus& getGPS() { return gps; }
+    uint32_t getChecksumFailures() { return parser.stats().failed; }
+    
+    // UTC (Unix time) from the shared timebase
+    bool getUTC(uint32_t& utc);
+    
+    // Fix acceptance
+    void setFixPolicy(FixPolicy* policy) { fixPolicy = policy; }
+    uint32_t getTimeToAccept() { return timeToAccept; }
+    
+    // Output profile
+    bool setProfile(GPSProfile profile);
+    GPSProfile getProfile() { return profile; }
+    void printProfileStats();
+    
+    // Send the constellation set chosen by the selector
+    void applyConstellations();
+    
+    // Hot-start aiding
+    void injectAiding();
+    void saveAiding();
+    
+    // Direct access to the NMEA parser
+    const NMEAParser& getParser() { return parser; }
 
 private:
-    TinyGPSPlus gps;
-    HardwareSerial* gpsSerial;
+    NMEAParser parser;
     bool isEnabled;
+    bool powerHeld;            // POWER_GPS reference taken
+    uint32_t locationMillis;   // millis() of the last committed position
+    bool epochReady;           // New GGA position since the policy last looked
+    
+    FixPolicy* fixPolicy;
+    uint32_t timeToAccept;     // ms from waitForFix() start to acceptance
+    
+    // Output profile and accounting
+    GPSProfile profile;
+    uint32_t profileSince;          // millis() when the profile was last accounted
+    uint32_t profileBytesSince;     // UART byte count at that time
+    GPSProfileStats profileStats[GPS_PROFILE_COUNT];
+    
+    // Last fix loaded from / saved to NVS
+    GPSFixRecord aiding;
+    bool hasAiding;
     
+    uint32_t locationAge();
+    uint32_t profileBaud(GPSProfile p);
+    void accountProfile();
+    void feed(char c);
+    void drainUart();
     void sendCommand(const char* cmd);
+    void sendSentence(const char* body);
     void configureGPS();
+    void holdPower(bool on);
 };
 
 // Global GPS instance
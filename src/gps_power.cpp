@@ -0,0 +1,157 @@
+#include "gps_power.h"
+#include "gps.h"
+#include "../include/config.h"
+
+GPSPowerScheduler gpsPower;
+
+GPSPowerScheduler::GPSPowerScheduler()
+    : mode(GPS_POWER_TRACKING),
+      pendingStart(GPS_START_COLD),
+      hasFix(false),
+      lastFixMillis(0),
+      wakeMillis(0) {
+    ttffMs[GPS_START_STANDBY] = GPS_TTFF_STANDBY_MS;
+    ttffMs[GPS_START_HOT] = GPS_TTFF_HOT_MS;
+    ttffMs[GPS_START_WARM] = GPS_TTFF_WARM_MS;
+    ttffMs[GPS_START_COLD] = GPS_TTFF_COLD_MS;
+}
+
+uint32_t GPSPowerScheduler::getSecondsSinceFix() {
+    if (!hasFix) return 0xFFFFFFFF;
+    return (millis() - lastFixMillis) / 1000;
+}
+
+GPSStartType GPSPowerScheduler::startTypeAfter(GPSPowerMode m, uint32_t sleepMs) {
+    if (!hasFix) return GPS_START_COLD;
+    
+    // Both keep time and ephemeris; standby also keeps the receiver's
+    // tracking state, backup has to search for the satellites again
+    uint32_t ageAtWake = getSecondsSinceFix() + sleepMs / 1000;
+    if (ageAtWake >= GPS_EPHEMERIS_VALID_S) return GPS_START_WARM;
+    return m == GPS_POWER_BACKUP ? GPS_START_HOT : GPS_START_STANDBY;
+}
+
+uint64_t GPSPowerScheduler::cost(GPSPowerMode m, uint32_t sleepMs) {
+    // Expected charge in uA*ms: retention current over the sleep plus
+    // acquisition current over the expected time to first fix
+    uint64_t restart = (uint64_t)GPS_CURRENT_ACQ_UA * ttffMs[startTypeAfter(m, sleepMs)];
+    
+    switch (m) {
+        case GPS_POWER_TRACKING:
+            return (uint64_t)GPS_CURRENT_ACQ_UA * sleepMs;
+        case GPS_POWER_STANDBY:
+            return (uint64_t)GPS_CURRENT_STANDBY_UA * sleepMs + restart;
+        case GPS_POWER_BACKUP:
+        default:
+            return (uint64_t)GPS_CURRENT_BACKUP_UA * sleepMs + restart;
+    }
+}
+
+GPSPowerMode GPSPowerScheduler::choose(uint32_t sleepMs) {
+    GPSPowerMode best = GPS_POWER_TRACKING;
+    uint64_t bestCost = cost(GPS_POWER_TRACKING, sleepMs);
+    
+    for (uint8_t m = GPS_POWER_STANDBY; m < GPS_POWER_MODE_COUNT; m++) {
+        uint64_t c = cost((GPSPowerMode)m, sleepMs);
+        if (c < bestCost) {
+            bestCost = c;
+            best = (GPSPowerMode)m;
+        }
+    }
+    
+    #if DEBUG_SERIAL
+    static const char* const names[] = { "TRACKING", "STANDBY", "BACKUP" };
+    Serial.print(F("[GPSPower] Sleep "));
+    Serial.print(sleepMs / 1000);
+    Serial.print(F("s, last fix "));
+    if (hasFix) {
+        Serial.print(getSecondsSinceFix());
+        Serial.print(F("s ago"));
+    } else {
+        Serial.print(F("never"));
+    }
+    Serial.print(F(" -> "));
+    Serial.print(names[best]);
+    Serial.print(F(" (expected "));
+    Serial.print((uint32_t)(bestCost / 1000000));
+    Serial.println(F(" mAs)"));
+    #endif
+    
+    return best;
+}
+
+void GPSPowerScheduler::enter(GPSPowerMode newMode) {
+    // Stationary cycles skip leave(), so the GPS may already be there
+    if (newMode == mode) return;
+    
+    switch (newMode) {
+        case GPS_POWER_TRACKING:
+            break;
+        case GPS_POWER_STANDBY:
+            gpsModule.sleep();
+            break;
+        case GPS_POWER_BACKUP:
+            gpsModule.backup();
+            break;
+        default:
+            break;
+    }
+    mode = newMode;
+}
+
+void GPSPowerScheduler::leave() {
+    // Classify the restart by the time actually spent asleep
+    pendingStart = startTypeAfter(mode, 0);
+    wakeMillis = millis();
+    
+    switch (mode) {
+        case GPS_POWER_TRACKING:
+            break;
+        case GPS_POWER_STANDBY:
+        case GPS_POWER_BACKUP:
+            gpsModule.wakeup();
+            break;
+        default:
+            break;
+    }
+    mode = GPS_POWER_TRACKING;
+}
+
+void GPSPowerScheduler::save(GPSPowerRecord& record) {
+    record.mode = mode;
+    record.hasFix = hasFix;
+    record.msSinceFix = millis() - lastFixMillis;
+    memcpy(record.ttffMs, ttffMs, sizeof(ttffMs));
+}
+
+void GPSPowerScheduler::restore(const GPSPowerRecord& record, uint32_t offMs) {
+    // The module is still in the saved mode; leave() takes it from there
+    mode = record.mode < GPS_POWER_MODE_COUNT ? (GPSPowerMode)record.mode : GPS_POWER_TRACKING;
+    hasFix = record.hasFix;
+    lastFixMillis = millis() - record.msSinceFix - offMs;
+    memcpy(ttffMs, record.ttffMs, sizeof(ttffMs));
+}
+
+void GPSPowerScheduler::recordFix() {
+    uint32_t now = millis();
+    uint32_t ttff = now - wakeMillis;
+    
+    // EWMA (1/4 weight) so the model follows the sky conditions we see
+    ttffMs[pendingStart] = (ttffMs[pendingStart] * 3 + ttff) / 4;
+    hasFix = true;
+    lastFixMillis = now;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[GPSPower] TTFF "));
+    Serial.print(ttff);
+    Serial.print(F(" ms, learned "));
+    Serial.print(ttffMs[pendingStart]);
+    Serial.println(F(" ms for this start type"));
+    #endif
+}
+
+void GPSPowerScheduler::recordTimeout() {
+    // The real TTFF was at least as long as the timeout
+    uint32_t waited = millis() - wakeMillis;
+    ttffMs[pendingStart] = (ttffMs[pendingStart] * 3 + waited) / 4;
+}
@@ -0,0 +1,70 @@
+#ifndef GPS_POWER_H
+#define GPS_POWER_H
+
+#include <Arduino.h>
+
+// GPS power states between fixes, cheapest retention last
+enum GPSPowerMode {
+    GPS_POWER_TRACKING,     // Stay on and keep tracking
+    GPS_POWER_STANDBY,      // PMTK161 standby, instant hot start
+    GPS_POWER_BACKUP,       // PMTK225 backup, RTC + ephemeris retained
+    GPS_POWER_MODE_COUNT
+};
+
+// Expected restart type after a power state
+enum GPSStartType {
+    GPS_START_STANDBY,      // Out of PMTK161: receiver state kept, near-instant
+    GPS_START_HOT,
+    GPS_START_WARM,
+    GPS_START_COLD,
+    GPS_START_TYPE_COUNT
+};
+
+// Scheduler state carried across a System OFF power-down (see checkpoint.h)
+struct GPSPowerRecord {
+    uint8_t mode;                   // GPSPowerMode the module was left in
+    bool hasFix;
+    uint32_t msSinceFix;
+    uint32_t ttffMs[GPS_START_TYPE_COUNT];
+};
+
+class GPSPowerScheduler {
+public:
+    GPSPowerScheduler();
+    
+    // Pick the mode with the lowest expected charge for a sleep of sleepMs
+    GPSPowerMode choose(uint32_t sleepMs);
+    
+    // Apply a mode before sleeping / bring the GPS back before a fix wait
+    void enter(GPSPowerMode mode);
+    void leave();
+    
+    // Fix attempt outcome (updates the learned TTFF for the start type)
+    void recordFix();
+    void recordTimeout();
+    
+    GPSPowerMode getMode() { return mode; }
+    GPSStartType getPendingStart() { return pendingStart; }
+    uint32_t getSecondsSinceFix();
+    uint32_t getExpectedTTFF(GPSStartType type) { return ttffMs[type]; }
+    
+    // Carry the state over a power-down that lasted offMs
+    void save(GPSPowerRecord& record);
+    void restore(const GPSPowerRecord& record, uint32_t offMs);
+
+private:
+    GPSPowerMode mode;
+    GPSStartType pendingStart;      // Start type expected for the current wake
+    bool hasFix;
+    uint32_t lastFixMillis;
+    uint32_t wakeMillis;
+    uint32_t ttffMs[GPS_START_TYPE_COUNT];  // EWMA of measured TTFF
+    
+    GPSStartType startTypeAfter(GPSPowerMode m, uint32_t sleepMs);
+    uint64_t cost(GPSPowerMode m, uint32_t sleepMs);
+};
+
+// Global GPS power scheduler instance
+extern GPSPowerScheduler gpsPower;
+
+#endif // GPS_POWER_H
@@ -0,0 +1,303 @@
+#include "gps_uart.h"
+#include "power.h"
+#include "../include/pins.h"
+#include "../include/config.h"
+
+GPSUart gpsUart;
+
+#define GPS_UART_RING_MASK  (GPS_UART_RING_SIZE - 1)
+
+static_assert((GPS_UART_RING_SIZE & GPS_UART_RING_MASK) == 0, "GPS_UART_RING_SIZE must be a power of two");
+
+extern "C" void UARTE1_IRQHandler(void) {
+    gpsUart.handleIRQ();
+}
+
+GPSUart::GPSUart()
+    : head(0),
+      tail(0),
+      linesIn(0),
+      linesOut(0),
+      dmaIndex(0),
+      flushing(false),
+      running(false),
+      lineSemaphore(nullptr) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t GPSUart::baudToRegister(uint32_t baud) {
+    switch (baud) {
+        case 4800:   return UARTE_BAUDRATE_BAUDRATE_Baud4800;
+        case 9600:   return UARTE_BAUDRATE_BAUDRATE_Baud9600;
+        case 19200:  return UARTE_BAUDRATE_BAUDRATE_Baud19200;
+        case 38400:  return UARTE_BAUDRATE_BAUDRATE_Baud38400;
+        case 57600:  return UARTE_BAUDRATE_BAUDRATE_Baud57600;
+        case 115200: return UARTE_BAUDRATE_BAUDRATE_Baud115200;
+        default:     return 0;
+    }
+}
+
+bool GPSUart::begin(uint32_t baud) {
+    uint32_t baudReg = baudToRegister(baud);
+    if (baudReg == 0) {
+        #if DEBUG_SERIAL
+        Serial.print(F("[GPSUart] Unsupported baud rate: "));
+        Serial.println(baud);
+        #endif
+        return false;
+    }
+    
+    if (running) {
+        end();
+    }
+    
+    if (lineSemaphore == nullptr) {
+        lineSemaphore = xSemaphoreCreateBinary();
+    }
+    
+    // TX idles high, RX is driven by the L76K
+    pinMode(GPS_TX_PIN, OUTPUT);
+    digitalWrite(GPS_TX_PIN, HIGH);
+    pinMode(GPS_RX_PIN, INPUT);
+    
+    NRF_UARTE1->PSEL.TXD = GPS_TX_PIN;
+    NRF_UARTE1->PSEL.RXD = GPS_RX_PIN;
+    NRF_UARTE1->PSEL.RTS = 0xFFFFFFFF;
+    NRF_UARTE1->PSEL.CTS = 0xFFFFFFFF;
+    NRF_UARTE1->BAUDRATE = baudReg;
+    NRF_UARTE1->CONFIG = 0;  // 8N1, no flow control
+    
+    NRF_UARTE1->EVENTS_ENDRX = 0;
+    NRF_UARTE1->EVENTS_RXSTARTED = 0;
+    NRF_UARTE1->EVENTS_RXTO = 0;
+    NRF_UARTE1->EVENTS_ERROR = 0;
+    NRF_UARTE1->EVENTS_RXDRDY = 0;
+    NRF_UARTE1->INTENSET = UARTE_INTENSET_ENDRX_Msk |
+                           UARTE_INTENSET_RXSTARTED_Msk |
+                           UARTE_INTENSET_RXTO_Msk |
+                           UARTE_INTENSET_ERROR_Msk;
+    
+    NRF_UARTE1->ENABLE = UARTE_ENABLE_ENABLE_Enabled;
+    power.acquire(POWER_UARTE);
+    
+    NVIC_ClearPendingIRQ(UARTE1_IRQn);
+    NVIC_SetPriority(UARTE1_IRQn, 3);
+    NVIC_EnableIRQ(UARTE1_IRQn);
+    
+    head = tail = 0;
+    linesOut = linesIn;
+    flushing = false;
+    dmaIndex = 0;
+    running = true;
+    startRx();
+    
+    return true;
+}
+
+void GPSUart::end() {
+    if (!running) return;
+    
+    NVIC_DisableIRQ(UARTE1_IRQn);
+    NRF_UARTE1->INTENCLR = 0xFFFFFFFF;
+    NRF_UARTE1->SHORTS = 0;
+    
+    // Stop the receiver and wait for it to release the DMA buffer
+    NRF_UARTE1->EVENTS_RXTO = 0;
+    NRF_UARTE1->TASKS_STOPRX = 1;
+    uint32_t start = millis();
+    while (!NRF_UARTE1->EVENTS_RXTO && millis() - start < 10) {
+        yield();
+    }
+    NRF_UARTE1->TASKS_STOPTX = 1;
+    
+    NRF_UARTE1->ENABLE = UARTE_ENABLE_ENABLE_Disabled;
+    NRF_UARTE1->PSEL.TXD = 0xFFFFFFFF;
+    NRF_UARTE1->PSEL.RXD = 0xFFFFFFFF;
+    power.release(POWER_UARTE);
+    
+    running = false;
+}
+
+bool GPSUart::setBaudRate(uint32_t baud) {
+    // Restarting drops at most the partial DMA chunk, which the caller
+    // discards anyway after a baud rate change
+    return begin(baud);
+}
+
+void GPSUart::startRx() {
+    NRF_UARTE1->RXD.PTR = (uint32_t)dmaBuffer[dmaIndex];
+    NRF_UARTE1->RXD.MAXCNT = GPS_UART_DMA_CHUNK;
+    NRF_UARTE1->SHORTS = UARTE_SHORTS_ENDRX_STARTRX_Msk;
+    NRF_UARTE1->TASKS_STARTRX = 1;
+}
+
+void GPSUart::flushPartial() {
+    if (flushing || !running) return;
+    
+    // STOPRX ends the current transfer early (ENDRX with the partial
+    // amount), RXTO then lets the ISR flush the FIFO and restart
+    flushing = true;
+    NRF_UARTE1->SHORTS = 0;
+    NRF_UARTE1->TASKS_STOPRX = 1;
+}
+
+bool GPSUart::pushChunk(const uint8_t* data, uint16_t len) {
+    bool gotLine = false;
+    
+    for (uint16_t i = 0; i < len; i++) {
+        uint16_t next = (head + 1) & GPS_UART_RING_MASK;
+        if (next == tail) {
+            stats.overruns++;
+            continue;
+        }
+        ring[head] = data[i];
+        head = next;
+        
+        if (data[i] == '\n') {
+            linesIn++;
+            stats.sentences++;
+            gotLine = true;
+        }
+    }
+    stats.bytesReceived += len;
+    
+    return gotLine;
+}
+
+void GPSUart::handleIRQ() {
+    BaseType_t woken = pdFALSE;
+    bool gotLine = false;
+    
+    if (NRF_UARTE1->EVENTS_ERROR) {
+        NRF_UARTE1->EVENTS_ERROR = 0;
+        NRF_UARTE1->ERRORSRC = NRF_UARTE1->ERRORSRC;  // Write-1-to-clear
+        stats.hwErrors++;
+    }
+    
+    // ENDRX must be handled before RXSTARTED so the next buffer pointer
+    // is computed from the updated dmaIndex
+    if (NRF_UARTE1->EVENTS_ENDRX) {
+        NRF_UARTE1->EVENTS_ENDRX = 0;
+        NRF_UARTE1->EVENTS_RXDRDY = 0;
+        gotLine |= pushChunk(dmaBuffer[dmaIndex], NRF_UARTE1->RXD.AMOUNT);
+        dmaIndex ^= 1;
+    }
+    
+    if (NRF_UARTE1->EVENTS_RXSTARTED) {
+        NRF_UARTE1->EVENTS_RXSTARTED = 0;
+        // Queue the idle buffer for the ENDRX->STARTRX shortcut
+        NRF_UARTE1->RXD.PTR = (uint32_t)dmaBuffer[dmaIndex ^ 1];
+    }
+    
+    if (NRF_UARTE1->EVENTS_RXTO) {
+        NRF_UARTE1->EVENTS_RXTO = 0;
+        
+        // Flush bytes still in the RX FIFO. ENDRX is not generated when the
+        // FIFO is empty, so only spin briefly for it.
+        NRF_UARTE1->EVENTS_ENDRX = 0;
+        NRF_UARTE1->TASKS_FLUSHRX = 1;
+        for (uint16_t spin = 0; spin < 1000 && !NRF_UARTE1->EVENTS_ENDRX; spin++) {
+            __NOP();
+        }
+        if (NRF_UARTE1->EVENTS_ENDRX) {
+            NRF_UARTE1->EVENTS_ENDRX = 0;
+            gotLine |= pushChunk(dmaBuffer[dmaIndex], NRF_UARTE1->RXD.AMOUNT);
+        }
+        NRF_UARTE1->EVENTS_RXDRDY = 0;
+        
+        flushing = false;
+        if (running) {
+            startRx();
+        }
+    }
+    
+    if (gotLine && lineSemaphore != nullptr) {
+        xSemaphoreGiveFromISR(lineSemaphore, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+size_t GPSUart::write(const uint8_t* data, size_t len) {
+    if (!running) return 0;
+    
+    // EasyDMA can only read from RAM, so commands are copied first
+    size_t sent = 0;
+    while (sent < len) {
+        size_t chunk = len - sent;
+        if (chunk > GPS_UART_TX_SIZE) chunk = GPS_UART_TX_SIZE;
+        memcpy(txBuffer, data + sent, chunk);
+        
+        NRF_UARTE1->EVENTS_ENDTX = 0;
+        NRF_UARTE1->TXD.PTR = (uint32_t)txBuffer;
+        NRF_UARTE1->TXD.MAXCNT = chunk;
+        NRF_UARTE1->TASKS_STARTTX = 1;
+        while (!NRF_UARTE1->EVENTS_ENDTX) {
+            yield();
+        }
+        NRF_UARTE1->EVENTS_ENDTX = 0;
+        sent += chunk;
+    }
+    
+    // Release the transmitter so it does not keep HFCLK requested
+    NRF_UARTE1->TASKS_STOPTX = 1;
+    
+    return sent;
+}
+
+size_t GPSUart::print(const char* str) {
+    return write((const uint8_t*)str, strlen(str));
+}
+
+size_t GPSUart::available() {
+    return (head - tail) & GPS_UART_RING_MASK;
+}
+
+int GPSUart::read() {
+    if (tail == head) return -1;
+    
+    uint8_t c = ring[tail];
+    tail = (tail + 1) & GPS_UART_RING_MASK;
+    if (c == '\n') {
+        linesOut++;
+    }
+    return c;
+}
+
+bool GPSUart::waitForSentence(uint32_t timeout_ms) {
+    if (!running) return false;
+    
+    uint32_t start = millis();
+    
+    while (linesIn == linesOut) {
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeout_ms) return false;
+        
+        // While a partial chunk sits in EasyDMA (RXDRDY seen since the last
+        // ENDRX) wake shortly to flush it, otherwise sleep until a line ends
+        bool partial = NRF_UARTE1->EVENTS_RXDRDY;
+        uint32_t wait = timeout_ms - elapsed;
+        uint32_t slice = partial ? GPS_UART_IDLE_MS : GPS_UART_POLL_MS;
+        if (wait > slice) wait = slice;
+        
+        if (xSemaphoreTake(lineSemaphore, pdMS_TO_TICKS(wait)) != pdTRUE) {
+            if (NRF_UARTE1->EVENTS_RXDRDY) {
+                flushPartial();
+            }
+        }
+    }
+    
+    return true;
+}
+
+GPSUartStats GPSUart::getStats() {
+    NVIC_DisableIRQ(UARTE1_IRQn);
+    GPSUartStats copy = stats;
+    if (running) NVIC_EnableIRQ(UARTE1_IRQn);
+    return copy;
+}
+
+void GPSUart::resetStats() {
+    NVIC_DisableIRQ(UARTE1_IRQn);
+    memset(&stats, 0, sizeof(stats));
+    if (running) NVIC_EnableIRQ(UARTE1_IRQn);
+}
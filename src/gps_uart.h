@@ -0,0 +1,78 @@
+#ifndef GPS_UART_H
+#define GPS_UART_H
+
+#include <Arduino.h>
+
+// L76K receive path on UARTE1 with EasyDMA.
+// Two DMA chunks ping-pong (ENDRX->STARTRX shortcut) and the ISR moves each
+// completed chunk into a ring buffer, so the CPU is interrupted once per
+// chunk instead of once per byte. The consumer task blocks on a semaphore
+// that is only given when a complete NMEA line ('\n') has arrived.
+#define GPS_UART_DMA_CHUNK      32          // Bytes per EasyDMA transfer
+#define GPS_UART_RING_SIZE      1024        // Ring buffer size (power of two)
+#define GPS_UART_TX_SIZE        96          // Longest command we send
+#define GPS_UART_IDLE_MS        20          // Line idle time before flushing a partial chunk
+#define GPS_UART_POLL_MS        250         // Longest sleep while no line is pending
+
+// Receive statistics
+struct GPSUartStats {
+    uint32_t bytesReceived;     // Bytes moved from DMA into the ring
+    uint32_t sentences;         // Complete lines seen by the ISR
+    uint32_t overruns;          // Bytes dropped because the ring was full
+    uint32_t hwErrors;          // UARTE ERROR events (overrun/parity/framing/break)
+};
+
+class GPSUart {
+public:
+    GPSUart();
+    
+    // Initialization
+    bool begin(uint32_t baud);
+    void end();
+    bool setBaudRate(uint32_t baud);
+    bool isRunning() { return running; }
+    
+    // Transmit (blocking, EasyDMA from RAM copy)
+    size_t write(const uint8_t* data, size_t len);
+    size_t print(const char* str);
+    
+    // Receive
+    size_t available();
+    int read();
+    
+    // Sleep until a complete sentence is buffered or the timeout expires.
+    // Returns true if at least one complete line is waiting in the ring.
+    bool waitForSentence(uint32_t timeout_ms);
+    
+    // Statistics
+    GPSUartStats getStats();
+    void resetStats();
+    
+    // Called from UARTE1_IRQHandler
+    void handleIRQ();
+
+private:
+    uint8_t dmaBuffer[2][GPS_UART_DMA_CHUNK];
+    uint8_t txBuffer[GPS_UART_TX_SIZE];
+    uint8_t ring[GPS_UART_RING_SIZE];
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    volatile uint32_t linesIn;      // Written by ISR only
+    volatile uint32_t linesOut;     // Written by consumer only
+    volatile uint8_t dmaIndex;
+    volatile bool flushing;
+    volatile bool running;
+    
+    GPSUartStats stats;
+    SemaphoreHandle_t lineSemaphore;
+    
+    bool pushChunk(const uint8_t* data, uint16_t len);
+    void startRx();
+    void flushPartial();
+    static uint32_t baudToRegister(uint32_t baud);
+};
+
+// Global GPS UART instance
+extern GPSUart gpsUart;
+
+#endif // GPS_UART_H
@@ -0,0 +1,92 @@
+#include "join_scheduler.h"
+#include "airtime.h"
+#include "region.h"
+#include "../include/config.h"
+
+JoinScheduler joinScheduler;
+
+// Join-request MAC payload: MHDR + JoinEUI + DevEUI + DevNonce + MIC = 23 bytes,
+// timeOnAir() adds the 13-byte data frame overhead to its argument
+#define JOIN_REQUEST_APP_LEN    10
+
+JoinScheduler::JoinScheduler() {
+    memset(&record, 0, sizeof(record));
+}
+
+void JoinScheduler::begin() {
+    if (!nvsStorage.loadJoinState(record)) {
+        memset(&record, 0, sizeof(record));
+    }
+    
+    #if DEBUG_SERIAL
+    if (record.attempts > 0) {
+        Serial.print(F("[Join] Resuming schedule: "));
+        Serial.print(record.attempts);
+        Serial.print(F(" attempts, "));
+        Serial.print(record.elapsedS);
+        Serial.print(F(" s elapsed, next in "));
+        Serial.print(record.delayMs / 1000);
+        Serial.println(F(" s"));
+    }
+    #endif
+}
+
+uint8_t JoinScheduler::nextDatarate() {
+    // Even attempts: fast DR. Odd attempts: walk down to the most robust DR.
+    uint32_t n = record.attempts;
+    if (n % 2 == 0 || JOIN_DR_FAST == JOIN_DR_ROBUST) return JOIN_DR_FAST;
+    
+    uint8_t span = JOIN_DR_FAST - JOIN_DR_ROBUST;
+    return JOIN_DR_FAST - 1 - (uint8_t)((n / 2) % span);
+}
+
+uint32_t JoinScheduler::dutyCycleGapMs(uint32_t toaMs) {
+    // Off time after a transmission of toaMs at the current duty-cycle limit
+    uint32_t divisor;
+    if (record.elapsedS < 3600) {
+        divisor = 100;
+    } else if (record.elapsedS < 11 * 3600) {
+        divisor = 1000;
+    } else {
+        divisor = 10000;
+    }
+    return toaMs * (divisor - 1);
+}
+
+void JoinScheduler::recordFailure(uint8_t datarate) {
+    uint32_t toaMs = AirtimeLedger::timeOnAir(datarate, JOIN_REQUEST_APP_LEN);
+    
+    // Time spent since the previous attempt (its wait plus this request)
+    record.elapsedS += (record.delayMs + toaMs) / 1000;
+    record.attempts++;
+    
+    // Exponential backoff with jitter in [cap/2, cap]
+    uint8_t exponent = record.attempts - 1 < 16 ? record.attempts - 1 : 16;
+    uint64_t cap = (uint64_t)JOIN_BACKOFF_BASE_MS << exponent;
+    if (cap > JOIN_BACKOFF_MAX_MS) cap = JOIN_BACKOFF_MAX_MS;
+    uint32_t delayMs = (uint32_t)(cap / 2 + random((long)(cap / 2) + 1));
+    
+    uint32_t legalMs = dutyCycleGapMs(toaMs);
+    record.delayMs = delayMs > legalMs ? delayMs : legalMs;
+    
+    nvsStorage.saveJoinState(record);
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Join] Attempt "));
+    Serial.print(record.attempts);
+    Serial.print(F(" at DR"));
+    Serial.print(datarate);
+    Serial.print(F(" failed ("));
+    Serial.print(toaMs);
+    Serial.print(F(" ms airtime), next at DR"));
+    Serial.print(nextDatarate());
+    Serial.print(F(" in "));
+    Serial.print(record.delayMs / 1000);
+    Serial.println(F(" s"));
+    #endif
+}
+
+void JoinScheduler::recordSuccess() {
+    memset(&record, 0, sizeof(record));
+    nvsStorage.clearJoinState();
+}
@@ -0,0 +1,38 @@
+#ifndef JOIN_SCHEDULER_H
+#define JOIN_SCHEDULER_H
+
+#include <Arduino.h>
+#include "nvs.h"
+
+// Decides when and at which data rate the next OTAA join request goes out.
+// Fast DR attempts alternate with a sweep through the more robust ones, and
+// the gap between attempts grows exponentially with random jitter, never
+// below the join-request duty cycle of LoRaWAN 1.0.3 section 7 (1% in the
+// first hour, 0.1% up to 11 h, 0.01% after that). The state lives in NVS,
+// so a reset continues the schedule instead of starting over.
+class JoinScheduler {
+public:
+    JoinScheduler();
+    
+    // Load persisted state (call after nvsStorage.begin())
+    void begin();
+    
+    // Next attempt
+    uint8_t nextDatarate();
+    uint32_t getDelayMs() { return record.delayMs; }
+    uint32_t getAttempts() { return record.attempts; }
+    
+    // Outcome of an attempt
+    void recordFailure(uint8_t datarate);
+    void recordSuccess();
+
+private:
+    JoinRecord record;
+    
+    uint32_t dutyCycleGapMs(uint32_t toaMs);
+};
+
+// Global join scheduler instance
+extern JoinScheduler joinScheduler;
+
+#endif // JOIN_SCHEDULER_H
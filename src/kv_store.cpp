@@ -0,0 +1,482 @@
+#include "kv_store.h"
+#include "../include/config.h"
+
+KVStore kvStore;
+
+#define KV_BANK_A           KV_FLASH_BASE
+#define KV_BANK_B           (KV_FLASH_BASE + KV_BANK_SIZE)
+#define KV_FIRST_RECORD     sizeof(KVBankHeader)
+#define KV_HEADER_CRC_SPAN  offsetof(KVRecordHeader, crc)
+
+#ifdef KV_FLASH_SIM
+// Host builds (bench/) map the banks into a simulated NVMC, which also
+// provides program() and erasePage()
+const uint8_t* kvFlashSimPtr(uint32_t addr);
+
+static inline const uint8_t* flashPtr(uint32_t addr) {
+    return kvFlashSimPtr(addr);
+}
+#else
+static inline const uint8_t* flashPtr(uint32_t addr) {
+    return (const uint8_t*)addr;
+}
+#endif
+
+KVStore::KVStore()
+    : ready(false),
+      activeBank(KV_BANK_A),
+      head(KV_BANK_A + KV_FIRST_RECORD),
+      generation(0),
+      nextTxn(0),
+      spareErased(0),
+      mutex(nullptr),
+      batchLen(0),
+      batchDepth(0),
+      batchOverflow(false) {
+    memset(index, 0, sizeof(index));
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool KVStore::begin() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateRecursiveMutex();
+    }
+    
+    const KVBankHeader* a = (const KVBankHeader*)flashPtr(KV_BANK_A);
+    const KVBankHeader* b = (const KVBankHeader*)flashPtr(KV_BANK_B);
+    bool validA = a->magic == KV_BANK_MAGIC;
+    bool validB = b->magic == KV_BANK_MAGIC;
+    if (!validA && !validB) return false;
+    
+    // Both valid: compaction finished but the old bank was not erased yet
+    uint32_t bank = validA ? KV_BANK_A : KV_BANK_B;
+    if (validA && validB && (int32_t)(b->generation - a->generation) > 0) {
+        bank = KV_BANK_B;
+    }
+    
+    lock();
+    ready = mount(bank);
+    unlock();
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[KV] Bank "));
+    Serial.print(bank == KV_BANK_A ? 'A' : 'B');
+    Serial.print(F(", generation "));
+    Serial.print(generation);
+    Serial.print(F(", "));
+    Serial.print(activeBank + KV_BANK_SIZE - head);
+    Serial.println(F(" bytes free"));
+    #endif
+    
+    return ready;
+}
+
+bool KVStore::format() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateRecursiveMutex();
+    }
+    
+    lock();
+    for (uint8_t p = 0; p < 2 * KV_BANK_PAGES; p++) {
+        erasePage(KV_BANK_A + p * KV_PAGE_SIZE);
+    }
+    
+    KVBankHeader header = { KV_BANK_MAGIC, generation + 1 };
+    program(KV_BANK_A, (const uint8_t*)&header, sizeof(header));
+    
+    activeBank = KV_BANK_A;
+    head = KV_BANK_A + KV_FIRST_RECORD;
+    generation = header.generation;
+    spareErased = KV_BANK_PAGES;
+    memset(index, 0, sizeof(index));
+    ready = true;
+    unlock();
+    
+    #if DEBUG_SERIAL
+    Serial.println(F("[KV] Formatted"));
+    #endif
+    
+    return true;
+}
+
+bool KVStore::mount(uint32_t bank) {
+    activeBank = bank;
+    generation = ((const KVBankHeader*)flashPtr(bank))->generation;
+    memset(index, 0, sizeof(index));
+    
+    // Erasing carries on across resets (System OFF wakes): count the blank
+    // leading pages of the standby bank
+    uint32_t standby = bank == KV_BANK_A ? KV_BANK_B : KV_BANK_A;
+    spareErased = 0;
+    while (spareErased < KV_BANK_PAGES && pageBlank(standby + spareErased * KV_PAGE_SIZE)) {
+        spareErased++;
+    }
+    
+    // Records of the transaction being scanned; applied when its commit
+    // record is reached, dropped if the log ends or a record is torn first
+    uint32_t pending[KV_MAX_KEYS];
+    uint16_t pendingMask = 0;
+    uint16_t pendingTxn = 0;
+    uint16_t lastTxn = 0;
+    
+    uint32_t end = bank + KV_BANK_SIZE;
+    uint32_t addr = bank + KV_FIRST_RECORD;
+    while (addr + sizeof(KVRecordHeader) <= end) {
+        const uint32_t* words = (const uint32_t*)flashPtr(addr);
+        if (words[0] == 0xFFFFFFFF && words[1] == 0xFFFFFFFF) break;
+        
+        KVRecordHeader h;
+        memcpy(&h, flashPtr(addr), sizeof(h));
+        uint32_t size = recordSize(h.len);
+        if (h.len == 0xFFFF || addr + size > end) {
+            // Header torn mid-program: nothing after it can be trusted to be
+            // erased, so the bank is closed and the next write compacts
+            addr = end;
+            break;
+        }
+        
+        uint16_t crc = crc16((const uint8_t*)&h, KV_HEADER_CRC_SPAN, 0xFFFF);
+        crc = crc16(flashPtr(addr + sizeof(h)), h.len, crc);
+        bool valid = crc == h.crc && h.key != 0 && h.key < KV_MAX_KEYS;
+        
+        if (valid) {
+            lastTxn = h.txn;
+            if (h.txn != pendingTxn) {
+                pendingMask = 0;
+                pendingTxn = h.txn;
+            }
+            pending[h.key] = addr;
+            pendingMask |= 1 << h.key;
+            
+            if (h.flags & KV_FLAG_COMMIT) {
+                for (uint8_t k = 1; k < KV_MAX_KEYS; k++) {
+                    if (!(pendingMask & (1 << k))) continue;
+                    const KVRecordHeader* r = (const KVRecordHeader*)flashPtr(pending[k]);
+                    index[k] = (r->flags & KV_FLAG_DELETE) ? 0 : pending[k];
+                }
+                pendingMask = 0;
+            }
+        } else {
+            pendingMask = 0;
+        }
+        
+        addr += size;
+    }
+    
+    head = addr;
+    nextTxn = lastTxn + 1;
+    return true;
+}
+
+bool KVStore::put(uint8_t key, const void* data, uint16_t len) {
+    if (key == 0 || key >= KV_MAX_KEYS) return false;
+    
+    lock();
+    bool ok;
+    if (batchDepth > 0) {
+        ok = stage(key, 0, data, len);
+    } else if (!ready) {
+        ok = false;
+    } else if (isCurrent(key, 0, (const uint8_t*)data, len)) {
+        ok = true;      // Unchanged: no flash wear
+    } else {
+        batchLen = 0;
+        ok = stage(key, 0, data, len) && writeStaged();
+        batchLen = 0;
+    }
+    unlock();
+    
+    return ok;
+}
+
+bool KVStore::remove(uint8_t key) {
+    if (key == 0 || key >= KV_MAX_KEYS) return false;
+    
+    lock();
+    bool ok;
+    if (batchDepth > 0) {
+        ok = stage(key, KV_FLAG_DELETE, nullptr, 0);
+    } else if (!ready) {
+        ok = false;
+    } else if (index[key] == 0) {
+        ok = true;
+    } else {
+        batchLen = 0;
+        ok = stage(key, KV_FLAG_DELETE, nullptr, 0) && writeStaged();
+        batchLen = 0;
+    }
+    unlock();
+    
+    return ok;
+}
+
+bool KVStore::get(uint8_t key, void* data, uint16_t len) {
+    if (key == 0 || key >= KV_MAX_KEYS) return false;
+    
+    lock();
+    uint32_t addr = index[key];
+    bool ok = addr != 0 && ((const KVRecordHeader*)flashPtr(addr))->len == len;
+    if (ok) {
+        memcpy(data, flashPtr(addr + sizeof(KVRecordHeader)), len);
+    }
+    unlock();
+    
+    return ok;
+}
+
+bool KVStore::has(uint8_t key) {
+    return key != 0 && key < KV_MAX_KEYS && index[key] != 0;
+}
+
+uint16_t KVStore::getLength(uint8_t key) {
+    if (!has(key)) return 0;
+    return ((const KVRecordHeader*)flashPtr(index[key]))->len;
+}
+
+void KVStore::beginBatch() {
+    lock();
+    if (batchDepth++ == 0) {
+        batchLen = 0;
+        batchOverflow = false;
+    }
+}
+
+bool KVStore::commitBatch() {
+    if (batchDepth == 0) return false;
+    
+    bool ok = true;
+    if (--batchDepth == 0) {
+        ok = ready && !batchOverflow && writeStaged();
+        batchLen = 0;
+    }
+    unlock();
+    
+    return ok;
+}
+
+KVStats KVStore::getStats() {
+    lock();
+    KVStats s = stats;
+    s.generation = generation;
+    s.bytesFree = activeBank + KV_BANK_SIZE - head;
+    unlock();
+    return s;
+}
+
+void KVStore::lock() {
+    if (mutex) xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+}
+
+void KVStore::unlock() {
+    if (mutex) xSemaphoreGiveRecursive(mutex);
+}
+
+bool KVStore::stage(uint8_t key, uint8_t flags, const void* data, uint16_t len) {
+    if (batchLen + 4 + len > KV_BATCH_BYTES) {
+        batchOverflow = true;
+        return false;
+    }
+    
+    uint8_t* entry = batch + batchLen;
+    entry[0] = key;
+    entry[1] = flags;
+    entry[2] = len & 0xFF;
+    entry[3] = len >> 8;
+    if (len) memcpy(entry + 4, data, len);
+    batchLen += 4 + len;
+    return true;
+}
+
+bool KVStore::writeStaged() {
+    if (batchLen == 0) return true;
+    
+    // The whole transaction goes into one bank
+    uint32_t need = 0;
+    for (uint16_t i = 0; i < batchLen; ) {
+        uint16_t len = batch[i + 2] | (batch[i + 3] << 8);
+        need += recordSize(len);
+        i += 4 + len;
+    }
+    if (head + need > activeBank + KV_BANK_SIZE) {
+        compact();
+        if (head + need > activeBank + KV_BANK_SIZE) {
+            #if DEBUG_SERIAL
+            Serial.println(F("[KV] No space for transaction"));
+            #endif
+            return false;
+        }
+    }
+    
+    uint16_t txn = nextTxn++;
+    uint32_t written[KV_MAX_KEYS];
+    uint16_t writtenMask = 0;
+    for (uint16_t i = 0; i < batchLen; ) {
+        uint8_t key = batch[i];
+        uint8_t flags = batch[i + 1];
+        uint16_t len = batch[i + 2] | (batch[i + 3] << 8);
+        bool last = i + 4 + len >= batchLen;
+        
+        written[key] = head;
+        writtenMask |= 1 << key;
+        head = append(head, key, flags | (last ? KV_FLAG_COMMIT : 0), txn, batch + i + 4, len);
+        i += 4 + len;
+    }
+    
+    // Committed: the new records are now the current values
+    for (uint8_t k = 1; k < KV_MAX_KEYS; k++) {
+        if (!(writtenMask & (1 << k))) continue;
+        const KVRecordHeader* r = (const KVRecordHeader*)flashPtr(written[k]);
+        index[k] = (r->flags & KV_FLAG_DELETE) ? 0 : written[k];
+    }
+    
+    return true;
+}
+
+bool KVStore::compact() {
+    uint32_t target = activeBank == KV_BANK_A ? KV_BANK_B : KV_BANK_A;
+    
+    // Pages maintain() already erased are skipped
+    for (uint8_t p = spareErased; p < KV_BANK_PAGES; p++) {
+        erasePage(target + p * KV_PAGE_SIZE);
+    }
+    
+    // Live values only; tombstones and superseded records stay behind
+    uint32_t newIndex[KV_MAX_KEYS];
+    memset(newIndex, 0, sizeof(newIndex));
+    uint32_t addr = target + KV_FIRST_RECORD;
+    for (uint8_t k = 1; k < KV_MAX_KEYS; k++) {
+        if (index[k] == 0) continue;
+        const KVRecordHeader* r = (const KVRecordHeader*)flashPtr(index[k]);
+        newIndex[k] = addr;
+        addr = append(addr, k, KV_FLAG_COMMIT, nextTxn++, flashPtr(index[k] + sizeof(KVRecordHeader)), r->len);
+    }
+    
+    // The header makes the new bank valid; until then the old one rules
+    KVBankHeader header = { KV_BANK_MAGIC, generation + 1 };
+    program(target, (const uint8_t*)&header, sizeof(header));
+    
+    activeBank = target;
+    head = addr;
+    generation = header.generation;
+    spareErased = 0;
+    memcpy(index, newIndex, sizeof(index));
+    stats.compactions++;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[KV] Compacted into bank "));
+    Serial.print(target == KV_BANK_A ? 'A' : 'B');
+    Serial.print(F(", "));
+    Serial.print(activeBank + KV_BANK_SIZE - head);
+    Serial.println(F(" bytes free"));
+    #endif
+    
+    return true;
+}
+
+bool KVStore::pageBlank(uint32_t addr) {
+    const uint32_t* words = (const uint32_t*)flashPtr(addr);
+    for (uint32_t i = 0; i < KV_PAGE_SIZE / 4; i++) {
+        if (words[i] != 0xFFFFFFFF) return false;
+    }
+    return true;
+}
+
+uint32_t KVStore::liveBytes() {
+    uint32_t bytes = 0;
+    for (uint8_t k = 1; k < KV_MAX_KEYS; k++) {
+        if (index[k] == 0) continue;
+        bytes += recordSize(((const KVRecordHeader*)flashPtr(index[k]))->len);
+    }
+    return bytes;
+}
+
+bool KVStore::maintain() {
+    if (!ready) return false;
+    
+    lock();
+    bool worked = false;
+    uint32_t standby = activeBank == KV_BANK_A ? KV_BANK_B : KV_BANK_A;
+    if (spareErased < KV_BANK_PAGES) {
+        // Header page first: the old bank stops being a mount candidate
+        erasePage(standby + spareErased * KV_PAGE_SIZE);
+        spareErased++;
+        worked = true;
+    } else if (activeBank + KV_BANK_SIZE - head < KV_COMPACT_FREE &&
+               KV_FIRST_RECORD + liveBytes() + KV_COMPACT_FREE <= KV_BANK_SIZE) {
+        // Only when it frees enough, else every call would compact again
+        compact();
+        worked = true;
+    }
+    unlock();
+    
+    return worked;
+}
+
+uint32_t KVStore::append(uint32_t addr, uint8_t key, uint8_t flags, uint16_t txn,
+                         const uint8_t* data, uint16_t len) {
+    KVRecordHeader h;
+    h.key = key;
+    h.flags = flags;
+    h.len = len;
+    h.txn = txn;
+    h.crc = crc16(data, len, crc16((const uint8_t*)&h, KV_HEADER_CRC_SPAN, 0xFFFF));
+    
+    // Header first: a record cut short by power loss then fails its CRC
+    // but still tells recovery how far to skip
+    program(addr, (const uint8_t*)&h, sizeof(h));
+    if (len) program(addr + sizeof(h), data, len);
+    
+    stats.appends++;
+    stats.bytesWritten += recordSize(len);
+    return addr + recordSize(len);
+}
+
+bool KVStore::isCurrent(uint8_t key, uint8_t flags, const uint8_t* data, uint16_t len) {
+    if (flags & KV_FLAG_DELETE) return index[key] == 0;
+    if (index[key] == 0) return false;
+    
+    const KVRecordHeader* r = (const KVRecordHeader*)flashPtr(index[key]);
+    return r->len == len && memcmp(flashPtr(index[key] + sizeof(KVRecordHeader)), data, len) == 0;
+}
+
+uint16_t KVStore::crc16(const uint8_t* data, size_t len, uint16_t crc) {
+    // CRC-16/CCITT, continued from crc
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+#ifndef KV_FLASH_SIM
+void KVStore::program(uint32_t addr, const uint8_t* data, uint32_t len) {
+    // NVMC word writes; the SoftDevice is not enabled, so no flash API is needed.
+    // A trailing partial word is padded with 0xFF (left erased).
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    
+    for (uint32_t i = 0; i < len; i += 4) {
+        uint32_t word = 0xFFFFFFFF;
+        memcpy(&word, data + i, len - i < 4 ? len - i : 4);
+        *(volatile uint32_t*)(addr + i) = word;
+        while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    }
+    
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+}
+
+void KVStore::erasePage(uint32_t addr) {
+    // ~85 ms with the CPU stalled (code runs from the same flash)
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    NRF_NVMC->ERASEPAGE = addr;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    
+    stats.pageErases++;
+}
+#endif
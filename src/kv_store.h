@@ -0,0 +1,126 @@
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include <Arduino.h>
+
+// Internal flash reserved for application data. The bootloader keeps these
+// seven pages across DFU updates and the linker script ends the application
+// below them (this is where InternalFS/LittleFS used to live).
+#define KV_FLASH_BASE       0xED000
+#define KV_PAGE_SIZE        4096
+#define KV_BANK_PAGES       3           // Two banks of 12 KB, the seventh page stays free
+#define KV_BANK_SIZE        (KV_BANK_PAGES * KV_PAGE_SIZE)
+#define KV_BANK_MAGIC       0x3153564B  // "KVS1"
+#define KV_MAX_KEYS         16          // Keys 1..15 (0 is reserved)
+#define KV_BATCH_BYTES      1024        // Staging space for one commit (largest value + 4)
+#define KV_COMPACT_FREE     (KV_BATCH_BYTES + KV_MAX_KEYS * 8)   // maintain() compacts below this (largest commit)
+
+#define KV_FLAG_COMMIT      0x01        // Last record of its transaction
+#define KV_FLAG_DELETE      0x02        // Tombstone (no value)
+
+// Record header, 8 bytes, followed by the value padded to a word.
+// The header is programmed before the value and the CRC covers both, so a
+// record torn by power loss is skipped on recovery.
+struct KVRecordHeader {
+    uint8_t key;                // 0xFF = erased (end of log)
+    uint8_t flags;              // KV_FLAG_*
+    uint16_t len;               // Value length in bytes
+    uint16_t txn;               // Transaction the record belongs to
+    uint16_t crc;               // CRC-16/CCITT of key..txn and the value
+};
+
+// First 8 bytes of a bank; written last when a bank is filled by compaction
+struct KVBankHeader {
+    uint32_t magic;             // KV_BANK_MAGIC
+    uint32_t generation;        // Higher = newer (serial arithmetic)
+};
+
+struct KVStats {
+    uint32_t appends;           // Records written since boot
+    uint32_t bytesWritten;      // Flash bytes programmed since boot
+    uint32_t compactions;       // Bank switches since boot
+    uint32_t pageErases;        // Page erases since boot
+    uint32_t generation;        // Bank switches over the device lifetime
+    uint32_t bytesFree;         // Space left in the active bank
+};
+
+// Log-structured key-value store on two internal flash banks.
+// Values are appended to the active bank and a RAM index holds the newest
+// committed record per key, so a lookup is a memcpy from memory-mapped
+// flash. Records written between beginBatch() and commitBatch() carry one
+// transaction id and only the last has KV_FLAG_COMMIT: after a reset they
+// are either all visible or none is. When the active bank is full, the live
+// values are copied to the other bank, whose header is written last, so a
+// power loss during compaction leaves the old bank in charge. A page erase
+// stalls the CPU for ~85 ms, so maintain() erases the other bank a page at
+// a time and compacts ahead of need while nothing timing-critical runs;
+// a write then only compacts (and erases) if maintain() was not called.
+class KVStore {
+public:
+    KVStore();
+    
+    // Mount the newest valid bank; false if there is none (see format())
+    bool begin();
+    bool isReady() { return ready; }
+    
+    // Erase both banks and start an empty log
+    bool format();
+    
+    // Single-key operations, each its own transaction. put() skips the
+    // write when the stored value is already identical.
+    bool put(uint8_t key, const void* data, uint16_t len);
+    bool get(uint8_t key, void* data, uint16_t len);   // Exact length only
+    bool remove(uint8_t key);
+    bool has(uint8_t key);
+    uint16_t getLength(uint8_t key);
+    
+    // Atomic multi-key commit: put()/remove() calls in between are staged in
+    // RAM and written as one transaction. Holds the store lock until commit.
+    void beginBatch();
+    bool commitBatch();
+    
+    KVStats getStats();
+    
+    // One step of background work: erase a page of the standby bank, or
+    // compact once it is blank and the active bank is nearly full. Call
+    // while a CPU stall does not matter (GPS off); true if it did any.
+    bool maintain();
+    
+private:
+    bool ready;
+    uint32_t activeBank;            // Flash address of the active bank
+    uint32_t head;                  // Next free address in the active bank
+    uint32_t generation;
+    uint16_t nextTxn;
+    uint8_t spareErased;            // Leading standby bank pages known to be blank
+    uint32_t index[KV_MAX_KEYS];    // Newest committed record per key, 0 = none
+    KVStats stats;
+    SemaphoreHandle_t mutex;
+    
+    // Batch staging: [key, flags, len lo, len hi, value...] per entry
+    uint8_t batch[KV_BATCH_BYTES];
+    uint16_t batchLen;
+    uint8_t batchDepth;
+    bool batchOverflow;
+    
+    void lock();
+    void unlock();
+    bool stage(uint8_t key, uint8_t flags, const void* data, uint16_t len);
+    bool writeStaged();
+    bool mount(uint32_t bank);
+    bool compact();
+    uint32_t liveBytes();
+    bool pageBlank(uint32_t addr);
+    uint32_t append(uint32_t addr, uint8_t key, uint8_t flags, uint16_t txn, const uint8_t* data, uint16_t len);
+    bool isCurrent(uint8_t key, uint8_t flags, const uint8_t* data, uint16_t len);
+    
+    static uint32_t recordSize(uint16_t len) { return sizeof(KVRecordHeader) + ((len + 3) & ~3u); }
+    static uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc);
+    static void program(uint32_t addr, const uint8_t* data, uint32_t len);
+    void erasePage(uint32_t addr);
+};
+
+// Global key-value store instance
+extern KVStore kvStore;
+
+#endif // KV_STORE_H
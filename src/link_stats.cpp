@@ -0,0 +1,172 @@
+#include "link_stats.h"
+#include <RadioLib.h>
+#include "../include/config.h"
+
+LinkStats linkStats;
+
+// Upper bin edges (dBm / dB); the last bin takes everything above
+static const int8_t RSSI_EDGES[LINK_STATS_BINS - 1] = { -120, -110, -100, -90, -80 };
+static const int8_t SNR_EDGES[LINK_STATS_BINS - 1] = { -15, -10, -5, 0, 5 };
+
+static_assert(Region::drMax < LINK_STATS_DRS, "LINK_STATS_DRS does not cover the region's uplink DRs");
+static_assert(sizeof(LinkStatsRecord) + 4 <= KV_BATCH_BYTES, "LinkStatsRecord does not fit one KV commit");
+
+LinkStats::LinkStats() : unsaved(0) {
+    memset(&record, 0, sizeof(record));
+}
+
+void LinkStats::begin() {
+    #if LINK_STATS_ENABLED
+    if (!nvsStorage.loadLinkStats(record)) {
+        memset(&record, 0, sizeof(record));
+    }
+    
+    #if DEBUG_SERIAL
+    dump();
+    #endif
+    #endif
+}
+
+LinkStatsEntry* LinkStats::find(float freqMHz) {
+    uint16_t freq = freqMHz > 0 ? (uint16_t)(freqMHz * 10.0f + 0.5f) : 0;
+    
+    // Existing entry, else a free slot, else the least used one
+    LinkStatsEntry* victim = nullptr;
+    for (uint8_t i = 0; i < LINK_STATS_SLOTS; i++) {
+        LinkStatsEntry& e = record.entries[i];
+        if (e.used && e.freq == freq) return &e;
+        if (!victim || (victim->used && (!e.used || e.uplinks < victim->uplinks))) {
+            victim = &e;
+        }
+    }
+    
+    memset(victim, 0, sizeof(*victim));
+    victim->freq = freq;
+    victim->used = 1;
+    return victim;
+}
+
+uint8_t LinkStats::bin(int16_t value, const int8_t* edges) {
+    uint8_t i = 0;
+    while (i < LINK_STATS_BINS - 1 && value >= edges[i]) i++;
+    return i;
+}
+
+void LinkStats::recordUplink(float freqMHz, uint8_t datarate, int16_t result, bool confirmed, bool acked, uint32_t toaMs) {
+    #if LINK_STATS_ENABLED
+    LinkStatsEntry* e = find(freqMHz);
+    e->datarate = datarate;
+    
+    // > 0 is the RX window of a downlink; the others mean the uplink went out
+    bool sent = result >= 0 ||
+                result == RADIOLIB_LORAWAN_NO_DOWNLINK ||
+                result == RADIOLIB_ERR_RX_TIMEOUT ||
+                result == RADIOLIB_ERR_CRC_MISMATCH;
+    if (sent) {
+        increment(e->uplinks);
+        if (datarate < LINK_STATS_DRS) increment(e->drUplinks[datarate]);
+        e->airtimeMs += toaMs;
+        if (result == RADIOLIB_ERR_CRC_MISMATCH) {
+            increment(e->rxErrors);
+            e->lastError = result;
+        }
+        if (confirmed && !acked) increment(e->noAck);
+    } else {
+        increment(e->txErrors);
+        e->lastError = result;
+    }
+    
+    save(false);
+    #endif
+}
+
+void LinkStats::recordDownlink(float freqMHz, uint8_t datarate, int16_t rssi, int8_t snr) {
+    #if LINK_STATS_ENABLED
+    LinkStatsEntry* e = find(freqMHz);
+    e->datarate = datarate;
+    increment(e->downlinks);
+    increment(e->rssi[bin(rssi, RSSI_EDGES)]);
+    increment(e->snr[bin(snr, SNR_EDGES)]);
+    #endif
+}
+
+void LinkStats::save(bool force) {
+    // Counters move by one per uplink; batch the flash writes
+    if (!force && ++unsaved < LINK_STATS_SAVE_EVERY) return;
+    unsaved = 0;
+    nvsStorage.saveLinkStats(record);
+}
+
+void LinkStats::reset() {
+    memset(&record, 0, sizeof(record));
+    save(true);
+}
+
+void LinkStats::dump() {
+    #if DEBUG_SERIAL
+    // One CSV row per channel, histogram columns named by their lower edge
+    Serial.print(F("[Link] MHz,DR,up,down,noack,rxerr,txerr,lasterr,airtime_ms"));
+    for (uint8_t i = 0; i < LINK_STATS_DRS; i++) {
+        Serial.print(F(",up_dr"));
+        Serial.print(i);
+    }
+    for (uint8_t i = 0; i < LINK_STATS_BINS; i++) {
+        Serial.print(F(",rssi"));
+        if (i == 0) {
+            Serial.print(F("<"));
+            Serial.print(RSSI_EDGES[0]);
+        } else {
+            Serial.print(F(">="));
+            Serial.print(RSSI_EDGES[i - 1]);
+        }
+    }
+    for (uint8_t i = 0; i < LINK_STATS_BINS; i++) {
+        Serial.print(F(",snr"));
+        if (i == 0) {
+            Serial.print(F("<"));
+            Serial.print(SNR_EDGES[0]);
+        } else {
+            Serial.print(F(">="));
+            Serial.print(SNR_EDGES[i - 1]);
+        }
+    }
+    Serial.println();
+    
+    for (uint8_t i = 0; i < LINK_STATS_SLOTS; i++) {
+        const LinkStatsEntry& e = record.entries[i];
+        if (!e.used) continue;
+        
+        Serial.print(F("[Link] "));
+        Serial.print(e.freq / 10.0, 1);
+        Serial.print(',');
+        Serial.print(e.datarate);
+        Serial.print(',');
+        Serial.print(e.uplinks);
+        Serial.print(',');
+        Serial.print(e.downlinks);
+        Serial.print(',');
+        Serial.print(e.noAck);
+        Serial.print(',');
+        Serial.print(e.rxErrors);
+        Serial.print(',');
+        Serial.print(e.txErrors);
+        Serial.print(',');
+        Serial.print(e.lastError);
+        Serial.print(',');
+        Serial.print(e.airtimeMs);
+        for (uint8_t d = 0; d < LINK_STATS_DRS; d++) {
+            Serial.print(',');
+            Serial.print(e.drUplinks[d]);
+        }
+        for (uint8_t b = 0; b < LINK_STATS_BINS; b++) {
+            Serial.print(',');
+            Serial.print(e.rssi[b]);
+        }
+        for (uint8_t b = 0; b < LINK_STATS_BINS; b++) {
+            Serial.print(',');
+            Serial.print(e.snr[b]);
+        }
+        Serial.println();
+    }
+    #endif
+}
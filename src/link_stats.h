@@ -0,0 +1,51 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <Arduino.h>
+#include "nvs.h"
+
+// Uplink/downlink statistics per channel.
+// A fixed table of LINK_STATS_SLOTS entries, keyed by the channel RadioLib
+// reports for each uplink: TX count (also split by DR), airtime, failure
+// counters and the last failure code, plus RSSI/SNR histograms that are
+// only fed by downlinks actually received (RX1 or RX2 of that uplink). The
+// table is persisted in NVS every few uplinks and printed by dump().
+class LinkStats {
+public:
+    LinkStats();
+    
+    // Load the table from NVS
+    void begin();
+    
+    // Outcome of one sendReceive() on freqMHz/datarate (freqMHz 0 = unknown)
+    void recordUplink(float freqMHz, uint8_t datarate, int16_t result, bool confirmed, bool acked, uint32_t toaMs);
+    
+    // Signal quality of the downlink that answered that uplink
+    void recordDownlink(float freqMHz, uint8_t datarate, int16_t rssi, int8_t snr);
+    
+    // Print the table as CSV on the serial console
+    void dump();
+    
+    // Forget everything (also in NVS)
+    void reset();
+    
+    // Write batched updates now (before a System OFF power-down)
+    void flush() { if (unsaved) save(true); }
+    
+    const LinkStatsEntry* getEntry(uint8_t slot) { return slot < LINK_STATS_SLOTS ? &record.entries[slot] : nullptr; }
+    
+private:
+    LinkStatsRecord record;
+    uint8_t unsaved;            // Uplinks since the last NVS write
+    
+    LinkStatsEntry* find(float freqMHz);
+    void save(bool force);
+    
+    static uint8_t bin(int16_t value, const int8_t* edges);
+    static void increment(uint16_t& counter) { if (counter < 0xFFFF) counter++; }
+};
+
+// Global link statistics instance
+extern LinkStats linkStats;
+
+#endif // LINK_STATS_H
@@ -1,19 +1,119 @@
 #include "lora.h"
 #include "nvs.h"
+#include "join_scheduler.h"
+#include "timebase.h"
+#include "power.h"
+#include "region.h"
+#include "link_stats.h"
+#include "task_monitor.h"
+#include "sleep.h"
 #include "../include/pins.h"
 #include "../include/config.h"
 
+static_assert(LORAWAN_DATARATE <= Region::drMax, "LORAWAN_DATARATE is not an uplink DR of this region");
+static_assert(LORAWAN_TX_POWER <= Region::txPowerMax, "LORAWAN_TX_POWER exceeds the region's EIRP limit");
+
 LoRaWANModule loraModule;
 
+// FOpts bytes of a piggy-backed LinkCheckReq and DeviceTimeReq
+static const uint8_t MAC_REQUEST_BYTES = 2;
+
+// ============================================
+// LoRaHal
+// ============================================
+
+void (*LoRaHal::radioCallback)(void) = nullptr;
+SemaphoreHandle_t LoRaHal::dio1Sem = nullptr;
+volatile uint32_t LoRaHal::dio1Events = 0;
+
+LoRaHal::LoRaHal(SPIClass& spi, SPISettings settings) : ArduinoHal(spi, settings) {
+    if (dio1Sem == nullptr) {
+        dio1Sem = xSemaphoreCreateBinary();
+    }
+}
+
+void LoRaHal::onDio1() {
+    dio1Events++;
+    
+    if (radioCallback) radioCallback();
+    sleepService.wakeFromISR(WAKE_RADIO);
+    
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(dio1Sem, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void LoRaHal::attachInterrupt(uint32_t interruptNum, void (*interruptCb)(void), uint32_t mode) {
+    // Keep RadioLib's handler, but run it from our wrapper
+    radioCallback = interruptCb;
+    ArduinoHal::attachInterrupt(interruptNum, onDio1, mode);
+}
+
+void LoRaHal::detachInterrupt(uint32_t interruptNum) {
+    ArduinoHal::detachInterrupt(interruptNum);
+    radioCallback = nullptr;
+}
+
+void LoRaHal::yield() {
+    // BUSY high means RadioLib is waiting on an SPI command (microseconds);
+    // DIO1 high means the event is already there. Only sleep otherwise.
+    if (digitalRead(LORA_BUSY) == HIGH || digitalRead(LORA_DIO1) == HIGH) {
+        ArduinoHal::yield();
+        return;
+    }
+    
+    // Bounded, so RadioLib's own time-based loops still make progress
+    xSemaphoreTake(dio1Sem, pdMS_TO_TICKS(LORA_HAL_YIELD_MS));
+}
+
+// ============================================
+// LoRaWANModule
+// ============================================
+
+// POWER_RADIO hook: standby while held, warm sleep otherwise
+static void radioPower(bool on) {
+    if (on) {
+        loraModule.wakeup();
+    } else {
+        loraModule.sleep();
+    }
+}
+
 LoRaWANModule::LoRaWANModule() 
     : rfPort(nullptr),
+      hal(nullptr),
       radioModule(nullptr),
       radio(nullptr),
       node(nullptr),
       state(LORA_NOT_JOINED),
       uplinkCount(0),
       lastRSSI(0),
-      lastSNR(0) {
+      lastSNR(0),
+      uplinkTask(nullptr),
+      requestSem(nullptr),
+      doneSem(nullptr),
+      monitorSlot(-1),
+      uplinkBusy(false),
+      requestLen(0),
+      requestPort(1),
+      requestConfirmed(false),
+      requestCallback(nullptr),
+      lastResult(0),
+      lastDownlink(false),
+      lastAcked(false),
+      sessionUnverified(false),
+      unverifiedUplinks(0),
+      uplinksSinceSave(0),
+      currentDatarate(LORAWAN_DATARATE),
+      currentTxPower(LORAWAN_TX_POWER),
+      linkCheckValid(false),
+      gatewayCount(0),
+      linkMargin(0),
+      linkCheckUplink(0),
+      linkCheckAsked(false),
+      deviceTimeAsked(false),
+      lastPayloadLen(0) {
+    memset(&mac, 0, sizeof(mac));   // Both requests due on the first uplink
 }
 
 bool LoRaWANModule::begin() {
@@ -52,17 +152,23 @@ bool LoRaWANModule::begin() {
     
     // Create SPI port for LoRa (NRF_SPIM3) - exactly like official examples
     rfPort = new SPIClass(NRF_SPIM3, LORA_MISO, LORA_SCLK, LORA_MOSI);
+    power.acquire(POWER_RADIO);
     rfPort->begin();
     
-    // Create Module with SPI settings
+    // Create Module with SPI settings on the DIO1-sleeping HAL
     SPISettings spiSettings;
-    radioModule = new Module(LORA_CS, LORA_DIO1, LORA_RESET, LORA_BUSY, *rfPort, spiSettings);
+    hal = new LoRaHal(*rfPort, spiSettings);
+    radioModule = new Module(hal, LORA_CS, LORA_DIO1, LORA_RESET, LORA_BUSY);
     
     // Create radio
     radio = new SX1262(radioModule);
     
     // Create LoRaWAN node
-    node = new LoRaWANNode(radio, &EU868);
+    node = new LoRaWANNode(radio, Region::band(), Region::subBand);
+    
+    // Regulatory limits of the compiled-in region, enforced by RadioLib
+    node->setDutyCycle(Region::dutyCycleMsPerHour != 0, Region::dutyCycleMsPerHour);
+    node->setDwellTime(Region::dwellTimeMs != 0, Region::dwellTimeMs);
     
     #if DEBUG_SERIAL
     Serial.println(F("[LoRa] Calling radio->begin()..."));
@@ -70,7 +176,7 @@ bool LoRaWANModule::begin() {
     
     // Initialize radio - TCXO voltage MUST be set in begin() call for T-Echo
     // Using 1.8V TCXO for better frequency stability
-    int16_t result = radio->begin(868.0, 125.0, 9, 7, RADIOLIB_SX126X_SYNC_WORD_PUBLIC, 14, 8, 1.8, false);
+    int16_t result = radio->begin(Region::frequencyMHz, 125.0, 9, 7, RADIOLIB_SX126X_SYNC_WORD_PUBLIC, 14, 8, 1.8, false);
     if (result != RADIOLIB_ERR_NONE) {
         #if DEBUG_SERIAL
         Serial.print(F("[LoRa] Radio init failed, code: "));
@@ -110,6 +216,23 @@ bool LoRaWANModule::begin() {
     // Set current limit
     radio->setCurrentLimit(140);
     
+    // Uplink task for sendUplinkAsync()
+    requestSem = xSemaphoreCreateBinary();
+    doneSem = xSemaphoreCreateBinary();
+    if (xTaskCreate(uplinkTaskMain, "lora", LORA_TASK_STACK, this, TASK_PRIO_NORMAL, &uplinkTask) == pdPASS) {
+        monitorSlot = taskMonitor.add(uplinkTask, "lora", LORA_TASK_STACK);
+    } else {
+        uplinkTask = nullptr;
+        #if DEBUG_SERIAL
+        Serial.println(F("[LoRa] Uplink task not started, async sends disabled"));
+        #endif
+    }
+    
+    // From here on the radio sleeps (warm, config retained) unless a join
+    // or an uplink holds the domain
+    power.setHook(POWER_RADIO, radioPower);
+    power.release(POWER_RADIO);
+    
     #if DEBUG_SERIAL
     Serial.println(F("[LoRa] SX1262 initialized successfully"));
     Serial.println(F("[LoRa] TCXO: 1.6V, DIO2 RF switch, RX boost enabled"));
@@ -120,58 +243,156 @@ bool LoRaWANModule::begin() {
     return true;
 }
 
-bool LoRaWANModule::configureRadio() {
-    int16_t result;
+void LoRaWANModule::applyDatarate(bool fresh) {
+    // With ADR the network owns DR and power once it has spoken; a restored
+    // session keeps what the network last set
+    node->setADR(LORAWAN_ADR);
+    if (fresh || !LORAWAN_ADR) {
+        node->setDatarate(LORAWAN_DATARATE);
+        node->setTxPower(LORAWAN_TX_POWER);
+        currentDatarate = LORAWAN_DATARATE;
+        currentTxPower = LORAWAN_TX_POWER;
+    }
     
-    // Set frequency to 868.1 MHz (EU868 default channel)
-    result = radio->setFrequency(868.1);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    #if DEBUG_SERIAL
+    Serial.print(F("[LoRa] ADR "));
+    Serial.print(LORAWAN_ADR ? F("on") : F("off"));
+    Serial.print(F(", DR"));
+    Serial.println(LORAWAN_DATARATE);
+    #endif
+}
+
+bool LoRaWANModule::restoreSession() {
+    // Both buffers are needed: RadioLib checks the session against the nonces
+    uint8_t noncesBuffer[RADIOLIB_LORAWAN_NONCES_BUF_SIZE];
+    uint8_t sessionBuffer[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
     
-    // Set output power to 14 dBm (max for EU868)
-    result = radio->setOutputPower(LORAWAN_TX_POWER);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    if (!nvsStorage.hasSession() ||
+        !nvsStorage.loadNonces(noncesBuffer, RADIOLIB_LORAWAN_NONCES_BUF_SIZE) ||
+        !nvsStorage.loadSession(sessionBuffer, RADIOLIB_LORAWAN_SESSION_BUF_SIZE)) {
+        return false;
+    }
     
-    // Set bandwidth to 125 kHz
-    result = radio->setBandwidth(125.0);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    int16_t result = activate(noncesBuffer, sessionBuffer);
+    if (result != RADIOLIB_LORAWAN_SESSION_RESTORED) {
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] Session restore failed, code: "));
+        Serial.println(result);
+        #endif
+        nvsStorage.clearSession();
+        return false;
+    }
     
-    // Set spreading factor to 7 (SF7)
-    result = radio->setSpreadingFactor(7);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    state = LORA_JOINED;
+    uplinkCount = 0;
+    uplinksSinceSave = 0;
+    applyDatarate(false);
     
-    // Set coding rate to 4/5
-    result = radio->setCodingRate(5);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    // Until the network acknowledges an uplink, the session may be stale
+    sessionUnverified = true;
+    unverifiedUplinks = 0;
     
-    // Set sync word to 0x34 (LoRaWAN public network)
-    result = radio->setSyncWord(0x34);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    #if DEBUG_SERIAL
+    Serial.print(F("[LoRa] ✓ Session restored, FCntUp "));
+    Serial.println(node->getFCntUp());
+    #endif
     
-    // Set preamble length to 8
-    result = radio->setPreambleLength(8);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    return true;
+}
+
+int16_t LoRaWANModule::activate(const uint8_t* nonces, const uint8_t* session) {
+    node->beginOTAA(joinEUI, devEUI, appKey, appKey);
+    int16_t result = node->setBufferNonces(nonces);
+    if (result == RADIOLIB_ERR_NONE) {
+        result = node->setBufferSession(session);
+    }
+    if (result == RADIOLIB_ERR_NONE) {
+        // No join request goes out when a valid session is loaded
+        result = node->activateOTAA();
+    }
+    return result;
+}
+
+void LoRaWANModule::save(LoRaCheckpoint& checkpoint) {
+    memcpy(checkpoint.nonces, node->getBufferNonces(), RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
+    memcpy(checkpoint.session, node->getBufferSession(), RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+    checkpoint.uplinkCount = uplinkCount;
+    checkpoint.sessionUnverified = sessionUnverified;
+    checkpoint.unverifiedUplinks = unverifiedUplinks;
+    checkpoint.uplinksSinceSave = uplinksSinceSave;
+    checkpoint.mac = mac;
+    checkpoint.lastPayloadLen = lastPayloadLen;
+    checkpoint.datarate = currentDatarate;
+    checkpoint.txPower = currentTxPower;
+    airtime.save(checkpoint.airtime);
+}
+
+bool LoRaWANModule::resume(const LoRaCheckpoint& checkpoint, uint32_t offMs) {
+    // The checkpoint is newer than the NVS session (FCntUp moved on since)
+    int16_t result = activate(checkpoint.nonces, checkpoint.session);
+    if (result != RADIOLIB_LORAWAN_SESSION_RESTORED) {
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] Checkpoint session rejected, code: "));
+        Serial.println(result);
+        #endif
+        return false;
+    }
     
-    // Enable CRC
-    result = radio->setCRC(true);
-    if (result != RADIOLIB_ERR_NONE) return false;
+    state = LORA_JOINED;
+    uplinkCount = checkpoint.uplinkCount;
+    sessionUnverified = checkpoint.sessionUnverified;
+    unverifiedUplinks = checkpoint.unverifiedUplinks;
+    uplinksSinceSave = checkpoint.uplinksSinceSave;
+    lastPayloadLen = checkpoint.lastPayloadLen;
+    airtime.restore(checkpoint.airtime, offMs);
+    mac = checkpoint.mac;           // Due times are on the ledger clock, restored above
+    applyDatarate(false);
+    if (LORAWAN_ADR) {
+        currentDatarate = checkpoint.datarate;
+        currentTxPower = checkpoint.txPower;
+    }
     
     #if DEBUG_SERIAL
-    Serial.println(F("[LoRa] Radio configured: EU868, SF7, BW125, 14dBm"));
+    Serial.print(F("[LoRa] ✓ Session resumed, FCntUp "));
+    Serial.println(node->getFCntUp());
     #endif
     
     return true;
 }
 
-bool LoRaWANModule::join(uint8_t maxRetries) {
+void LoRaWANModule::saveSession() {
+    uint8_t* session = node->getBufferSession();
+    if (session && nvsStorage.saveSession(session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE)) {
+        uplinksSinceSave = 0;
+    }
+}
+
+bool LoRaWANModule::join() {
+    #if SESSION_RESTORE
+    // Power-up with a saved session: uplink right away instead of joining
+    if (restoreSession()) {
+        return true;
+    }
+    #endif
+    
     #if DEBUG_SERIAL
     Serial.println(F("[LoRa] Starting OTAA join..."));
     #endif
     
+    power.acquire(POWER_RADIO);
+    bool joined = joinOnce();
+    power.release(POWER_RADIO);
+    return joined;
+}
+
+bool LoRaWANModule::joinOnce() {
     state = LORA_JOINING;
     
     // Try to restore saved nonces (DevNonce) from NVS
     uint8_t noncesBuffer[RADIOLIB_LORAWAN_NONCES_BUF_SIZE];
-    bool noncesRestored = false;
+    
+    // The schedule picks the data rate; the caller has already waited its delay
+    uint8_t datarate = joinScheduler.nextDatarate();
     
     if (nvsStorage.loadNonces(noncesBuffer, RADIOLIB_LORAWAN_NONCES_BUF_SIZE)) {
         #if DEBUG_SERIAL
@@ -184,10 +405,8 @@ bool LoRaWANModule::join(uint8_t maxRetries) {
         Serial.println(restoreResult);
         #endif
         
-        // Only consider nonces restored if successful (0) or already have valid nonces
-        if (restoreResult == RADIOLIB_ERR_NONE) {
-            noncesRestored = true;
-        } else {
+        // Only keep nonces that RadioLib accepted
+        if (restoreResult != RADIOLIB_ERR_NONE) {
             // Clear corrupted nonces and start fresh
             #if DEBUG_SERIAL
             Serial.println(F("[LoRa] Clearing corrupted nonces, starting fresh"));
@@ -196,124 +415,262 @@ bool LoRaWANModule::join(uint8_t maxRetries) {
         }
     }
     
-    for (uint8_t retry = 0; retry < maxRetries; retry++) {
-        #if DEBUG_SERIAL
-        Serial.print(F("[LoRa] Join attempt "));
-        Serial.print(retry + 1);
-        Serial.print(F("/"));
-        Serial.println(maxRetries);
-        #endif
-        
-        // Attempt OTAA join (beginOTAA returns void in RadioLib 6.6.0)
-        // For LoRaWAN 1.0.x compatibility, use appKey for both nwkKey and appKey
-        // For LoRaWAN 1.1.x, use: node->beginOTAA(joinEUI, devEUI, nwkKey, appKey);
-        node->beginOTAA(joinEUI, devEUI, appKey, appKey);
-        
-        // Ensure DIO2 RF switch is set before TX and RX
-        radio->setDio2AsRfSwitch(true);
-        
-        // Set RX boosted gain for better sensitivity during join-accept
-        radio->setRxBoostedGainMode(true);
-        
-        #if DEBUG_SERIAL
-        Serial.println(F("[LoRa] Sending join request, waiting for accept..."));
-        
-        // Print full 8-byte EUIs for verification
-        Serial.print(F("[LoRa] JoinEUI: "));
-        uint8_t* joinBytes = (uint8_t*)&joinEUI;
-        for (int i = 7; i >= 0; i--) {
-            if (joinBytes[i] < 0x10) Serial.print('0');
-            Serial.print(joinBytes[i], HEX);
-        }
-        Serial.println();
-        
-        Serial.print(F("[LoRa] DevEUI:  "));
-        uint8_t* devBytes = (uint8_t*)&devEUI;
-        for (int i = 7; i >= 0; i--) {
-            if (devBytes[i] < 0x10) Serial.print('0');
-            Serial.print(devBytes[i], HEX);
-        }
-        Serial.println();
-        
-        Serial.print(F("[LoRa] NwkKey:  "));
-        for (int i = 0; i < 4; i++) {
-            if (nwkKey[i] < 0x10) Serial.print('0');
-            Serial.print(nwkKey[i], HEX);
-        }
-        Serial.println(F("... (first 4 bytes)"));
-        
-        Serial.print(F("[LoRa] AppKey:  "));
-        for (int i = 0; i < 4; i++) {
-            if (appKey[i] < 0x10) Serial.print('0');
-            Serial.print(appKey[i], HEX);
-        }
-        Serial.println(F("... (first 4 bytes, USING THIS FOR 1.0.x)"));
-        
-        Serial.println(F("[LoRa] Band: EU868, LoRaWAN 1.0.x mode"));
-        Serial.println(F("[LoRa] Waiting for join-accept (RX1: 5s, RX2: 6s)..."));
-        Serial.flush();
-        #endif
-        
-        // Put radio in standby before activation to ensure clean state
-        radio->standby();
-        
-        // Check if join was successful by attempting to activate
-        // activateOTAA() sends join request and waits for accept
-        int16_t result = node->activateOTAA();
-        
+    #if DEBUG_SERIAL
+    Serial.print(F("[LoRa] Join attempt "));
+    Serial.print(joinScheduler.getAttempts() + 1);
+    Serial.print(F(" at DR"));
+    Serial.println(datarate);
+    #endif
+    
+    // Attempt OTAA join (beginOTAA only configures the node in RadioLib 7)
+    // For LoRaWAN 1.0.x compatibility, use appKey for both nwkKey and appKey
+    // For LoRaWAN 1.1.x, use: node->beginOTAA(joinEUI, devEUI, nwkKey, appKey);
+    node->beginOTAA(joinEUI, devEUI, appKey, appKey);
+    
+    // Ensure DIO2 RF switch is set before TX and RX
+    radio->setDio2AsRfSwitch(true);
+    
+    // Set RX boosted gain for better sensitivity during join-accept
+    radio->setRxBoostedGainMode(true);
+    
+    #if DEBUG_SERIAL
+    Serial.println(F("[LoRa] Sending join request, waiting for accept..."));
+    
+    // Print full 8-byte EUIs for verification
+    Serial.print(F("[LoRa] JoinEUI: "));
+    uint8_t* joinBytes = (uint8_t*)&joinEUI;
+    for (int i = 7; i >= 0; i--) {
+        if (joinBytes[i] < 0x10) Serial.print('0');
+        Serial.print(joinBytes[i], HEX);
+    }
+    Serial.println();
+    
+    Serial.print(F("[LoRa] DevEUI:  "));
+    uint8_t* devBytes = (uint8_t*)&devEUI;
+    for (int i = 7; i >= 0; i--) {
+        if (devBytes[i] < 0x10) Serial.print('0');
+        Serial.print(devBytes[i], HEX);
+    }
+    Serial.println();
+    
+    Serial.print(F("[LoRa] NwkKey:  "));
+    for (int i = 0; i < 4; i++) {
+        if (nwkKey[i] < 0x10) Serial.print('0');
+        Serial.print(nwkKey[i], HEX);
+    }
+    Serial.println(F("... (first 4 bytes)"));
+    
+    Serial.print(F("[LoRa] AppKey:  "));
+    for (int i = 0; i < 4; i++) {
+        if (appKey[i] < 0x10) Serial.print('0');
+        Serial.print(appKey[i], HEX);
+    }
+    Serial.println(F("... (first 4 bytes, USING THIS FOR 1.0.x)"));
+    
+    Serial.print(F("[LoRa] Band: "));
+    Serial.print(Region::name);
+    Serial.println(F(", LoRaWAN 1.0.x mode"));
+    Serial.println(F("[LoRa] Waiting for join-accept (RX1: 5s, RX2: 6s)..."));
+    Serial.flush();
+    #endif
+    
+    // Put radio in standby before activation to ensure clean state
+    radio->standby();
+    
+    // Check if join was successful by attempting to activate
+    // activateOTAA() sends join request and waits for accept
+    int16_t result = node->activateOTAA(datarate);
+    
+    #if DEBUG_SERIAL
+    // Debug RX state
+    Serial.print(F("[LoRa] Post-RX BUSY: "));
+    Serial.println(digitalRead(LORA_BUSY) ? "HIGH" : "LOW");
+    Serial.print(F("[LoRa] Post-RX DIO1: "));
+    Serial.println(digitalRead(LORA_DIO1) ? "HIGH" : "LOW");
+    #endif
+    
+    // RADIOLIB_LORAWAN_NEW_SESSION (-1118) means join was successful!
+    bool accepted = result == RADIOLIB_ERR_NONE || result == RADIOLIB_LORAWAN_NEW_SESSION;
+    
+    // IMPORTANT: Save nonces after EVERY attempt (not just success)
+    // RadioLib increments DevNonce after sending, so we must save it
+    // even if we didn't receive the join-accept. A new session is
+    // committed together with the nonces it was derived from.
+    nvsStorage.beginUpdate();
+    uint8_t* nonces = node->getBufferNonces();
+    nvsStorage.saveNonces(nonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
+    #if SESSION_RESTORE
+    if (accepted) {
+        saveSession();
+    }
+    #endif
+    if (nvsStorage.commitUpdate()) {
         #if DEBUG_SERIAL
-        // Debug RX state
-        Serial.print(F("[LoRa] Post-RX BUSY: "));
-        Serial.println(digitalRead(LORA_BUSY) ? "HIGH" : "LOW");
-        Serial.print(F("[LoRa] Post-RX DIO1: "));
-        Serial.println(digitalRead(LORA_DIO1) ? "HIGH" : "LOW");
+        Serial.println(F("[LoRa] DevNonce saved to NVS"));
         #endif
-        
-        // IMPORTANT: Save nonces after EVERY attempt (not just success)
-        // RadioLib increments DevNonce after sending, so we must save it
-        // even if we didn't receive the join-accept
-        uint8_t* nonces = node->getBufferNonces();
-        if (nvsStorage.saveNonces(nonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE)) {
-            #if DEBUG_SERIAL
-            Serial.println(F("[LoRa] DevNonce saved to NVS"));
-            #endif
-        }
-        
-        // RADIOLIB_LORAWAN_NEW_SESSION (-1118) means join was successful!
-        if (result == RADIOLIB_ERR_NONE || result == RADIOLIB_LORAWAN_NEW_SESSION) {
-            state = LORA_JOINED;
-            uplinkCount = 0;
-            
-            #if DEBUG_SERIAL
-            Serial.println(F("[LoRa] ✓ Join successful!"));
-            Serial.print(F("[LoRa] Result code: "));
-            Serial.println(result);
-            #endif
-            
-            return true;
-        }
+    }
+    
+    if (accepted) {
+        state = LORA_JOINED;
+        uplinkCount = 0;
+        sessionUnverified = false;
+        applyDatarate(true);
+        joinScheduler.recordSuccess();
         
         #if DEBUG_SERIAL
-        Serial.print(F("[LoRa] Join attempt result: "));
+        Serial.println(F("[LoRa] ✓ Join successful!"));
+        Serial.print(F("[LoRa] Result code: "));
         Serial.println(result);
         #endif
         
-        // Wait before retry
-        if (retry < maxRetries - 1) {
-            delay(JOIN_RETRY_INTERVAL);
-        }
+        return true;
     }
     
-    state = LORA_JOIN_FAILED;
-    
     #if DEBUG_SERIAL
-    Serial.println(F("[LoRa] ✗ Join failed after all retries"));
+    Serial.print(F("[LoRa] Join attempt result: "));
+    Serial.println(result);
     #endif
     
+    joinScheduler.recordFailure(datarate);
+    
+    state = LORA_JOIN_FAILED;
+    
     return false;
 }
 
+uint64_t LoRaWANModule::macBackoffMs(uint8_t misses, uint32_t intervalMs) {
+    // LORAWAN_MAC_RETRY_MS doubling per unanswered request, at most intervalMs
+    uint64_t delayMs = (uint64_t)LORAWAN_MAC_RETRY_MS << (misses < 8 ? misses : 8);
+    return delayMs < intervalMs ? delayMs : intervalMs;
+}
+
+void LoRaWANModule::rollMacDay() {
+    // MAC requests and confirmed uplinks share TTN's 10 downlinks per 24 h
+    uint64_t now = airtime.clockMs();
+    if (now - mac.dayStartMs >= 24UL * 60 * 60 * 1000) {
+        mac.dayStartMs = now;
+        mac.requestsToday = 0;
+        mac.confirmedToday = 0;
+    }
+}
+
+bool LoRaWANModule::reserveConfirmed(uint8_t perDay) {
+    rollMacDay();
+    if (mac.confirmedToday >= perDay) return false;
+    mac.confirmedToday++;
+    return true;
+}
+
+void LoRaWANModule::queueMacRequests() {
+    // Each request costs one FOpts byte but makes the network send a
+    // downlink, which TTN limits to 10 a day: schedule them by time and
+    // cap the uplinks that carry any per 24 h
+    linkCheckAsked = false;
+    deviceTimeAsked = false;
+    
+    rollMacDay();
+    uint64_t now = airtime.clockMs();
+    if (mac.requestsToday >= LORAWAN_MAC_REQUESTS_PER_DAY) return;
+    
+    #if LORAWAN_LINK_CHECK_INTERVAL_MS > 0
+    if (now >= mac.linkCheckDueMs) {
+        node->sendMacCommandReq(RADIOLIB_LORAWAN_MAC_LINK_CHECK);
+        linkCheckAsked = true;
+    }
+    #endif
+    
+    // Network time only when the RTC has drifted past what it would give
+    #if LORAWAN_DEVICE_TIME_INTERVAL_MS > 0
+    if (now >= mac.deviceTimeDueMs &&
+        timebase.getUncertaintyMs() > LORAWAN_DEVICE_TIME_ACCURACY_MS) {
+        node->sendMacCommandReq(RADIOLIB_LORAWAN_MAC_DEVICE_TIME);
+        deviceTimeAsked = true;
+    }
+    #endif
+    
+    if (linkCheckAsked || deviceTimeAsked) {
+        mac.requestsToday++;
+    }
+}
+
+void LoRaWANModule::rescheduleMacRequests() {
+    // Answered requests were cleared by handleMacAnswers(); the rest back
+    // off, so a device out of coverage does not ask on every uplink
+    uint64_t now = airtime.clockMs();
+    
+    #if LORAWAN_LINK_CHECK_INTERVAL_MS > 0
+    if (linkCheckAsked) {
+        mac.linkCheckDueMs = now + macBackoffMs(mac.linkCheckMisses, LORAWAN_LINK_CHECK_INTERVAL_MS);
+        if (mac.linkCheckMisses < 0xFF) mac.linkCheckMisses++;
+    }
+    #endif
+    
+    #if LORAWAN_DEVICE_TIME_INTERVAL_MS > 0
+    if (deviceTimeAsked) {
+        mac.deviceTimeDueMs = now + macBackoffMs(mac.deviceTimeMisses, LORAWAN_DEVICE_TIME_INTERVAL_MS);
+        if (mac.deviceTimeMisses < 0xFF) mac.deviceTimeMisses++;
+    }
+    #endif
+    
+    linkCheckAsked = false;
+    deviceTimeAsked = false;
+}
+
+void LoRaWANModule::handleMacAnswers(uint64_t txStartTicks) {
+    uint8_t margin, gateways;
+    if (node->getMacLinkCheckAns(&margin, &gateways) == RADIOLIB_ERR_NONE) {
+        linkCheckValid = true;
+        gatewayCount = gateways;
+        linkMargin = margin;
+        linkCheckUplink = uplinkCount + 1;      // This uplink, counted below
+        linkCheckAsked = false;
+        mac.linkCheckMisses = 0;
+        mac.linkCheckDueMs = airtime.clockMs() + LORAWAN_LINK_CHECK_INTERVAL_MS;
+        
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] LinkCheck: "));
+        Serial.print(gateways);
+        Serial.print(F(" gateway(s), margin "));
+        Serial.print(margin);
+        Serial.println(F(" dB"));
+        #endif
+    }
+    
+    uint32_t unixSeconds;
+    uint8_t fraction;
+    if (node->getMacDeviceTimeAns(&unixSeconds, &fraction, true) == RADIOLIB_ERR_NONE) {
+        // The answer is the network time at the end of the uplink
+        uint64_t txEndTicks = txStartTicks + (uint64_t)node->getLastToA() * TIMEBASE_HZ / 1000;
+        uint64_t utcMs = (uint64_t)unixSeconds * 1000 + (uint32_t)fraction * 1000 / 256;
+        timebase.setUTCAt(utcMs, txEndTicks, LORAWAN_DEVICE_TIME_ACCURACY_MS);
+        deviceTimeAsked = false;
+        mac.deviceTimeMisses = 0;
+        mac.deviceTimeDueMs = airtime.clockMs() + LORAWAN_DEVICE_TIME_INTERVAL_MS;
+        
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] DeviceTime: "));
+        Serial.println(unixSeconds);
+        #endif
+    }
+}
+
+uint8_t LoRaWANModule::getMaxPayloadLen() {
+    // Application payload limit N of the current DR (region.h), less the
+    // FOpts bytes of the LinkCheckReq and DeviceTimeReq that may ride along
+    if (state != LORA_JOINED) return 0;
+    uint8_t maxLen = Region::maxPayload(currentDatarate) - MAC_REQUEST_BYTES;
+    uint8_t nodeLen = node->getMaxPayloadLen();   // Also knows pending MAC answers
+    return nodeLen < maxLen ? nodeLen : maxLen;
+}
+
 bool LoRaWANModule::sendUplink(uint8_t* data, uint8_t len, uint8_t port, bool confirmed) {
+    power.acquire(POWER_RADIO);
+    bool sent = transmit(data, len, port, confirmed);
+    power.release(POWER_RADIO);
+    return sent;
+}
+
+bool LoRaWANModule::transmit(uint8_t* data, uint8_t len, uint8_t port, bool confirmed) {
     if (state != LORA_JOINED) {
         #if DEBUG_SERIAL
         Serial.println(F("[LoRa] Cannot send: not joined"));
@@ -321,6 +678,33 @@ bool LoRaWANModule::sendUplink(uint8_t* data, uint8_t len, uint8_t port, bool co
         return false;
     }
     
+    lastDownlink = false;
+    lastAcked = false;
+    
+    // ADR may have lowered the DR since the frame was sized
+    if (len > getMaxPayloadLen()) {
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] Cannot send: "));
+        Serial.print(len);
+        Serial.print(F(" bytes exceed the DR"));
+        Serial.print(currentDatarate);
+        Serial.println(F(" limit"));
+        #endif
+        return false;
+    }
+    
+    // Fair-use budget: the caller should have slept until msUntilNextUplink()
+    lastPayloadLen = len;
+    uint32_t budgetWait = airtime.msUntilAllowed(estimateToA());
+    if (budgetWait > 0) {
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] Airtime budget exhausted, next uplink in "));
+        Serial.print(budgetWait / 1000);
+        Serial.println(F(" s"));
+        #endif
+        return false;
+    }
+    
     // Ensure radio is ready - standby mode and RF switch configured
     radio->standby();
     radio->setDio2AsRfSwitch(true);
@@ -361,36 +745,121 @@ bool LoRaWANModule::sendUplink(uint8_t* data, uint8_t len, uint8_t port, bool co
     Serial.println();
     #endif
     
+    // A restored session is confirmed once, so a stale one is noticed
+    if (sessionUnverified) {
+        confirmed = true;
+    }
+    
+    // LinkCheckReq / DeviceTimeReq ride in FOpts of this uplink
+    queueMacRequests();
+    uint64_t txStartTicks = timebase.ticks();
+    
     // Send uplink using sendReceive (handles MAC layer properly)
     // The third parameter (port) is where data is sent
     // Fourth parameter is downlink buffer (nullptr = no downlink expected for unconfirmed)
-    int16_t result = node->sendReceive(data, len, port);
+    uint8_t downlinkData[256];
+    size_t downlinkLen = 0;
+    LoRaWANEvent_t eventUp;
+    LoRaWANEvent_t eventDown;
+    memset(&eventUp, 0, sizeof(eventUp));      // Channel unknown if the uplink never went out
+    memset(&eventDown, 0, sizeof(eventDown));
+    eventUp.datarate = currentDatarate;
+    int16_t result = node->sendReceive(data, len, port, downlinkData, &downlinkLen,
+                                       confirmed, &eventUp, &eventDown);
+    lastResult = result;
+    
+    // RadioLib 7: > 0 is the RX window a downlink (or bare ACK) arrived in,
+    // 0 means the uplink went out and nothing came back. Only a downlink
+    // proves the network knows the session.
+    bool downlink = result > 0;
+    lastDownlink = downlink;
+    
+    // A downlink without the ACK bit (MAC-only, or an answer to the
+    // previous frame) does not confirm this uplink
+    lastAcked = downlink && confirmed && eventDown.confirming;
+    
+    // RSSI/SNR describe the last packet the radio received, so they are
+    // only meaningful (and only kept) when a downlink arrived; on 0 or an
+    // RX error they would be the previous downlink's or noise
+    linkStats.recordUplink(eventUp.freq, eventUp.datarate, result, confirmed, lastAcked, node->getLastToA());
+    if (downlink) {
+        lastRSSI = radio->getRSSI();
+        lastSNR = radio->getSNR();
+        linkStats.recordDownlink(eventUp.freq, eventUp.datarate, lastRSSI, lastSNR);
+        handleMacAnswers(txStartTicks);
+    }
+    rescheduleMacRequests();
+    if (sessionUnverified) {
+        if (downlink) {
+            sessionUnverified = false;
+            #if DEBUG_SERIAL
+            Serial.println(F("[LoRa] Restored session acknowledged by network"));
+            #endif
+        } else if (++unverifiedUplinks >= SESSION_VERIFY_UPLINKS) {
+            #if DEBUG_SERIAL
+            Serial.println(F("[LoRa] Restored session not acknowledged - rejoining"));
+            #endif
+            nvsStorage.clearSession();
+            sessionUnverified = false;
+            state = LORA_NOT_JOINED;
+            return false;
+        }
+    }
     
     // Handle specific errors/success codes
-    // RADIOLIB_ERR_NONE = success with downlink
-    // RADIOLIB_LORAWAN_NO_DOWNLINK = success, no downlink (normal for unconfirmed)
+    // RADIOLIB_ERR_NONE = success, no downlink (normal for unconfirmed)
+    // RADIOLIB_LORAWAN_NO_DOWNLINK = same, from older RadioLib releases
     // RADIOLIB_ERR_CRC_MISMATCH (-7) = RX got corrupted data (uplink likely succeeded)
     // RADIOLIB_ERR_RX_TIMEOUT (-6) = no downlink received (uplink likely succeeded)
-    if (result == RADIOLIB_ERR_NONE || 
+    // > 0 = downlink received in that RX window (RadioLib 7)
+    if (result >= RADIOLIB_ERR_NONE || 
         result == RADIOLIB_LORAWAN_NO_DOWNLINK ||
         result == RADIOLIB_ERR_CRC_MISMATCH ||
         result == RADIOLIB_ERR_RX_TIMEOUT) {
         uplinkCount++;
         
-        // Get RSSI and SNR
-        lastRSSI = radio->getRSSI();
-        lastSNR = radio->getSNR();
+        // Book the real time-on-air (analytic estimate if RadioLib has none)
+        uint32_t toa = node->getLastToA();
+        airtime.record(toa ? toa : estimateToA());
+        
+        // FCntUp lives in the session buffer; a stale copy would replay counters
+        #if SESSION_RESTORE
+        if (++uplinksSinceSave >= SESSION_SAVE_INTERVAL) {
+            saveSession();
+        }
+        #endif
+        
+        // DR and power actually used (ADR may have changed them)
+        if (eventUp.datarate != currentDatarate || eventUp.power != currentTxPower) {
+            #if DEBUG_SERIAL
+            Serial.print(F("[LoRa] DR"));
+            Serial.print(currentDatarate);
+            Serial.print(F("/"));
+            Serial.print(currentTxPower);
+            Serial.print(F("dBm -> DR"));
+            Serial.print(eventUp.datarate);
+            Serial.print(F("/"));
+            Serial.print(eventUp.power);
+            Serial.println(F("dBm"));
+            #endif
+            currentDatarate = eventUp.datarate;
+            currentTxPower = eventUp.power;
+        }
         
         #if DEBUG_SERIAL
         Serial.print(F("[LoRa] ✓ Uplink #"));
         Serial.print(uplinkCount);
         Serial.print(F(" sent (result: "));
         Serial.print(result);
-        Serial.print(F("), RSSI: "));
-        Serial.print(lastRSSI);
-        Serial.print(F(" dBm, SNR: "));
-        Serial.print(lastSNR);
-        Serial.println(F(" dB"));
+        if (downlink) {
+            Serial.print(F("), downlink RSSI: "));
+            Serial.print(lastRSSI);
+            Serial.print(F(" dBm, SNR: "));
+            Serial.print(lastSNR);
+            Serial.println(F(" dB"));
+        } else {
+            Serial.println(F("), no downlink"));
+        }
         #endif
         
         return true;
@@ -403,6 +872,96 @@ bool LoRaWANModule::sendUplink(uint8_t* data, uint8_t len, uint8_t port, bool co
     }
 }
 
+uint32_t LoRaWANModule::msUntilNextUplink() {
+    if (state != LORA_JOINED) return 0;
+    
+    // Regulatory duty cycle (RadioLib) and fair-use budget (ledger)
+    uint32_t dutyCycle = node->timeUntilUplink();
+    uint32_t budget = airtime.msUntilAllowed(estimateToA());
+    return dutyCycle > budget ? dutyCycle : budget;
+}
+
+uint32_t LoRaWANModule::getNextInterval(uint32_t minIntervalMs) {
+    uint32_t interval = airtime.intervalFor(estimateToA(), minIntervalMs);
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[LoRa] Airtime "));
+    Serial.print(airtime.getUsedMs());
+    Serial.print(F("/"));
+    Serial.print(AIRTIME_DAILY_BUDGET_MS);
+    Serial.print(F(" ms in 24h, ~"));
+    Serial.print(estimateToA());
+    Serial.print(F(" ms per uplink at DR"));
+    Serial.print(currentDatarate);
+    Serial.print(F(", interval "));
+    Serial.print(interval / 1000);
+    Serial.println(F(" s"));
+    #endif
+    
+    return interval;
+}
+
+bool LoRaWANModule::sendUplinkAsync(const uint8_t* data, uint8_t len, uint8_t port, bool confirmed,
+                                    UplinkCallback callback) {
+    if (uplinkTask == nullptr || uplinkBusy || state != LORA_JOINED) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[LoRa] Cannot start async uplink"));
+        #endif
+        return false;
+    }
+    
+    memcpy(requestData, data, len);
+    requestLen = len;
+    requestPort = port;
+    requestConfirmed = confirmed;
+    requestCallback = callback;
+    
+    xSemaphoreTake(doneSem, 0);     // Drop a stale completion
+    uplinkBusy = true;
+    xSemaphoreGive(requestSem);
+    
+    return true;
+}
+
+bool LoRaWANModule::waitForUplink(uint32_t timeoutMs) {
+    if (!uplinkBusy) return true;
+    
+    if (xSemaphoreTake(doneSem, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+        return false;
+    }
+    return true;
+}
+
+void LoRaWANModule::uplinkTaskMain(void* arg) {
+    LoRaWANModule* self = (LoRaWANModule*)arg;
+    
+    for (;;) {
+        xSemaphoreTake(self->requestSem, portMAX_DELAY);
+        
+        UplinkResult result;
+        taskMonitor.busyBegin(self->monitorSlot);
+        result.success = self->sendUplink(self->requestData, self->requestLen,
+                                          self->requestPort, self->requestConfirmed);
+        taskMonitor.busyEnd(self->monitorSlot);
+        result.code = self->lastResult;
+        result.rssi = self->lastRSSI;
+        result.snr = self->lastSNR;
+        result.uplinkCount = self->uplinkCount;
+        
+        #if DEBUG_SERIAL
+        Serial.print(F("[LoRa] Async uplink done, DIO1 events: "));
+        Serial.println(self->hal->getDio1Events());
+        #endif
+        
+        if (self->requestCallback) {
+            self->requestCallback(result);
+        }
+        
+        self->uplinkBusy = false;
+        xSemaphoreGive(self->doneSem);
+    }
+}
+
 void LoRaWANModule::sleep() {
     radio->sleep();
     
@@ -3,6 +3,66 @@
 
 #include <Arduino.h>
 #include <RadioLib.h>
+#include "airtime.h"
+
+// Outcome of an asynchronous uplink, passed to the completion callback
+struct UplinkResult {
+    bool success;
+    int16_t code;           // RadioLib result code
+    int16_t rssi;           // dBm
+    int8_t snr;             // dB
+    uint32_t uplinkCount;
+};
+
+typedef void (*UplinkCallback)(const UplinkResult& result);
+
+// RadioLib HAL that blocks the calling task on DIO1 instead of spinning.
+// RadioLib polls DIO1 with yield() while waiting for TX done, RX done or
+// RX timeout; here each yield() sleeps on a semaphore given from the DIO1
+// interrupt (chained in front of RadioLib's own handler), so the CPU can
+// idle through the radio events.
+class LoRaHal : public ArduinoHal {
+public:
+    LoRaHal(SPIClass& spi, SPISettings settings);
+    
+    void attachInterrupt(uint32_t interruptNum, void (*interruptCb)(void), uint32_t mode) override;
+    void detachInterrupt(uint32_t interruptNum) override;
+    void yield() override;
+    
+    uint32_t getDio1Events() { return dio1Events; }
+
+private:
+    static void onDio1();
+    static void (*radioCallback)(void);
+    static SemaphoreHandle_t dio1Sem;
+    static volatile uint32_t dio1Events;
+};
+
+// Session and counters carried across a System OFF power-down (see checkpoint.h)
+// When the piggy-backed MAC requests are due next (ledger clock, airtime.h)
+struct MacSchedule {
+    uint64_t linkCheckDueMs;
+    uint64_t deviceTimeDueMs;
+    uint64_t dayStartMs;            // Start of the current 24 h request window
+    uint8_t requestsToday;          // Uplinks that carried a request in that window
+    uint8_t confirmedToday;         // Confirmed uplinks (queue replays) in that window
+    uint8_t linkCheckMisses;        // Unanswered requests in a row (backoff exponent)
+    uint8_t deviceTimeMisses;
+};
+
+struct LoRaCheckpoint {
+    uint8_t nonces[RADIOLIB_LORAWAN_NONCES_BUF_SIZE];
+    uint8_t session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];    // Includes FCntUp
+    uint32_t uplinkCount;
+    bool sessionUnverified;
+    uint8_t unverifiedUplinks;
+    uint8_t uplinksSinceSave;
+    MacSchedule mac;
+    uint8_t lastPayloadLen;
+    uint8_t datarate;
+    int8_t txPower;
+    AirtimeRecord airtime;
+};
 
 // LoRaWAN session state
 enum LoRaWANState {
@@ -19,38 +79,121 @@ public:
     // Initialization
     bool begin();
     
-    // OTAA Join
-    bool join(uint8_t maxRetries = 10);
+    // OTAA Join: restores the saved session, or sends one join request
+    // (JoinScheduler decides the data rate and the wait between calls)
+    bool join();
+    bool restoreSession();
+    
+    // Live session across System OFF (no NVS involved); offMs ages the airtime ledger
+    void save(LoRaCheckpoint& checkpoint);
+    bool resume(const LoRaCheckpoint& checkpoint, uint32_t offMs);
+    bool isSessionVerified() { return !sessionUnverified; }
     bool isJoined() { return state == LORA_JOINED; }
     LoRaWANState getState() { return state; }
     
     // Transmission
     bool sendUplink(uint8_t* data, uint8_t len, uint8_t port = 1, bool confirmed = false);
     
-    // Power management
+    // Asynchronous transmission: copies the payload and returns at once; the
+    // uplink task runs TX/RX1/RX2 and then calls callback (from that task)
+    bool sendUplinkAsync(const uint8_t* data, uint8_t len, uint8_t port, bool confirmed,
+                         UplinkCallback callback);
+    bool isBusy() { return uplinkBusy; }
+    bool waitForUplink(uint32_t timeoutMs);
+    
+    // Airtime budget: earliest legal uplink and budget-fitting interval
+    uint32_t msUntilNextUplink();
+    bool reserveConfirmed(uint8_t perDay);  // Counts one confirmed uplink against a daily cap
+    uint32_t getNextInterval(uint32_t minIntervalMs);
+    AirtimeLedger& getAirtime() { return airtime; }
+    
+    uint8_t getMaxPayloadLen();
+    
+    // Radio sleep/standby (driven through POWER_RADIO, see power.h)
     void sleep();
     void wakeup();
     
-    // Statistics
+    // Statistics (RSSI/SNR of the last downlink; per channel in link_stats.h)
     uint32_t getUplinkCount() { return uplinkCount; }
     int16_t getLastRSSI() { return lastRSSI; }
     int8_t getLastSNR() { return lastSNR; }
+    bool wasAcknowledged() { return lastAcked; }
+    uint8_t getDatarate() { return currentDatarate; }
+    
+    // Coverage from the last LinkCheckAns (gateways that heard the uplink,
+    // and the best demodulation margin in dB above the sensitivity floor)
+    bool hasLinkCheck() { return linkCheckValid; }
+    uint8_t getGatewayCount() { return gatewayCount; }
+    uint8_t getLinkMargin() { return linkMargin; }
+    uint32_t getLinkCheckAge() { return uplinkCount - linkCheckUplink; }   // Uplinks since the answer
+    int8_t getTxPower() { return currentTxPower; }
     
     // Direct access to LoRaWAN node
     LoRaWANNode* getNode() { return node; }
 
 private:
     SPIClass* rfPort;
+    LoRaHal* hal;
     Module* radioModule;
     SX1262* radio;
     LoRaWANNode* node;
     LoRaWANState state;
     
     uint32_t uplinkCount;
-    int16_t lastRSSI;
+    int16_t lastRSSI;               // Last downlink (not updated without one)
     int8_t lastSNR;
     
-    bool configureRadio();
+    // Uplink task and the single in-flight request
+    TaskHandle_t uplinkTask;
+    SemaphoreHandle_t requestSem;
+    SemaphoreHandle_t doneSem;
+    int8_t monitorSlot;             // TaskMonitor slot of the uplink task
+    volatile bool uplinkBusy;
+    uint8_t requestData[256];
+    uint8_t requestLen;
+    uint8_t requestPort;
+    bool requestConfirmed;
+    UplinkCallback requestCallback;
+    int16_t lastResult;
+    bool lastDownlink;              // Last uplink got a downlink
+    bool lastAcked;                 // Last uplink was confirmed and the downlink carried the ACK bit
+    
+    // Session persistence
+    bool sessionUnverified;         // Restored session not yet acknowledged by the network
+    uint8_t unverifiedUplinks;
+    uint8_t uplinksSinceSave;
+    void saveSession();
+    int16_t activate(const uint8_t* nonces, const uint8_t* session);
+    
+    // Data rate / TX power in use (from the last uplink event)
+    uint8_t currentDatarate;
+    int8_t currentTxPower;
+    void applyDatarate(bool fresh);
+    
+    // Piggy-backed MAC requests
+    bool linkCheckValid;
+    uint8_t gatewayCount;
+    uint8_t linkMargin;
+    uint32_t linkCheckUplink;       // uplinkCount when the last LinkCheckAns came
+    MacSchedule mac;
+    bool linkCheckAsked;            // Requests riding on the current uplink
+    bool deviceTimeAsked;
+    void queueMacRequests();
+    void rollMacDay();
+    void handleMacAnswers(uint64_t txStartTicks);
+    void rescheduleMacRequests();
+    static uint64_t macBackoffMs(uint8_t misses, uint32_t intervalMs);
+    
+    // Time-on-air bookkeeping
+    AirtimeLedger airtime;
+    uint8_t lastPayloadLen;
+    uint32_t estimateToA() { return AirtimeLedger::timeOnAir(currentDatarate, lastPayloadLen); }
+    
+    // Join / uplink bodies, run with POWER_RADIO held
+    bool joinOnce();
+    bool transmit(uint8_t* data, uint8_t len, uint8_t port, bool confirmed);
+    
+    static void uplinkTaskMain(void* arg);
 };
 
 // Global LoRaWAN instance
@@ -2,10 +2,25 @@
 #include "../include/config.h"
 #include "../include/pins.h"
 #include "gps.h"
+#include "gps_power.h"
+#include "constellation.h"
 #include "lora.h"
 #include "payload.h"
 #include "display.h"
 #include "nvs.h"
+#include "timebase.h"
+#include "motion.h"
+#include "join_scheduler.h"
+#include "flash_queue.h"
+#include "power.h"
+#include "region.h"
+#include "link_stats.h"
+#include "pipeline.h"
+#include "task_monitor.h"
+#include "sleep.h"
+#include "ext_rtc.h"
+#include "checkpoint.h"
+#include "adaptive_interval.h"
 
 // Application state
 enum AppState {
@@ -22,20 +37,31 @@ enum AppState {
 AppState currentState = STATE_INIT;
 uint32_t lastTransmitTime = 0;
 uint32_t cycleCount = 0;
+uint32_t stationaryCycles = 0;  // Consecutive cycles that skipped the GPS
 GPSData lastValidGPSData;  // Store last valid GPS data for transmission
+UplinkResult lastUplink;   // Filled by the LoRa task when an uplink completes
+bool drainPending = false;  // Replay stored fixes in the next sleep
 
 // Function declarations
-void initializeHardware();
+void initializeHardware(bool resuming);
+bool resumeFromCheckpoint();
 void handleState();
-void performTransmissionCycle();
-void enterDeepSleep(uint32_t seconds);
+void sleepFor(uint32_t ms);
+bool enterSystemOff(uint32_t sleepMs);
 void blinkLED(uint8_t count);
+void onUplinkComplete(const UplinkResult& result);
+uint32_t drainQueue(uint32_t budgetMs);
 
 void setup() {
+    // A wake from System OFF continues the saved cycle instead of booting
+    bool resuming = checkpoint.load();
+    
     // Initialize serial for debugging
     #if DEBUG_SERIAL
     Serial.begin(DEBUG_BAUD_RATE);
-    delay(2000);  // Wait for serial connection
+    if (!resuming) {
+        delay(2000);  // Wait for serial connection
+    }
     Serial.println(F("\n\n"));
     Serial.println(F("========================================"));
     Serial.println(F("  T-Echo TTNMapper GPS Tracker"));
@@ -49,7 +75,12 @@ void setup() {
     #endif
     
     // Initialize hardware (GPS and LoRa)
-    initializeHardware();
+    initializeHardware(resuming);
+    
+    // Fast path: session, counters and last fix from the checkpoint, no join
+    if (resuming && currentState != STATE_ERROR && resumeFromCheckpoint()) {
+        return;
+    }
     
     // Attempt LoRa join BEFORE initializing display (display is slow)
     #if DEBUG_SERIAL
@@ -57,7 +88,14 @@ void setup() {
     Serial.flush();
     #endif
     
-    if (loraModule.join(MAX_JOIN_RETRIES)) {
+    // join() restores a saved session first; a reset in the middle of a
+    // join backoff waits it out in STATE_JOIN
+    bool joined = false;
+    if (joinScheduler.getDelayMs() == 0) {
+        joined = loraModule.join();
+    }
+    
+    if (joined) {
         #if DEBUG_SERIAL
         Serial.println(F("[Main] ✓ LoRaWAN join successful!"));
         Serial.flush();
@@ -67,7 +105,7 @@ void setup() {
         #if DEBUG_SERIAL
         Serial.println(F("[Main] ✗ LoRaWAN join failed"));
         #endif
-        currentState = STATE_JOIN;  // Will retry in loop
+        currentState = STATE_JOIN;  // Scheduler decides when to retry
     }
     
     // Now initialize display (slow e-ink refresh)
@@ -94,10 +132,19 @@ void setup() {
 }
 
 void loop() {
+    #if DEBUG_SERIAL
+    // Console commands: 'l' dumps the link statistics, 'R' clears them
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c == 'l') linkStats.dump();
+        if (c == 'R') linkStats.reset();
+    }
+    #endif
+    
     handleState();
 }
 
-void initializeHardware() {
+void initializeHardware(bool resuming) {
     #if DEBUG_SERIAL
     Serial.println(F("[Init] Initializing hardware..."));
     #endif
@@ -110,12 +157,22 @@ void initializeHardware() {
     digitalWrite(LED_GREEN, LOW);
     digitalWrite(LED_BLUE, LOW);
     
-    // Power enable
-    pinMode(PIN_POWER_EN, OUTPUT);
-    digitalWrite(PIN_POWER_EN, HIGH);
+    // RTC2 timebase first: power accounting runs on its ticks, and the
+    // PPS edges are captured from here on, before the GPS is powered
+    timebase.begin();
+    
+    // Regulators and power domains. The radio and the sensors share the
+    // 3V3 rail and are not re-initialised after losing it, so it stays held.
+    power.begin();
+    power.acquire(POWER_RAIL);
     
-    // Blink to show we're alive
-    blinkLED(3);
+    // Wake sources for the sleeps between cycles
+    sleepService.begin();
+    
+    // Blink to show we're alive (not on every System OFF wake)
+    if (!resuming) {
+        blinkLED(3);
+    }
     
     // Initialize NVS (for storing LoRaWAN DevNonce across reboots)
     if (!nvsStorage.begin()) {
@@ -125,8 +182,34 @@ void initializeHardware() {
         // Continue anyway - NVS is optional
     }
     
-    // Initialize GPS first
-    if (!gpsModule.begin()) {
+    // Join backoff survives resets
+    joinScheduler.begin();
+    linkStats.begin();
+    
+    // Fixes that missed their uplink wait on the QSPI flash
+    #if FLASH_QUEUE_ENABLED
+    flashQueue.begin();
+    #endif
+    
+    // Pressure sensor for stationary detection (optional)
+    #if MOTION_ENABLED
+    motion.begin();
+    #endif
+    
+    // PCF8563: System OFF wake and the time spent powered down
+    extRtc.begin();
+    
+    // It kept UTC through the reset, so the GPS gets time aiding at boot.
+    // After System OFF, resumeFromCheckpoint() knows the error better.
+    uint32_t rtcUtc;
+    if (!resuming && extRtc.readTime(rtcUtc) && rtcUtc >= EXT_RTC_UTC_FLOOR) {
+        timebase.setUTC(rtcUtc, EXT_RTC_BOOT_UNCERTAINTY_MS);
+    }
+    
+    // Initialize GPS first; after System OFF it is still configured
+    bool gpsReady = resuming ? gpsModule.resume((GPSProfile)checkpoint.get().gpsProfile)
+                             : gpsModule.begin();
+    if (!gpsReady) {
         #if DEBUG_SERIAL
         Serial.println(F("[Init] ✗ GPS initialization failed!"));
         #endif
@@ -143,6 +226,10 @@ void initializeHardware() {
         return;
     }
     
+    // GPS acquisition and storage tasks; this task keeps the state machine
+    taskMonitor.add(xTaskGetCurrentTaskHandle(), "loop", 0);
+    pipeline.begin();
+    
     #if DEBUG_SERIAL
     Serial.println(F("[Init] ✓ Hardware initialized successfully\n"));
     #endif
@@ -155,15 +242,29 @@ void handleState() {
             currentState = STATE_JOIN;
             break;
             
-        case STATE_JOIN:
+        case STATE_JOIN: {
+            // Back off as the join scheduler says; no reboot between attempts
+            uint32_t waitMs = joinScheduler.getDelayMs();
+            
             #if DEBUG_SERIAL
-            Serial.println(F("\n[State] JOINING TTN..."));
+            Serial.print(F("\n[State] JOINING TTN in "));
+            Serial.print(waitMs / 1000);
+            Serial.println(F(" s..."));
             #endif
             
+            if (waitMs > 0) {
+                display.showJoinFailed(waitMs / 1000);
+                gpsPower.enter(gpsPower.choose(waitMs));
+                display.sleep();
+                power.sleepBegin();
+                sleepFor(waitMs);
+                power.sleepEnd();
+            }
+            
             // Attempt OTAA join
-            display.showJoining(1, MAX_JOIN_RETRIES);
+            display.showJoining(joinScheduler.getAttempts() + 1, joinScheduler.nextDatarate());
             
-            if (loraModule.join(MAX_JOIN_RETRIES)) {
+            if (loraModule.join()) {
                 #if DEBUG_SERIAL
                 Serial.println(F("[State] ✓ Join successful!\n"));
                 #endif
@@ -172,19 +273,9 @@ void handleState() {
                 delay(2000);
                 
                 currentState = STATE_JOINED;
-            } else {
-                #if DEBUG_SERIAL
-                Serial.println(F("[State] ✗ Join failed after all retries"));
-                Serial.println(F("[State] Restarting in 30 seconds...\n"));
-                #endif
-                
-                display.showJoinFailed();
-                delay(30000);
-                
-                // Restart
-                NVIC_SystemReset();
             }
             break;
+        }
             
         case STATE_JOINED:
             #if DEBUG_SERIAL
@@ -201,20 +292,61 @@ void handleState() {
             Serial.flush();
             #endif
             
-            display.showGPSSearching();
-            
-            #if DEBUG_SERIAL
-            Serial.println(F("[State] Display updated, waking GPS..."));
-            Serial.flush();
+            // Parked device: keep the GPS asleep and reuse (or skip) the last fix
+            #if MOTION_ENABLED
+            if (motion.isStationary() && lastValidGPSData.valid && stationaryCycles < MOTION_MAX_SKIPPED) {
+                stationaryCycles++;
+                
+                #if DEBUG_SERIAL
+                Serial.print(F("[State] Stationary ("));
+                Serial.print(stationaryCycles);
+                Serial.print(F("/"));
+                Serial.print(MOTION_MAX_SKIPPED);
+                Serial.println(MOTION_STATIONARY_REUSE ? F(") - reusing last fix") : F(") - skipping cycle"));
+                #endif
+                
+                currentState = MOTION_STATIONARY_REUSE ? STATE_TRANSMIT : STATE_SLEEP;
+                
+                // The cached fix is the last reported point, so it counts as
+                // suppressed until INTERVAL_MAX_SUPPRESSED forces a heartbeat.
+                // Parked means speed 0, not the speed it was taken at.
+                #if INTERVAL_ADAPTIVE
+                if (MOTION_STATIONARY_REUSE) {
+                    GPSData parked = lastValidGPSData;
+                    parked.speed = 0;
+                    if (!adaptiveInterval.update(parked)) {
+                        currentState = STATE_SLEEP;
+                    }
+                }
+                #endif
+                break;
+            }
+            stationaryCycles = 0;
             #endif
             
-            // Wake up GPS
-            gpsModule.wakeup();
-            delay(100);
+            // The GPS task wakes the receiver while the display task refreshes
+            pipeline.requestFix(GPS_FIX_TIMEOUT_MS);
+            display.showGPSSearching();
             
             // Wait for GPS fix
-            if (gpsModule.waitForFix(GPS_FIX_TIMEOUT_MS)) {
-                lastValidGPSData = gpsModule.getData();  // Store the valid GPS data
+            FixResult fix;
+            if (pipeline.waitForFix(fix)) {
+                // The fix overrules a quiet barometer (level roads, lifts)
+                #if MOTION_ENABLED
+                bool displaced = lastValidGPSData.valid &&
+                    AdaptiveInterval::distanceM(lastValidGPSData.latitude, lastValidGPSData.longitude,
+                                                fix.data.latitude, fix.data.longitude) >= INTERVAL_MIN_DISPLACEMENT_M;
+                if (displaced || fix.data.speed >= INTERVAL_MIN_SPEED_KMH) {
+                    motion.markMoving();
+                }
+                #endif
+                
+                lastValidGPSData = fix.data;  // Store the valid GPS data
+                
+                // Keep the PCF8563 on UTC for the next boot's time aiding
+                if (timebase.isDisciplined()) {
+                    extRtc.setTime(timebase.nowUTC());
+                }
                 
                 #if DEBUG_SERIAL
                 Serial.println(F("[State] ✓ GPS fix acquired"));
@@ -229,6 +361,13 @@ void handleState() {
                 
                 // Go straight to transmit (skip slow display update)
                 currentState = STATE_TRANSMIT;
+                
+                // Same spot as the last report: nothing new for the map
+                #if INTERVAL_ADAPTIVE
+                if (!adaptiveInterval.update(fix.data)) {
+                    currentState = STATE_SLEEP;
+                }
+                #endif
             } else {
                 #if DEBUG_SERIAL
                 Serial.println(F("[State] ✗ GPS fix timeout - skipping uplink\n"));
@@ -276,9 +415,30 @@ void handleState() {
                 break;
             }
             
+            // Sent or stored for replay, it is the new reference point
+            #if INTERVAL_ADAPTIVE
+            adaptiveInterval.markReported(gpsData);
+            #endif
+            
             // Encode GPS payload
+            #if BATCH_MODE
+            // Queue the fix and only wake the radio once a frame is worth sending
+            batchEncoder.add(gpsData);
+            uint8_t maxLen = loraModule.getMaxPayloadLen();
+            if (!batchEncoder.isReady(maxLen)) {
+                currentState = STATE_SLEEP;
+                break;
+            }
+            
+            uint8_t payload[Region::maxPayloadAll];
+            uint8_t batchPoints = 0;
+            uint8_t payloadLen = batchEncoder.encode(payload, maxLen, batchPoints);
+            uint8_t payloadPort = BATCH_PORT;
+            #else
             uint8_t payload[TTNMAPPER_PAYLOAD_SIZE];
             uint8_t payloadLen = payloadEncoder.encode(gpsData, payload);
+            uint8_t payloadPort = TTNMAPPER_PORT;
+            #endif
             
             if (payloadLen == 0) {
                 #if DEBUG_SERIAL
@@ -288,12 +448,21 @@ void handleState() {
                 break;
             }
             
-            // Show transmission on display
-            display.showTransmitting(cycleCount);
-            
-            // Send uplink
+            // Start the uplink; TX, RX1 and RX2 run in the LoRa task
             digitalWrite(LED_BLUE, HIGH);
-            bool success = loraModule.sendUplink(payload, payloadLen, TTNMAPPER_PORT, LORAWAN_CONFIRMED);
+            bool success = false;
+            if (loraModule.sendUplinkAsync(payload, payloadLen, payloadPort, LORAWAN_CONFIRMED, onUplinkComplete)) {
+                // Refresh the display while the RX windows are open
+                display.showStatus(gpsData, loraModule.getState(), cycleCount);
+                
+                if (loraModule.waitForUplink(LORA_UPLINK_TIMEOUT_MS)) {
+                    success = lastUplink.success;
+                } else {
+                    #if DEBUG_SERIAL
+                    Serial.println(F("[State] Uplink still running after timeout"));
+                    #endif
+                }
+            }
             digitalWrite(LED_BLUE, LOW);
             
             if (success) {
@@ -301,13 +470,31 @@ void handleState() {
                 Serial.println(F("[State] ✓ Transmission successful\n"));
                 #endif
                 
+                #if BATCH_MODE
+                batchEncoder.consume(batchPoints);
+                #endif
+                
                 blinkLED(2);  // 2 blinks = success
                 lastTransmitTime = millis();
+                
+                // The link is up: replay fixes stored during the outage
+                // once the duty cycle allows (see STATE_SLEEP)
+                drainPending = true;
             } else {
                 #if DEBUG_SERIAL
                 Serial.println(F("[State] ✗ Transmission failed\n"));
                 #endif
                 
+                // Keep the fix for later (batch mode keeps its points in RAM)
+                #if FLASH_QUEUE_ENABLED && !BATCH_MODE
+                pipeline.storeFix(payload, gpsData.utc);
+                #endif
+                
+                // Network rejected a restored session: join from scratch
+                if (!loraModule.isJoined()) {
+                    currentState = STATE_JOIN;
+                }
+                
                 // Blink red LED on failure
                 for (int i = 0; i < 3; i++) {
                     digitalWrite(LED_RED, HIGH);
@@ -317,34 +504,100 @@ void handleState() {
                 }
             }
             
-            // Update status display
-            display.showStatus(gpsData, loraModule.getState(), cycleCount);
-            
             // Move to sleep state
-            currentState = STATE_SLEEP;
+            if (currentState == STATE_TRANSMIT) {
+                currentState = STATE_SLEEP;
+            }
             break;
         }
             
-        case STATE_SLEEP:
+        case STATE_SLEEP: {
+            // Align cycles to UTC slots once the timebase knows the time.
+            // The DevEUI spreads devices sharing an interval across the slot;
+            // catching the next slot keeps each sleep within 0.5-1.5 intervals.
+            // The interval follows the speed, and stretches when the current DR
+            // would overspend the budget.
+            #if INTERVAL_ADAPTIVE
+            uint32_t intervalMs = loraModule.getNextInterval(adaptiveInterval.nextInterval());
+            #else
+            uint32_t intervalMs = loraModule.getNextInterval(TX_INTERVAL_MS);
+            #endif
+            uint32_t sleepMs = intervalMs;
+            #if TX_SLOT_ALIGN
+            sleepMs = timebase.msUntilSlot(intervalMs, (uint32_t)(devEUI % intervalMs));
+            if (sleepMs < intervalMs / 2) {
+                sleepMs += intervalMs;  // Skip a slot closer than half an interval
+            }
+            #endif
+            
+            // Never wake before the next legal uplink (duty cycle / fair use)
+            uint32_t legalMs = loraModule.msUntilNextUplink();
+            if (sleepMs < legalMs) {
+                sleepMs = legalMs;
+            }
+            
             #if DEBUG_SERIAL
             Serial.print(F("\n[State] SLEEP - Next transmission in "));
-            Serial.print(TX_INTERVAL_MS / 1000);
-            Serial.println(F(" seconds\n"));
+            Serial.print(sleepMs / 1000);
+            Serial.print(F(" seconds (UTC "));
+            Serial.print(timebase.nowUTC());
+            Serial.print(F(", +/- "));
+            Serial.print(timebase.getUncertaintyMs());
+            Serial.print(F(" ms, drift "));
+            Serial.print(timebase.getDriftPPB());
+            Serial.println(F(" ppb)\n"));
             Serial.flush();
             #endif
             
-            // Put GPS to sleep to save power
-            gpsModule.sleep();
+            // Put GPS into the cheapest state for this sleep
+            gpsPower.enter(gpsPower.choose(sleepMs));
             
             // Put display to sleep
             display.sleep();
             
-            // Wait for next cycle
-            delay(TX_INTERVAL_MS);
+            // Flash erases stall the CPU for ~85 ms each, which the GPS UARTE
+            // buffer only survives while the receiver is not streaming NMEA
+            if (gpsPower.getMode() != GPS_POWER_TRACKING) {
+                nvsStorage.maintain();
+            }
+            
+            // Replays wait out the duty cycle inside this sleep, with the
+            // GPS already parked; the next cycle still starts on time or
+            // at the next legal uplink, whichever is later
+            if (drainPending) {
+                drainPending = false;
+                uint32_t spentMs = drainQueue(sleepMs);
+                sleepMs = spentMs < sleepMs ? sleepMs - spentMs : 0;
+                legalMs = loraModule.msUntilNextUplink();
+                if (sleepMs < legalMs) {
+                    sleepMs = legalMs;
+                }
+            }
+            
+            #if POWER_LOG_STATS
+            power.logStats();
+            sleepService.logStats();
+            #endif
+            #if TASK_LOG_STATS
+            taskMonitor.logStats();
+            #endif
+            
+            // Long sleeps power down entirely; this only returns if it cannot
+            #if SYSTEM_OFF_ENABLED
+            if (sleepMs >= SYSTEM_OFF_MIN_MS) {
+                enterSystemOff(sleepMs);
+            }
+            #endif
+            power.sleepBegin();
+            
+            // Wait for next cycle, sampling pressure along the way
+            sleepFor(sleepMs);
+            power.sleepEnd();
             
             // Start new cycle
             currentState = STATE_GPS_WAIT;
             break;
+        }
             
         case STATE_ERROR:
             #if DEBUG_SERIAL
@@ -364,22 +617,122 @@ void handleState() {
     }
 }
 
-void enterDeepSleep(uint32_t seconds) {
-    // Note: This is a placeholder for deep sleep implementation
-    // The nRF52840 requires setting up RTC and using the Nordic SDK
-    // For now, we'll use a simple delay
+void sleepFor(uint32_t ms) {
+    // System ON sleep in slices: pressure samples on the RTC wake, the
+    // status screen on a button press, and any other wake just resumes
+    uint32_t sleepStart = millis();
+    while (millis() - sleepStart < ms) {
+        uint32_t remaining = ms - (millis() - sleepStart);
+        uint32_t slice = remaining;
+        #if MOTION_ENABLED
+        if (motion.isPresent() && slice > MOTION_SAMPLE_INTERVAL_MS) {
+            slice = MOTION_SAMPLE_INTERVAL_MS;
+        }
+        #endif
+        
+        WakeSource source = sleepService.sleep(slice);
+        
+        #if MOTION_ENABLED
+        if (source == WAKE_TIMER && motion.isPresent()) {
+            motion.sample();
+        }
+        #endif
+        if (source == WAKE_BUTTON) {
+            display.showStatus(lastValidGPSData, loraModule.getState(), cycleCount);
+            display.sleep();
+        }
+    }
+}
+
+bool enterSystemOff(uint32_t sleepMs) {
+    // Needs the PCF8563 to wake up, and a GPS that keeps its state without us
+    if (!extRtc.isPresent() || !loraModule.isJoined() || gpsPower.getMode() == GPS_POWER_TRACKING) {
+        return false;
+    }
     
-    #if DEBUG_SERIAL
-    Serial.println(F("[Sleep] Entering sleep mode..."));
-    Serial.flush();
-    #endif
+    // Keep the PCF8563 on UTC while the timebase knows it
+    uint32_t rtcNow = 0;
+    bool utcValid = false;
+    if (timebase.isValid()) {
+        rtcNow = timebase.nowUTC();
+        utcValid = extRtc.setTime(rtcNow);
+    }
+    if (!utcValid && !extRtc.readTime(rtcNow)) {
+        // Never set and no UTC yet: any start measures the time off
+        rtcNow = EXT_RTC_EPOCH;
+        if (!extRtc.setTime(rtcNow)) return false;
+    }
+    
+    // Only the checkpoint survives; batched NVS writes go out now
+    pipeline.waitForStorage(PIPELINE_STORAGE_WAIT_MS);
+    linkStats.flush();
+    constellations.flush();
+    
+    if (!extRtc.armWake(sleepMs / 1000)) return false;
+    checkpoint.save(cycleCount, lastValidGPSData, sleepMs, rtcNow, utcValid);
+    sleepService.systemOff();
+    return true;
+}
+
+bool resumeFromCheckpoint() {
+    const CheckpointData& cp = checkpoint.get();
+    
+    // INT still low means the PCF8563 woke us, otherwise it was the button
+    pinMode(RTC_INT_PIN, INPUT_PULLUP);
+    bool rtcWake = digitalRead(RTC_INT_PIN) == LOW;
+    
+    // Time powered down, from the only clock that kept running
+    uint32_t offMs = cp.sleepMs;
+    uint32_t rtcNow;
+    if (extRtc.readTime(rtcNow) && rtcNow >= cp.rtcAtSleep) {
+        uint32_t offS = rtcNow - cp.rtcAtSleep;
+        offMs = offS * 1000;
+        if (cp.utcValid) {
+            timebase.setUTC(rtcNow, 1000 + offS * TIMEBASE_CRYSTAL_PPM / 1000);
+        }
+    }
+    extRtc.clearWake();
     
-    // Simple delay instead of deep sleep (for compatibility)
-    delay(seconds * 1000);
+    if (!loraModule.resume(cp.lora, offMs)) {
+        return false;
+    }
+    gpsPower.restore(cp.gpsPower, offMs);
+    adaptiveInterval.restore(cp.interval);
+    cycleCount = cp.cycleCount;
+    lastValidGPSData = cp.lastFix;
+    
+    // The panel kept the last screen; no startup refresh
+    if (DISPLAY_ENABLED) {
+        display.begin();
+    }
     
     #if DEBUG_SERIAL
-    Serial.println(F("[Sleep] Waking up..."));
+    Serial.print(F("[Main] ✓ Resumed cycle "));
+    Serial.print(cycleCount);
+    Serial.print(F(" after "));
+    Serial.print(offMs / 1000);
+    Serial.print(F(" s off ("));
+    Serial.print(rtcWake ? F("RTC") : F("button"));
+    Serial.println(F(")"));
     #endif
+    
+    // The timer wakes up to a minute early, the button any time
+    if (offMs < cp.sleepMs) {
+        uint32_t remaining = cp.sleepMs - offMs;
+        if (!rtcWake) {
+            display.showStatus(lastValidGPSData, loraModule.getState(), cycleCount);
+            display.sleep();
+        }
+        #if SYSTEM_OFF_ENABLED
+        if (remaining >= SYSTEM_OFF_MIN_MS) {
+            enterSystemOff(remaining);
+        }
+        #endif
+        sleepFor(remaining);
+    }
+    
+    currentState = STATE_GPS_WAIT;
+    return true;
 }
 
 void blinkLED(uint8_t count) {
@@ -390,3 +743,72 @@ void blinkLED(uint8_t count) {
         delay(100);
     }
 }
+
+void onUplinkComplete(const UplinkResult& result) {
+    // Runs in the LoRa task; the state machine picks this up after waitForUplink()
+    lastUplink = result;
+}
+
+uint32_t drainQueue(uint32_t budgetMs) {
+    #if FLASH_QUEUE_ENABLED
+    // Replay frame: records of UTC (4 bytes) + TTNMapper payload, confirmed,
+    // and only marked delivered once the network acknowledges it.
+    // Sleeps through the duty-cycle wait before each replay as long as that
+    // fits the budget; returns the time spent.
+    const uint8_t recordLen = 4 + TTNMAPPER_PAYLOAD_SIZE;
+    uint32_t start = millis();
+    
+    // Fixes from earlier failures may still be on their way to the flash
+    if (!pipeline.waitForStorage(PIPELINE_STORAGE_WAIT_MS)) return millis() - start;
+    
+    for (uint8_t n = 0; n < FLASH_QUEUE_DRAIN_UPLINKS && flashQueue.getPending() > 0; n++) {
+        uint32_t spentMs = millis() - start;
+        uint32_t waitMs = loraModule.msUntilNextUplink();
+        if (spentMs >= budgetMs || waitMs >= budgetMs - spentMs) break;
+        
+        uint8_t maxRecords = loraModule.getMaxPayloadLen() / recordLen;
+        if (maxRecords == 0) break;
+        
+        FlashQueueRecord records[FLASH_QUEUE_PEEK_MAX];
+        uint8_t count = flashQueue.peek(records, maxRecords);
+        if (count == 0) break;
+        
+        uint8_t frame[FLASH_QUEUE_PEEK_MAX * (4 + TTNMAPPER_PAYLOAD_SIZE)];
+        uint8_t len = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            frame[len++] = (records[i].utc >> 24) & 0xFF;
+            frame[len++] = (records[i].utc >> 16) & 0xFF;
+            frame[len++] = (records[i].utc >> 8) & 0xFF;
+            frame[len++] = records[i].utc & 0xFF;
+            memcpy(&frame[len], records[i].payload, TTNMAPPER_PAYLOAD_SIZE);
+            len += TTNMAPPER_PAYLOAD_SIZE;
+        }
+        
+        // Each confirmed replay makes the network send a downlink
+        if (!loraModule.reserveConfirmed(FLASH_QUEUE_CONFIRMED_PER_DAY)) break;
+        
+        if (waitMs > 0) {
+            power.sleepBegin();
+            sleepFor(waitMs);
+            power.sleepEnd();
+        }
+        
+        #if DEBUG_SERIAL
+        Serial.print(F("[Queue] Replaying "));
+        Serial.print(count);
+        Serial.print(F(" of "));
+        Serial.print(flashQueue.getPending());
+        Serial.println(F(" stored fixes"));
+        #endif
+        
+        if (!loraModule.sendUplink(frame, len, FLASH_QUEUE_PORT, true) || !loraModule.wasAcknowledged()) {
+            break;  // Still pending; at-least-once, so retry next cycle
+        }
+        flashQueue.markDelivered(count);
+    }
+    return millis() - start;
+    #else
+    (void)budgetMs;
+    return 0;
+    #endif
+}
@@ -0,0 +1,181 @@
+#include "motion.h"
+#include <Wire.h>
+#include "../include/pins.h"
+#include "../include/config.h"
+
+MotionDetector motion;
+
+// BMP280 registers
+#define BMP280_REG_CALIB        0x88
+#define BMP280_REG_ID           0xD0
+#define BMP280_REG_STATUS       0xF3
+#define BMP280_REG_CTRL_MEAS    0xF4
+#define BMP280_REG_CONFIG       0xF5
+#define BMP280_REG_DATA         0xF7
+#define BMP280_CHIP_ID          0x58
+
+// Forced mode, temperature x1, pressure x4 (~13 ms, ~2.5 Pa noise)
+#define BMP280_CTRL_FORCED      ((1 << 5) | (3 << 2) | 1)
+
+MotionDetector::MotionDetector()
+    : present(false),
+      address(0),
+      lastPa(0),
+      lastTemp(0),
+      baseline(0),
+      hasBaseline(false),
+      quietSamples(0) {
+}
+
+bool MotionDetector::begin() {
+    // The variant's default Wire pins are not the T-Echo sensor bus
+    Wire.setPins(I2C_SDA, I2C_SCL);
+    Wire.begin();
+    
+    static const uint8_t candidates[] = { 0x77, 0x76 };
+    for (uint8_t i = 0; i < sizeof(candidates); i++) {
+        address = candidates[i];
+        uint8_t id = 0;
+        if (readRegisters(BMP280_REG_ID, &id, 1) && id == BMP280_CHIP_ID) {
+            present = true;
+            break;
+        }
+    }
+    
+    if (!present) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[Motion] BMP280 not found"));
+        #endif
+        return false;
+    }
+    
+    uint8_t c[24];
+    if (!readRegisters(BMP280_REG_CALIB, c, sizeof(c))) {
+        present = false;
+        return false;
+    }
+    digT1 = (uint16_t)(c[1] << 8 | c[0]);
+    digT2 = (int16_t)(c[3] << 8 | c[2]);
+    digT3 = (int16_t)(c[5] << 8 | c[4]);
+    digP1 = (uint16_t)(c[7] << 8 | c[6]);
+    digP2 = (int16_t)(c[9] << 8 | c[8]);
+    digP3 = (int16_t)(c[11] << 8 | c[10]);
+    digP4 = (int16_t)(c[13] << 8 | c[12]);
+    digP5 = (int16_t)(c[15] << 8 | c[14]);
+    digP6 = (int16_t)(c[17] << 8 | c[16]);
+    digP7 = (int16_t)(c[19] << 8 | c[18]);
+    digP8 = (int16_t)(c[21] << 8 | c[20]);
+    digP9 = (int16_t)(c[23] << 8 | c[22]);
+    
+    // No IIR filter: the classifier does its own smoothing
+    writeRegister(BMP280_REG_CONFIG, 0x00);
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Motion] BMP280 found at 0x"));
+    Serial.println(address, HEX);
+    #endif
+    
+    return true;
+}
+
+bool MotionDetector::readRegisters(uint8_t reg, uint8_t* buf, uint8_t len) {
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0) return false;
+    
+    if (Wire.requestFrom(address, len) != len) return false;
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = Wire.read();
+    }
+    return true;
+}
+
+bool MotionDetector::writeRegister(uint8_t reg, uint8_t value) {
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+}
+
+uint32_t MotionDetector::compensatePressure(int32_t adcP, int32_t adcT) {
+    // Bosch BMP280 datasheet, 32-bit integer compensation
+    int32_t var1 = ((((adcT >> 3) - ((int32_t)digT1 << 1))) * ((int32_t)digT2)) >> 11;
+    int32_t var2 = (((((adcT >> 4) - ((int32_t)digT1)) * ((adcT >> 4) - ((int32_t)digT1))) >> 12) *
+                    ((int32_t)digT3)) >> 14;
+    int32_t tFine = var1 + var2;
+    lastTemp = (int16_t)((tFine * 5 + 128) >> 8);
+    
+    var1 = (tFine >> 1) - (int32_t)64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)digP6);
+    var2 = var2 + ((var1 * ((int32_t)digP5)) << 1);
+    var2 = (var2 >> 2) + (((int32_t)digP4) << 16);
+    var1 = (((digP3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)digP2) * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * ((int32_t)digP1)) >> 15);
+    if (var1 == 0) return 0;
+    
+    uint32_t p = (((uint32_t)(((int32_t)1048576) - adcP) - (var2 >> 12))) * 3125;
+    if (p < 0x80000000) {
+        p = (p << 1) / ((uint32_t)var1);
+    } else {
+        p = (p / (uint32_t)var1) * 2;
+    }
+    var1 = (((int32_t)digP9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t)(p >> 2)) * ((int32_t)digP8)) >> 13;
+    return (uint32_t)((int32_t)p + ((var1 + var2 + digP7) >> 4));
+}
+
+bool MotionDetector::sample() {
+    if (!present) return false;
+    
+    if (!writeRegister(BMP280_REG_CTRL_MEAS, BMP280_CTRL_FORCED)) return false;
+    
+    // Conversion takes ~13 ms; the sensor returns to sleep by itself
+    uint8_t status = 0;
+    uint32_t start = millis();
+    do {
+        delay(5);
+        if (!readRegisters(BMP280_REG_STATUS, &status, 1)) return false;
+    } while ((status & 0x08) && millis() - start < 50);
+    
+    uint8_t d[6];
+    if (!readRegisters(BMP280_REG_DATA, d, sizeof(d))) return false;
+    int32_t adcP = ((int32_t)d[0] << 12) | ((int32_t)d[1] << 4) | (d[2] >> 4);
+    int32_t adcT = ((int32_t)d[3] << 12) | ((int32_t)d[4] << 4) | (d[5] >> 4);
+    
+    uint32_t pa = compensatePressure(adcP, adcT);
+    if (pa == 0) return false;
+    lastPa = (int32_t)pa;
+    
+    if (!hasBaseline) {
+        baseline = lastPa * 16;
+        hasBaseline = true;
+        return true;
+    }
+    
+    int32_t delta = lastPa - baseline / 16;
+    if (abs(delta) > MOTION_THRESHOLD_PA) {
+        // Step change: re-anchor and start counting quiet samples again
+        baseline = lastPa * 16;
+        quietSamples = 0;
+        
+        #if DEBUG_SERIAL
+        Serial.print(F("[Motion] Pressure step "));
+        Serial.print(delta);
+        Serial.println(F(" Pa - moving"));
+        #endif
+    } else {
+        // Follow slow weather drift (1/8 per sample)
+        baseline += (lastPa * 16 - baseline) / 8;
+        if (quietSamples < 0xFFFF) quietSamples++;
+    }
+    
+    return true;
+}
+
+bool MotionDetector::isStationary() {
+    return present && quietSamples >= MOTION_STATIONARY_SAMPLES;
+}
+
+void MotionDetector::markMoving() {
+    quietSamples = 0;
+}
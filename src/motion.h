@@ -0,0 +1,54 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <Arduino.h>
+
+// Stationary/moving classifier on the on-board BMP280.
+// A forced-mode pressure reading is taken from the sleep state every
+// MOTION_SAMPLE_INTERVAL_MS. Any step larger than MOTION_THRESHOLD_PA from
+// a slowly tracking baseline (~1 m of elevation) counts as movement; the
+// baseline follows weather drift between steps. Horizontal movement on flat
+// ground does not show up, which MOTION_MAX_SKIPPED bounds.
+class MotionDetector {
+public:
+    MotionDetector();
+    
+    // Initialization (probes 0x76/0x77)
+    bool begin();
+    bool isPresent() { return present; }
+    
+    // Take one reading and update the classifier
+    bool sample();
+    
+    // Classification
+    bool isStationary();
+    void markMoving();
+    
+    int32_t getLastPressure() { return lastPa; }
+    int16_t getLastTemperature() { return lastTemp; }
+
+private:
+    bool present;
+    uint8_t address;
+    
+    // Factory calibration
+    uint16_t digT1;
+    int16_t digT2, digT3;
+    uint16_t digP1;
+    int16_t digP2, digP3, digP4, digP5, digP6, digP7, digP8, digP9;
+    
+    int32_t lastPa;             // Pa
+    int16_t lastTemp;           // 0.01 degC
+    int32_t baseline;           // Pa * 16
+    bool hasBaseline;
+    uint16_t quietSamples;
+    
+    bool readRegisters(uint8_t reg, uint8_t* buf, uint8_t len);
+    bool writeRegister(uint8_t reg, uint8_t value);
+    uint32_t compensatePressure(int32_t adcP, int32_t adcT);
+};
+
+// Global motion detector instance
+extern MotionDetector motion;
+
+#endif // MOTION_H
@@ -0,0 +1,355 @@
+#include "nmea.h"
+#include <string.h>
+
+// Bits in stagedFields for fields present in the sentence being parsed
+#define FIELD_TIME      (1 << 0)
+#define FIELD_LAT       (1 << 1)
+#define FIELD_LON       (1 << 2)
+#define FIELD_QUALITY   (1 << 3)
+#define FIELD_SATS      (1 << 4)
+#define FIELD_HDOP      (1 << 5)
+#define FIELD_ALT       (1 << 6)
+#define FIELD_ACTIVE    (1 << 7)    // RMC status 'A'
+#define FIELD_SPEED     (1 << 8)
+#define FIELD_COURSE    (1 << 9)
+#define FIELD_DATE      (1 << 10)
+
+// Fraction digits kept per field (enough for 1e-5 arc-minutes)
+#define MAX_FRAC_DIGITS 5
+
+static const uint32_t POW10[] = { 1, 10, 100, 1000, 10000, 100000 };
+
+NMEAParser::NMEAParser()
+    : state(STATE_IDLE),
+      type(SENTENCE_NONE),
+      lastType(SENTENCE_NONE),
+      lastLocation(false),
+      headerLen(0),
+      checksum(0),
+      received(0),
+      checksumDigits(0),
+      fieldIndex(0),
+      stagedFields(0) {
+    memset(&counters, 0, sizeof(counters));
+    reset();
+    beginField();
+}
+
+void NMEAParser::reset() {
+    memset(&current, 0, sizeof(current));
+    memset(&staged, 0, sizeof(staged));
+    lastType = SENTENCE_NONE;
+    lastLocation = false;
+}
+
+int8_t NMEAParser::hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool NMEAParser::encode(char c) {
+    counters.chars++;
+    
+    if (c == '$') {
+        state = STATE_HEADER;
+        headerLen = 0;
+        checksum = 0;
+        return false;
+    }
+    
+    switch (state) {
+        case STATE_IDLE:
+        case STATE_SKIP:
+            return false;
+            
+        case STATE_HEADER:
+            checksum ^= c;
+            header[headerLen++] = c;
+            if (headerLen < sizeof(header)) {
+                return false;
+            }
+            
+            // Talker ID (GP, GL, GN, BD, ...) is ignored; sentence ID decides
+            if (header[2] == 'G' && header[3] == 'G' && header[4] == 'A') {
+                type = SENTENCE_GGA;
+            } else if (header[2] == 'R' && header[3] == 'M' && header[4] == 'C') {
+                type = SENTENCE_RMC;
+            } else {
+                counters.filtered++;
+                state = STATE_SKIP;
+                return false;
+            }
+            
+            state = STATE_FIELDS;
+            fieldIndex = 0;
+            stagedFields = 0;
+            beginField();
+            return false;
+            
+        case STATE_FIELDS:
+            if (c == '*') {
+                endField();
+                state = STATE_CHECKSUM;
+                received = 0;
+                checksumDigits = 0;
+                return false;
+            }
+            if (c == '\r' || c == '\n') {
+                // Line ended without a checksum
+                counters.failed++;
+                state = STATE_IDLE;
+                return false;
+            }
+            
+            checksum ^= c;
+            
+            if (c == ',') {
+                endField();
+                fieldIndex++;
+                beginField();
+            } else if (c >= '0' && c <= '9') {
+                uint8_t digit = c - '0';
+                if (fieldDot) {
+                    if (fieldFracDigits < MAX_FRAC_DIGITS) {
+                        fieldFrac = fieldFrac * 10 + digit;
+                        fieldFracDigits++;
+                    }
+                } else if (fieldWhole < 100000000UL) {
+                    fieldWhole = fieldWhole * 10 + digit;
+                }
+                fieldEmpty = false;
+            } else if (c == '.') {
+                fieldDot = true;
+            } else if (c == '-') {
+                fieldNeg = true;
+            } else {
+                if (fieldChar == 0) fieldChar = c;
+                fieldEmpty = false;
+            }
+            return false;
+            
+        case STATE_CHECKSUM: {
+            int8_t value = hexValue(c);
+            if (value < 0) {
+                counters.failed++;
+                state = STATE_IDLE;
+                return false;
+            }
+            received = (received << 4) | value;
+            if (++checksumDigits < 2) {
+                return false;
+            }
+            
+            state = STATE_IDLE;
+            if (received != checksum) {
+                counters.failed++;
+                return false;
+            }
+            counters.passed++;
+            return commit();
+        }
+    }
+    
+    return false;
+}
+
+void NMEAParser::beginField() {
+    fieldWhole = 0;
+    fieldFrac = 0;
+    fieldFracDigits = 0;
+    fieldDot = false;
+    fieldEmpty = true;
+    fieldNeg = false;
+    fieldChar = 0;
+}
+
+uint32_t NMEAParser::fixed(uint8_t digits) const {
+    // whole.frac scaled by 10^digits, extra fraction digits truncated
+    uint32_t frac = fieldFrac;
+    if (fieldFracDigits > digits) {
+        frac /= POW10[fieldFracDigits - digits];
+    } else {
+        frac *= POW10[digits - fieldFracDigits];
+    }
+    return fieldWhole * POW10[digits] + frac;
+}
+
+int32_t NMEAParser::coordinate() const {
+    // (d)ddmm.mmmmm -> degrees * 1e7
+    uint32_t degrees = fieldWhole / 100;
+    uint32_t minutesE5 = (fieldWhole % 100) * 100000UL + (fixed(MAX_FRAC_DIGITS) % 100000UL);
+    return (int32_t)(degrees * 10000000UL + (minutesE5 * 10UL + 3) / 6);
+}
+
+void NMEAParser::endField() {
+    if (fieldIndex == 0) return;
+    
+    if (type == SENTENCE_GGA) {
+        endGGAField();
+    } else {
+        endRMCField();
+    }
+}
+
+void NMEAParser::endGGAField() {
+    // $xxGGA,time,lat,N,lon,E,quality,sats,hdop,alt,M,...
+    switch (fieldIndex) {
+        case 1:
+            if (!fieldEmpty) {
+                staged.time = fieldWhole * 100 + fixed(2) % 100;
+                stagedFields |= FIELD_TIME;
+            }
+            break;
+        case 2:
+            if (!fieldEmpty) {
+                staged.latitude = coordinate();
+                stagedFields |= FIELD_LAT;
+            }
+            break;
+        case 3:
+            if (fieldChar == 'S') staged.latitude = -staged.latitude;
+            break;
+        case 4:
+            if (!fieldEmpty) {
+                staged.longitude = coordinate();
+                stagedFields |= FIELD_LON;
+            }
+            break;
+        case 5:
+            if (fieldChar == 'W') staged.longitude = -staged.longitude;
+            break;
+        case 6:
+            if (!fieldEmpty) {
+                staged.quality = (uint8_t)fieldWhole;
+                stagedFields |= FIELD_QUALITY;
+            }
+            break;
+        case 7:
+            if (!fieldEmpty) {
+                staged.satellites = (uint8_t)fieldWhole;
+                stagedFields |= FIELD_SATS;
+            }
+            break;
+        case 8:
+            if (!fieldEmpty) {
+                uint32_t hdop = fixed(2);
+                staged.hdop = hdop > 0xFFFF ? 0xFFFF : (uint16_t)hdop;
+                stagedFields |= FIELD_HDOP;
+            }
+            break;
+        case 9:
+            if (!fieldEmpty) {
+                int32_t cm = (int32_t)fixed(2);
+                staged.altitude = fieldNeg ? -cm : cm;
+                stagedFields |= FIELD_ALT;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void NMEAParser::endRMCField() {
+    // $xxRMC,time,status,lat,N,lon,E,speed,course,date,...
+    switch (fieldIndex) {
+        case 1:
+            if (!fieldEmpty) {
+                staged.time = fieldWhole * 100 + fixed(2) % 100;
+                stagedFields |= FIELD_TIME;
+            }
+            break;
+        case 2:
+            if (fieldChar == 'A') stagedFields |= FIELD_ACTIVE;
+            break;
+        case 3:
+            if (!fieldEmpty) {
+                staged.latitude = coordinate();
+                stagedFields |= FIELD_LAT;
+            }
+            break;
+        case 4:
+            if (fieldChar == 'S') staged.latitude = -staged.latitude;
+            break;
+        case 5:
+            if (!fieldEmpty) {
+                staged.longitude = coordinate();
+                stagedFields |= FIELD_LON;
+            }
+            break;
+        case 6:
+            if (fieldChar == 'W') staged.longitude = -staged.longitude;
+            break;
+        case 7:
+            if (!fieldEmpty) {
+                uint32_t speed = fixed(2);
+                staged.speed = speed > 0xFFFF ? 0xFFFF : (uint16_t)speed;
+                stagedFields |= FIELD_SPEED;
+            }
+            break;
+        case 8:
+            if (!fieldEmpty) {
+                staged.course = (uint16_t)fixed(2);
+                stagedFields |= FIELD_COURSE;
+            }
+            break;
+        case 9:
+            if (!fieldEmpty) {
+                staged.date = fieldWhole;
+                stagedFields |= FIELD_DATE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool NMEAParser::commit() {
+    bool hasPosition = (stagedFields & FIELD_LAT) && (stagedFields & FIELD_LON);
+    bool fix;
+    
+    if (type == SENTENCE_GGA) {
+        fix = hasPosition && (stagedFields & FIELD_QUALITY) && staged.quality > 0;
+        current.quality = (stagedFields & FIELD_QUALITY) ? staged.quality : 0;
+        if (stagedFields & FIELD_SATS) {
+            current.satellites = staged.satellites;
+        }
+        if (stagedFields & FIELD_HDOP) {
+            current.hdop = staged.hdop;
+            current.hdopValid = true;
+        }
+        if (fix && (stagedFields & FIELD_ALT)) {
+            current.altitude = staged.altitude;
+            current.altitudeValid = true;
+        }
+    } else {
+        fix = hasPosition && (stagedFields & FIELD_ACTIVE);
+        if (fix && (stagedFields & FIELD_SPEED)) {
+            current.speed = staged.speed;
+            current.speedValid = true;
+        }
+        if (fix && (stagedFields & FIELD_COURSE)) {
+            current.course = staged.course;
+        }
+        if (stagedFields & FIELD_DATE) {
+            current.date = staged.date;
+            current.dateValid = true;
+        }
+    }
+    
+    if (stagedFields & FIELD_TIME) {
+        current.time = staged.time;
+        current.timeValid = true;
+    }
+    
+    if (fix) {
+        current.latitude = staged.latitude;
+        current.longitude = staged.longitude;
+        current.locationValid = true;
+    }
+    
+    lastType = type;
+    lastLocation = fix;
+    return true;
+}
@@ -0,0 +1,111 @@
+#ifndef NMEA_H
+#define NMEA_H
+
+#include <stdint.h>
+
+// Zero-allocation NMEA parser for the two sentences the tracker consumes.
+// Sentences other than GGA/RMC (any talker ID) are rejected as soon as the
+// six-byte "$TTSSS" header is complete; the checksum is accumulated while
+// bytes stream in and fields are converted straight to fixed-point integers,
+// so no line buffer and no floating point are needed per byte.
+
+// Fixed-point navigation solution (committed only from checksum-valid sentences)
+struct NMEAFix {
+    int32_t latitude;       // Degrees * 1e7
+    int32_t longitude;      // Degrees * 1e7
+    int32_t altitude;       // Centimetres above MSL (GGA)
+    uint16_t hdop;          // HDOP * 100 (GGA)
+    uint16_t speed;         // Knots * 100 (RMC)
+    uint16_t course;        // Degrees * 100 (RMC)
+    uint8_t satellites;     // Satellites used (GGA)
+    uint8_t quality;        // GGA fix quality (0 = no fix)
+    uint32_t time;          // UTC hhmmsscc
+    uint32_t date;          // UTC ddmmyy (RMC)
+    
+    bool locationValid;
+    bool altitudeValid;
+    bool hdopValid;
+    bool timeValid;
+    bool dateValid;
+    bool speedValid;
+};
+
+// Parser counters
+struct NMEAStats {
+    uint32_t chars;             // Bytes fed to encode()
+    uint32_t passed;            // GGA/RMC sentences with a valid checksum
+    uint32_t failed;            // GGA/RMC sentences with a bad checksum
+    uint32_t filtered;          // Sentences rejected by header
+};
+
+class NMEAParser {
+public:
+    NMEAParser();
+    
+    // Feed one byte; returns true when a GGA or RMC sentence was committed
+    bool encode(char c);
+    
+    // Clear the current solution (counters are kept)
+    void reset();
+    
+    const NMEAFix& fix() const { return current; }
+    const NMEAStats& stats() const { return counters; }
+    
+    // Type of the last committed sentence
+    enum SentenceType : uint8_t {
+        SENTENCE_NONE,
+        SENTENCE_GGA,
+        SENTENCE_RMC
+    };
+    SentenceType lastSentence() const { return lastType; }
+    
+    // True if the last committed sentence carried a valid position
+    bool lastHadLocation() const { return lastLocation; }
+
+private:
+    enum State : uint8_t {
+        STATE_IDLE,         // Waiting for '$'
+        STATE_HEADER,       // Collecting talker + sentence ID
+        STATE_FIELDS,       // Inside a wanted sentence
+        STATE_CHECKSUM,     // Collecting the two hex digits after '*'
+        STATE_SKIP          // Unwanted sentence, wait for next '$'
+    };
+    
+    State state;
+    SentenceType type;
+    SentenceType lastType;
+    bool lastLocation;
+    uint8_t headerLen;
+    char header[5];
+    uint8_t checksum;
+    uint8_t received;
+    uint8_t checksumDigits;
+    uint8_t fieldIndex;
+    
+    // Current field accumulator
+    uint32_t fieldWhole;
+    uint32_t fieldFrac;
+    uint8_t fieldFracDigits;
+    bool fieldDot;
+    bool fieldEmpty;
+    bool fieldNeg;
+    char fieldChar;
+    
+    // Values staged from the sentence being parsed
+    NMEAFix staged;
+    uint16_t stagedFields;
+    
+    NMEAFix current;
+    NMEAStats counters;
+    
+    void beginField();
+    void endField();
+    void endGGAField();
+    void endRMCField();
+    bool commit();
+    uint32_t fixed(uint8_t digits) const;
+    int32_t coordinate() const;
+    static int8_t hexValue(char c);
+};
+
+#endif // NMEA_H
@@ -1,7 +1,12 @@
 #include "nvs.h"
 #include "../include/config.h"
 
+#if NVS_MIGRATE_LITTLEFS
+#include <Adafruit_LittleFS.h>
+#include <InternalFileSystem.h>
+
 using namespace Adafruit_LittleFS_Namespace;
+#endif
 
 NVSStorage nvsStorage;
 
@@ -9,145 +14,190 @@ NVSStorage::NVSStorage() : initialized(false) {
 }
 
 bool NVSStorage::begin() {
-    // Initialize Internal File System
-    if (!InternalFS.begin()) {
-        #if DEBUG_SERIAL
-        Serial.println(F("[NVS] Failed to initialize InternalFS"));
-        #endif
-        return false;
+    // No valid bank: first boot, or first boot after the LittleFS layout
+    if (!kvStore.begin()) {
+        migrate();
     }
     
-    initialized = true;
+    initialized = kvStore.isReady();
     
     #if DEBUG_SERIAL
-    Serial.println(F("[NVS] InternalFS initialized"));
+    if (initialized) {
+        Serial.println(F("[NVS] KV store ready"));
+    } else {
+        Serial.println(F("[NVS] Failed to initialize KV store"));
+    }
     #endif
     
-    return true;
+    return initialized;
 }
 
-bool NVSStorage::saveNonces(const uint8_t* buffer, size_t size) {
-    if (!initialized) return false;
+void NVSStorage::migrate() {
+    // Staged in RAM, so the files can be read before the pages are erased
+    kvStore.beginBatch();
+    
+    #if NVS_MIGRATE_LITTLEFS
+    if (InternalFS.begin()) {
+        migrateFile(NONCES_FILE, NVS_KEY_NONCES);
+        migrateFile(SESSION_FILE, NVS_KEY_SESSION);
+        migrateFile(LASTFIX_FILE, NVS_KEY_LASTFIX);
+        migrateFile(CONSTELLATION_FILE, NVS_KEY_CONSTELLATIONS);
+        migrateFile(JOIN_FILE, NVS_KEY_JOIN);
+        InternalFS.end();
+    }
+    #endif
     
+    kvStore.format();
+    kvStore.commitBatch();
+}
+
+void NVSStorage::migrateFile(const char* path, NVSKey key) {
+    #if NVS_MIGRATE_LITTLEFS
     File file(InternalFS);
-    if (!file.open(NONCES_FILE, FILE_O_WRITE)) {
+    if (!file.open(path, FILE_O_READ)) return;
+    
+    uint8_t buffer[KV_BATCH_BYTES / 2];
+    size_t size = file.size();
+    if (size > 0 && size <= sizeof(buffer) && file.read(buffer, size) == size) {
+        kvStore.put(key, buffer, size);
+        
         #if DEBUG_SERIAL
-        Serial.println(F("[NVS] Failed to open nonces file for writing"));
+        Serial.print(F("[NVS] Migrated "));
+        Serial.print(path);
+        Serial.print(F(" ("));
+        Serial.print(size);
+        Serial.println(F(" bytes)"));
         #endif
-        return false;
     }
-    
-    // Truncate and write
-    file.seek(0);
-    size_t written = file.write(buffer, size);
     file.close();
-    
-    #if DEBUG_SERIAL
-    Serial.print(F("[NVS] Saved "));
-    Serial.print(written);
-    Serial.println(F(" bytes of nonces"));
     #endif
-    
-    return written == size;
 }
 
-bool NVSStorage::loadNonces(uint8_t* buffer, size_t size) {
+bool NVSStorage::save(NVSKey key, const void* data, size_t size, const __FlashStringHelper* what) {
     if (!initialized) return false;
     
-    File file(InternalFS);
-    if (!file.open(NONCES_FILE, FILE_O_READ)) {
-        #if DEBUG_SERIAL
-        Serial.println(F("[NVS] No nonces file found"));
-        #endif
-        return false;
-    }
-    
-    size_t read = file.read(buffer, size);
-    file.close();
+    bool ok = kvStore.put(key, data, size);
     
     #if DEBUG_SERIAL
-    Serial.print(F("[NVS] Loaded "));
-    Serial.print(read);
-    Serial.println(F(" bytes of nonces"));
+    if (what) {
+        Serial.print(ok ? F("[NVS] Saved ") : F("[NVS] Failed to save "));
+        Serial.print(size);
+        Serial.print(F(" bytes of "));
+        Serial.println(what);
+    }
     #endif
     
-    return read == size;
+    return ok;
 }
 
-bool NVSStorage::hasNonces() {
+bool NVSStorage::load(NVSKey key, void* data, size_t size) {
     if (!initialized) return false;
-    
-    File file(InternalFS);
-    bool exists = file.open(NONCES_FILE, FILE_O_READ);
-    if (exists) {
-        file.close();
-    }
-    return exists;
+    return kvStore.get(key, data, size);
 }
 
-bool NVSStorage::saveSession(const uint8_t* buffer, size_t size) {
-    if (!initialized) return false;
-    
-    File file(InternalFS);
-    if (!file.open(SESSION_FILE, FILE_O_WRITE)) {
-        #if DEBUG_SERIAL
-        Serial.println(F("[NVS] Failed to open session file for writing"));
-        #endif
-        return false;
-    }
-    
-    file.seek(0);
-    size_t written = file.write(buffer, size);
-    file.close();
+bool NVSStorage::saveNonces(const uint8_t* buffer, size_t size) {
+    return save(NVS_KEY_NONCES, buffer, size, F("nonces"));
+}
+
+bool NVSStorage::loadNonces(uint8_t* buffer, size_t size) {
+    bool ok = load(NVS_KEY_NONCES, buffer, size);
     
     #if DEBUG_SERIAL
-    Serial.print(F("[NVS] Saved "));
-    Serial.print(written);
-    Serial.println(F(" bytes of session"));
+    if (ok) {
+        Serial.print(F("[NVS] Loaded "));
+        Serial.print(size);
+        Serial.println(F(" bytes of nonces"));
+    } else {
+        Serial.println(F("[NVS] No nonces stored"));
+    }
     #endif
     
-    return written == size;
+    return ok;
+}
+
+bool NVSStorage::hasNonces() {
+    return initialized && kvStore.has(NVS_KEY_NONCES);
+}
+
+bool NVSStorage::saveSession(const uint8_t* buffer, size_t size) {
+    return save(NVS_KEY_SESSION, buffer, size, F("session"));
 }
 
 bool NVSStorage::loadSession(uint8_t* buffer, size_t size) {
-    if (!initialized) return false;
-    
-    File file(InternalFS);
-    if (!file.open(SESSION_FILE, FILE_O_READ)) {
-        #if DEBUG_SERIAL
-        Serial.println(F("[NVS] No session file found"));
-        #endif
-        return false;
-    }
-    
-    size_t read = file.read(buffer, size);
-    file.close();
+    bool ok = load(NVS_KEY_SESSION, buffer, size);
     
     #if DEBUG_SERIAL
-    Serial.print(F("[NVS] Loaded "));
-    Serial.print(read);
-    Serial.println(F(" bytes of session"));
+    if (ok) {
+        Serial.print(F("[NVS] Loaded "));
+        Serial.print(size);
+        Serial.println(F(" bytes of session"));
+    } else {
+        Serial.println(F("[NVS] No session stored"));
+    }
     #endif
     
-    return read == size;
+    return ok;
 }
 
 bool NVSStorage::hasSession() {
-    if (!initialized) return false;
+    return initialized && kvStore.has(NVS_KEY_SESSION);
+}
+
+void NVSStorage::clearSession() {
+    if (!initialized) return;
     
-    File file(InternalFS);
-    bool exists = file.open(SESSION_FILE, FILE_O_READ);
-    if (exists) {
-        file.close();
-    }
-    return exists;
+    // Nonces stay: DevNonce must never be reused on the next join
+    kvStore.remove(NVS_KEY_SESSION);
+    
+    #if DEBUG_SERIAL
+    Serial.println(F("[NVS] Cleared session"));
+    #endif
+}
+
+bool NVSStorage::saveLastFix(const GPSFixRecord& record) {
+    return save(NVS_KEY_LASTFIX, &record, sizeof(record), F("last fix"));
+}
+
+bool NVSStorage::loadLastFix(GPSFixRecord& record) {
+    return load(NVS_KEY_LASTFIX, &record, sizeof(record));
+}
+
+bool NVSStorage::saveConstellations(const ConstellationRecord& record) {
+    return save(NVS_KEY_CONSTELLATIONS, &record, sizeof(record), nullptr);
+}
+
+bool NVSStorage::loadConstellations(ConstellationRecord& record) {
+    return load(NVS_KEY_CONSTELLATIONS, &record, sizeof(record));
+}
+
+bool NVSStorage::saveJoinState(const JoinRecord& record) {
+    return save(NVS_KEY_JOIN, &record, sizeof(record), nullptr);
+}
+
+bool NVSStorage::loadJoinState(JoinRecord& record) {
+    return load(NVS_KEY_JOIN, &record, sizeof(record));
+}
+
+bool NVSStorage::saveLinkStats(const LinkStatsRecord& record) {
+    return save(NVS_KEY_LINKSTATS, &record, sizeof(record), nullptr);
+}
+
+bool NVSStorage::loadLinkStats(LinkStatsRecord& record) {
+    return load(NVS_KEY_LINKSTATS, &record, sizeof(record));
+}
+
+void NVSStorage::clearJoinState() {
+    if (!initialized) return;
+    kvStore.remove(NVS_KEY_JOIN);
 }
 
 void NVSStorage::clearAll() {
     if (!initialized) return;
     
-    InternalFS.remove(NONCES_FILE);
-    InternalFS.remove(SESSION_FILE);
+    kvStore.beginBatch();
+    kvStore.remove(NVS_KEY_NONCES);
+    kvStore.remove(NVS_KEY_SESSION);
+    kvStore.commitBatch();
     
     #if DEBUG_SERIAL
     Serial.println(F("[NVS] Cleared all stored data"));
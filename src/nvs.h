@@ -2,20 +2,98 @@
 #define NVS_H
 
 #include <Arduino.h>
-#include <Adafruit_LittleFS.h>
-#include <InternalFileSystem.h>
+#include "kv_store.h"
 
 // LoRaWAN nonces buffer size from RadioLib
 #define LORAWAN_NONCES_SIZE  16
 #define LORAWAN_SESSION_SIZE 256
 
+// Last good GPS fix, used for time/position aiding on wakeup
+struct GPSFixRecord {
+    int32_t latitude;       // Degrees * 1e7
+    int32_t longitude;      // Degrees * 1e7
+    int32_t altitude;       // Centimetres
+    uint32_t utc;           // Unix time of the fix
+};
+
+// Learned per-constellation-set acquisition statistics
+#define CONSTELLATION_SET_COUNT 4
+
+struct ConstellationStats {
+    uint32_t ttffPermille;  // EWMA of TTFF relative to the expected TTFF for the start type
+    uint16_t hdop;          // EWMA of accepted HDOP * 100
+    uint16_t trials;        // Fix attempts (saturating)
+    uint16_t failures;      // Attempts that timed out (saturating)
+};
+
+struct ConstellationRecord {
+    uint8_t current;        // Set in use
+    int32_t anchorLat;      // Degrees * 1e7 where the statistics were learned
+    int32_t anchorLon;
+    ConstellationStats sets[CONSTELLATION_SET_COUNT];
+};
+
+// OTAA join schedule, kept across resets
+struct JoinRecord {
+    uint32_t attempts;      // Failed attempts since the last successful join
+    uint32_t elapsedS;      // Time since the first attempt (drives the duty-cycle limit)
+    uint32_t delayMs;       // Wait before the next attempt
+};
+
+// Link statistics per uplink channel (see link_stats.h). One slot per
+// channel covers the 8 EU868/AS923 channels or the 9 of a US915 sub-band;
+// a slot per channel and DR (48 in EU868) would not fit one KV value.
+#define LINK_STATS_SLOTS        16
+#define LINK_STATS_BINS         6
+#define LINK_STATS_DRS          8       // Uplink DR0..DR7
+
+struct LinkStatsEntry {
+    uint16_t freq;          // Uplink channel in 100 kHz units (0 = unknown, e.g. TX failed early)
+    uint8_t datarate;       // DR of the last uplink
+    uint8_t used;           // Slot holds data
+    uint16_t uplinks;       // Uplinks that went out (saturating, like the counters below)
+    uint16_t downlinks;     // Downlinks received in RX1/RX2 (including bare ACKs)
+    uint16_t noAck;         // Confirmed uplinks without an ACK
+    uint16_t rxErrors;      // Downlinks lost to CRC errors
+    uint16_t txErrors;      // Uplinks that failed before or during TX
+    int16_t lastError;      // RadioLib code of the last failure
+    uint32_t airtimeMs;     // Time on air spent on this channel
+    uint16_t drUplinks[LINK_STATS_DRS]; // Uplinks that went out, per DR
+    uint16_t rssi[LINK_STATS_BINS];     // Downlink RSSI histogram
+    uint16_t snr[LINK_STATS_BINS];      // Downlink SNR histogram
+};
+
+struct LinkStatsRecord {
+    LinkStatsEntry entries[LINK_STATS_SLOTS];
+};
+
+// Keys in the KV store (never renumber: they are stored in flash)
+enum NVSKey {
+    NVS_KEY_NONCES = 1,
+    NVS_KEY_SESSION,
+    NVS_KEY_LASTFIX,
+    NVS_KEY_CONSTELLATIONS,
+    NVS_KEY_JOIN,
+    NVS_KEY_LINKSTATS
+};
+
+// Persistent storage on the internal-flash KV log (kv_store.h).
+// On the first boot after the switch from LittleFS, the old files are
+// copied over before the region is reformatted.
 class NVSStorage {
 public:
     NVSStorage();
     
-    // Initialize the file system
+    // Mount the KV store (migrating the LittleFS files if needed)
     bool begin();
     
+    // Atomic update: saves and clears in between land together or not at all
+    void beginUpdate() { kvStore.beginBatch(); }
+    bool commitUpdate() { return kvStore.commitBatch(); }
+    
+    // Flash erases ahead of need; only while the GPS is off (see KVStore)
+    bool maintain() { return initialized && kvStore.maintain(); }
+    
     // Save/load LoRaWAN nonces (DevNonce, JoinNonce, etc.)
     bool saveNonces(const uint8_t* buffer, size_t size);
     bool loadNonces(uint8_t* buffer, size_t size);
@@ -25,6 +103,24 @@ public:
     bool saveSession(const uint8_t* buffer, size_t size);
     bool loadSession(uint8_t* buffer, size_t size);
     bool hasSession();
+    void clearSession();
+    
+    // Save/load last GPS fix (for hot-start aiding)
+    bool saveLastFix(const GPSFixRecord& record);
+    bool loadLastFix(GPSFixRecord& record);
+    
+    // Save/load constellation learning state
+    bool saveConstellations(const ConstellationRecord& record);
+    bool loadConstellations(ConstellationRecord& record);
+    
+    // Save/load/clear the join schedule
+    bool saveJoinState(const JoinRecord& record);
+    bool loadJoinState(JoinRecord& record);
+    void clearJoinState();
+    
+    // Save/load link statistics
+    bool saveLinkStats(const LinkStatsRecord& record);
+    bool loadLinkStats(LinkStatsRecord& record);
     
     // Clear all stored data (force rejoin)
     void clearAll();
@@ -32,8 +128,17 @@ public:
 private:
     bool initialized;
     
+    bool save(NVSKey key, const void* data, size_t size, const __FlashStringHelper* what);
+    bool load(NVSKey key, void* data, size_t size);
+    void migrate();
+    void migrateFile(const char* path, NVSKey key);
+    
+    // LittleFS file names, only read by migrate()
     static constexpr const char* NONCES_FILE = "/lorawan_nonces";
     static constexpr const char* SESSION_FILE = "/lorawan_session";
+    static constexpr const char* LASTFIX_FILE = "/gps_lastfix";
+    static constexpr const char* CONSTELLATION_FILE = "/gps_constellation";
+    static constexpr const char* JOIN_FILE = "/lorawan_join";
 };
 
 extern NVSStorage nvsStorage;
@@ -113,3 +113,152 @@ uint8_t PayloadEncoder::encodeHDOP(double hdop) {
     
     return encoded;
 }
+
+// ============================================
+// BatchEncoder
+// ============================================
+
+BatchEncoder batchEncoder;
+
+BatchEncoder::BatchEncoder() : head(0), pointCount(0) {
+    memset(queue, 0, sizeof(queue));
+}
+
+bool BatchEncoder::add(GPSData gpsData) {
+    if (!gpsData.valid) return false;
+    
+    if (pointCount == BATCH_MAX_POINTS) {
+        // Keep the newest track, drop the oldest point
+        head = (head + 1) % BATCH_MAX_POINTS;
+        pointCount--;
+        
+        #if DEBUG_SERIAL
+        Serial.println(F("[Payload] Batch full - dropped oldest point"));
+        #endif
+    }
+    
+    BatchPoint& p = queue[(head + pointCount) % BATCH_MAX_POINTS];
+    p.lat = PayloadEncoder::encodeLatitude(gpsData.latitude);
+    p.lon = PayloadEncoder::encodeLongitude(gpsData.longitude);
+    p.alt = PayloadEncoder::encodeAltitude(gpsData.altitude);
+    p.hdop = PayloadEncoder::encodeHDOP(gpsData.hdop);
+    p.utc = gpsData.utc;
+    pointCount++;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Payload] Batched point "));
+    Serial.print(pointCount);
+    Serial.print(F("/"));
+    Serial.println(BATCH_POINTS);
+    #endif
+    
+    return true;
+}
+
+const BatchPoint& BatchEncoder::at(uint8_t index) {
+    return queue[(head + index) % BATCH_MAX_POINTS];
+}
+
+bool BatchEncoder::isReady(uint8_t maxLen) {
+    // Slow DRs of some regions (US915 DR0: 11 bytes) cannot carry the
+    // first point; keep queueing until ADR moves to a faster one
+    if (pointCount == 0 || maxLen < BATCH_HEADER_SIZE) return false;
+    if (pointCount >= BATCH_POINTS) return true;
+    
+    // Send early if one more worst-case point would not fit anyway
+    uint16_t len = BATCH_HEADER_SIZE;
+    for (uint8_t i = 1; i < pointCount; i++) {
+        len += deltaSize(at(i - 1), at(i));
+    }
+    return len + BATCH_MAX_DELTA_SIZE > maxLen;
+}
+
+uint8_t BatchEncoder::encode(uint8_t* buffer, uint8_t maxLen, uint8_t& points) {
+    points = 0;
+    if (pointCount == 0 || maxLen < BATCH_HEADER_SIZE) return 0;
+    
+    const BatchPoint& first = at(0);
+    buffer[1] = (first.utc >> 24) & 0xFF;
+    buffer[2] = (first.utc >> 16) & 0xFF;
+    buffer[3] = (first.utc >> 8) & 0xFF;
+    buffer[4] = first.utc & 0xFF;
+    buffer[5] = (first.lat >> 16) & 0xFF;
+    buffer[6] = (first.lat >> 8) & 0xFF;
+    buffer[7] = first.lat & 0xFF;
+    buffer[8] = (first.lon >> 16) & 0xFF;
+    buffer[9] = (first.lon >> 8) & 0xFF;
+    buffer[10] = first.lon & 0xFF;
+    buffer[11] = ((uint16_t)first.alt >> 8) & 0xFF;
+    buffer[12] = first.alt & 0xFF;
+    buffer[13] = first.hdop;
+    
+    uint8_t len = BATCH_HEADER_SIZE;
+    points = 1;
+    
+    while (points < pointCount) {
+        const BatchPoint& prev = at(points - 1);
+        const BatchPoint& cur = at(points);
+        if (len + deltaSize(prev, cur) > maxLen) break;
+        
+        uint32_t dt = (cur.utc && prev.utc && cur.utc > prev.utc) ? cur.utc - prev.utc : 0;
+        len += putVarint(&buffer[len], zigzag((int32_t)cur.lat - (int32_t)prev.lat));
+        len += putVarint(&buffer[len], zigzag((int32_t)cur.lon - (int32_t)prev.lon));
+        len += putVarint(&buffer[len], zigzag((int32_t)cur.alt - (int32_t)prev.alt));
+        buffer[len++] = cur.hdop;
+        len += putVarint(&buffer[len], dt);
+        points++;
+    }
+    
+    buffer[0] = points;
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Payload] Batch: "));
+    Serial.print(points);
+    Serial.print(F(" points in "));
+    Serial.print(len);
+    Serial.print(F(" bytes (vs "));
+    Serial.print(points * TTNMAPPER_PAYLOAD_SIZE);
+    Serial.println(F(" bytes in single frames)"));
+    #endif
+    
+    return len;
+}
+
+void BatchEncoder::consume(uint8_t points) {
+    if (points > pointCount) points = pointCount;
+    head = (head + points) % BATCH_MAX_POINTS;
+    pointCount -= points;
+}
+
+uint8_t BatchEncoder::deltaSize(const BatchPoint& prev, const BatchPoint& cur) {
+    uint32_t dt = (cur.utc && prev.utc && cur.utc > prev.utc) ? cur.utc - prev.utc : 0;
+    return varintSize(zigzag((int32_t)cur.lat - (int32_t)prev.lat)) +
+           varintSize(zigzag((int32_t)cur.lon - (int32_t)prev.lon)) +
+           varintSize(zigzag((int32_t)cur.alt - (int32_t)prev.alt)) +
+           1 + varintSize(dt);
+}
+
+uint32_t BatchEncoder::zigzag(int32_t value) {
+    // Map small magnitudes of either sign to small unsigned values
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+uint8_t BatchEncoder::varintSize(uint32_t value) {
+    uint8_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+uint8_t BatchEncoder::putVarint(uint8_t* buffer, uint32_t value) {
+    // LEB128: 7 bits per byte, high bit set on all but the last
+    uint8_t n = 0;
+    while (value >= 0x80) {
+        buffer[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buffer[n++] = value;
+    return n;
+}
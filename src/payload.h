@@ -29,7 +29,57 @@ private:
     uint8_t payloadBuffer[TTNMAPPER_PAYLOAD_SIZE];
 };
 
-// Global payload encoder instance
+// Batch payload format (BATCH_PORT), several fixes per uplink:
+// Byte 0:     Point count
+// Bytes 1-4:  UTC of first point (uint32, 0 if unknown)
+// Bytes 5-13: First point, TTNMapper layout above
+// Then per point, relative to the previous one:
+//   zigzag varint dLat, zigzag varint dLon (24-bit units, ~1 m),
+//   zigzag varint dAlt (m), HDOP byte, varint dt (s)
+
+#define BATCH_MAX_POINTS    16          // Queue capacity
+#define BATCH_HEADER_SIZE   (5 + TTNMAPPER_PAYLOAD_SIZE)
+#define BATCH_MAX_DELTA_SIZE (4 + 4 + 3 + 1 + 5)
+
+struct BatchPoint {
+    uint32_t lat;       // encodeLatitude()
+    uint32_t lon;       // encodeLongitude()
+    int16_t alt;        // m
+    uint8_t hdop;       // HDOP * 10
+    uint32_t utc;
+};
+
+class BatchEncoder {
+public:
+    BatchEncoder();
+    
+    // Queue a fix; the oldest point is dropped when full
+    bool add(GPSData gpsData);
+    uint8_t count() { return pointCount; }
+    
+    // True once the queued points fill a frame of maxLen bytes
+    bool isReady(uint8_t maxLen);
+    
+    // Encode as many queued points as fit in maxLen; returns frame length
+    uint8_t encode(uint8_t* buffer, uint8_t maxLen, uint8_t& points);
+    
+    // Drop points that were delivered
+    void consume(uint8_t points);
+    
+private:
+    BatchPoint queue[BATCH_MAX_POINTS];
+    uint8_t head;
+    uint8_t pointCount;
+    
+    const BatchPoint& at(uint8_t index);
+    static uint8_t putVarint(uint8_t* buffer, uint32_t value);
+    static uint32_t zigzag(int32_t value);
+    static uint8_t deltaSize(const BatchPoint& prev, const BatchPoint& cur);
+    static uint8_t varintSize(uint32_t value);
+};
+
+// Global payload encoder instances
 extern PayloadEncoder payloadEncoder;
+extern BatchEncoder batchEncoder;
 
 #endif // PAYLOAD_H
@@ -0,0 +1,163 @@
+#include "pipeline.h"
+#include "gps_power.h"
+#include "constellation.h"
+#include "flash_queue.h"
+#include "task_monitor.h"
+#include "../include/config.h"
+
+Pipeline pipeline;
+
+Pipeline::Pipeline()
+    : gpsTask(nullptr),
+      fixRequests(nullptr),
+      fixResults(nullptr),
+      gpsSlot(-1),
+      storageTask(nullptr),
+      storeRequests(nullptr),
+      storageBusy(false),
+      storageSlot(-1) {
+}
+
+void Pipeline::begin() {
+    fixRequests = xQueueCreate(1, sizeof(uint32_t));
+    fixResults = xQueueCreate(1, sizeof(FixResult));
+    if (fixRequests && fixResults &&
+        xTaskCreate(gpsTaskMain, "gps", GPS_TASK_STACK, this, TASK_PRIO_NORMAL, &gpsTask) == pdPASS) {
+        gpsSlot = taskMonitor.add(gpsTask, "gps", GPS_TASK_STACK);
+    } else {
+        gpsTask = nullptr;
+        #if DEBUG_SERIAL
+        Serial.println(F("[Pipeline] GPS task not started, acquiring inline"));
+        #endif
+    }
+    
+    #if FLASH_QUEUE_ENABLED
+    storeRequests = xQueueCreate(PIPELINE_STORAGE_DEPTH, sizeof(StoreRequest));
+    if (storeRequests &&
+        xTaskCreate(storageTaskMain, "storage", STORAGE_TASK_STACK, this, TASK_PRIO_LOW, &storageTask) == pdPASS) {
+        storageSlot = taskMonitor.add(storageTask, "storage", STORAGE_TASK_STACK);
+    } else {
+        storageTask = nullptr;
+        #if DEBUG_SERIAL
+        Serial.println(F("[Pipeline] Storage task not started, writing inline"));
+        #endif
+    }
+    #endif
+}
+
+void Pipeline::requestFix(uint32_t timeoutMs) {
+    if (gpsTask == nullptr) {
+        // Inline: the attempt runs now and waitForFix() collects it
+        FixResult result;
+        acquire(timeoutMs, result);
+        if (fixResults) xQueueOverwrite(fixResults, &result);
+        return;
+    }
+    
+    xQueueOverwrite(fixRequests, &timeoutMs);
+}
+
+bool Pipeline::waitForFix(FixResult& result) {
+    // No deadline of our own: the attempt is bounded by its fix timeout,
+    // and the wake-up and profile switch in front of it vary too much to
+    // guess a margin. Returning early would let the caller put the GPS to
+    // sleep while the task still talks to it.
+    if (fixResults == nullptr || xQueueReceive(fixResults, &result, portMAX_DELAY) != pdTRUE) {
+        result.valid = false;
+        return false;
+    }
+    return result.valid;
+}
+
+void Pipeline::acquire(uint32_t timeoutMs, FixResult& result) {
+    // Wake up GPS from whatever state the scheduler left it in
+    gpsPower.leave();
+    delay(100);
+    
+    // Constellation set for this attempt (learned, occasionally explored)
+    if (constellations.select()) {
+        gpsModule.applyConstellations();
+    }
+    
+    uint32_t expectedMs = gpsPower.getExpectedTTFF(gpsPower.getPendingStart());
+    result.valid = gpsModule.waitForFix(timeoutMs);
+    if (result.valid) {
+        result.data = gpsModule.getData();
+        constellations.recordFix(gpsModule.getTimeToAccept(), expectedMs, result.data);
+        gpsPower.recordFix();
+    } else {
+        memset(&result.data, 0, sizeof(result.data));
+        constellations.recordTimeout(timeoutMs, expectedMs);
+        gpsPower.recordTimeout();
+    }
+}
+
+void Pipeline::gpsTaskMain(void* arg) {
+    Pipeline* self = (Pipeline*)arg;
+    uint32_t timeoutMs;
+    FixResult result;
+    
+    for (;;) {
+        xQueueReceive(self->fixRequests, &timeoutMs, portMAX_DELAY);
+        
+        taskMonitor.busyBegin(self->gpsSlot);
+        self->acquire(timeoutMs, result);
+        taskMonitor.busyEnd(self->gpsSlot);
+        
+        xQueueOverwrite(self->fixResults, &result);
+    }
+}
+
+bool Pipeline::storeFix(const uint8_t* payload, uint32_t utc) {
+    StoreRequest request;
+    memcpy(request.payload, payload, TTNMAPPER_PAYLOAD_SIZE);
+    request.utc = utc;
+    
+    if (storageTask == nullptr) {
+        store(request);
+        return true;
+    }
+    
+    if (xQueueSend(storeRequests, &request, 0) != pdTRUE) {
+        #if DEBUG_SERIAL
+        Serial.println(F("[Pipeline] Storage queue full, fix dropped"));
+        #endif
+        return false;
+    }
+    return true;
+}
+
+bool Pipeline::waitForStorage(uint32_t timeoutMs) {
+    if (storageTask == nullptr) return true;
+    
+    uint32_t start = millis();
+    while (uxQueueMessagesWaiting(storeRequests) > 0 || storageBusy) {
+        if (millis() - start >= timeoutMs) return false;
+        delay(10);
+    }
+    return true;
+}
+
+void Pipeline::store(const StoreRequest& request) {
+    #if FLASH_QUEUE_ENABLED
+    flashQueue.push(request.payload, request.utc);
+    #endif
+}
+
+void Pipeline::storageTaskMain(void* arg) {
+    Pipeline* self = (Pipeline*)arg;
+    StoreRequest request;
+    
+    for (;;) {
+        // Peek first, so waitForStorage() never sees an empty queue and an idle task mid-write
+        xQueuePeek(self->storeRequests, &request, portMAX_DELAY);
+        self->storageBusy = true;
+        xQueueReceive(self->storeRequests, &request, 0);
+        
+        taskMonitor.busyBegin(self->storageSlot);
+        self->store(request);
+        taskMonitor.busyEnd(self->storageSlot);
+        
+        self->storageBusy = false;
+    }
+}
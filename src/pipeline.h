@@ -0,0 +1,66 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <Arduino.h>
+#include "gps.h"
+#include "payload.h"
+
+#define PIPELINE_STORAGE_DEPTH      4       // Fixes waiting for the QSPI flash
+
+// Outcome of one fix attempt
+struct FixResult {
+    bool valid;
+    GPSData data;
+};
+
+// Failed uplink waiting to be written to the store-and-forward queue
+struct StoreRequest {
+    uint8_t payload[TTNMAPPER_PAYLOAD_SIZE];
+    uint32_t utc;
+};
+
+// Worker tasks behind the state machine, fed through bounded queues.
+// The GPS task runs one fix attempt per request (wake, constellation set,
+// waitForFix, learning statistics), so the loop task can queue the e-paper
+// refresh while the receiver warms up. The storage task writes failed
+// fixes to the QSPI flash queue without holding up the next cycle.
+// The radio (lora.cpp) and the display (display.cpp) own their tasks.
+class Pipeline {
+public:
+    Pipeline();
+    
+    // Create queues and tasks; without a task the calls run inline
+    void begin();
+    
+    // GPS acquisition: start an attempt, then collect its result.
+    // waitForFix() returns only once the attempt is over, so the GPS (its
+    // UART and power state) belongs to the caller again.
+    void requestFix(uint32_t timeoutMs);
+    bool waitForFix(FixResult& result);
+    
+    // Store-and-forward writes
+    bool storeFix(const uint8_t* payload, uint32_t utc);
+    bool waitForStorage(uint32_t timeoutMs);    // Until queued writes are on flash
+    
+private:
+    TaskHandle_t gpsTask;
+    QueueHandle_t fixRequests;      // uint32_t timeout, depth 1
+    QueueHandle_t fixResults;       // FixResult, depth 1
+    int8_t gpsSlot;
+    
+    TaskHandle_t storageTask;
+    QueueHandle_t storeRequests;    // StoreRequest, depth PIPELINE_STORAGE_DEPTH
+    volatile bool storageBusy;
+    int8_t storageSlot;
+    
+    void acquire(uint32_t timeoutMs, FixResult& result);
+    void store(const StoreRequest& request);
+    
+    static void gpsTaskMain(void* arg);
+    static void storageTaskMain(void* arg);
+};
+
+// Global pipeline instance
+extern Pipeline pipeline;
+
+#endif // PIPELINE_H
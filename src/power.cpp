@@ -0,0 +1,236 @@
+#include "power.h"
+#include "timebase.h"
+#include "../include/pins.h"
+#include "../include/config.h"
+
+PowerManager power;
+
+// Domains a domain needs while it is up (POWER_DOMAIN_COUNT = none)
+static const PowerDomain parents[POWER_DOMAIN_COUNT][2] = {
+    { POWER_DOMAIN_COUNT, POWER_DOMAIN_COUNT },     // RAIL
+    { POWER_RAIL,         POWER_SPIM_RADIO },       // RADIO
+    { POWER_RAIL,         POWER_DOMAIN_COUNT },     // GPS
+    { POWER_RAIL,         POWER_SPIM_EPD },         // EPD
+    { POWER_DOMAIN_COUNT, POWER_DOMAIN_COUNT },     // UARTE
+    { POWER_DOMAIN_COUNT, POWER_DOMAIN_COUNT },     // SPIM_RADIO
+    { POWER_DOMAIN_COUNT, POWER_DOMAIN_COUNT },     // SPIM_EPD
+    { POWER_DOMAIN_COUNT, POWER_DOMAIN_COUNT },     // SAADC
+};
+
+static uint64_t monotonicMs() {
+    // RTC2 ticks keep counting through sleep
+    return timebase.ticks() * 1000 / TIMEBASE_HZ;
+}
+
+PowerManager::PowerManager()
+    : totalMs(0),
+      totalSleepMs(0),
+      lastUpdate(0),
+      sleeping(false),
+      mutex(nullptr) {
+    for (uint8_t i = 0; i < POWER_DOMAIN_COUNT; i++) {
+        refs[i] = 0;
+        hooks[i] = nullptr;
+        onMs[i] = 0;
+        sleepOnMs[i] = 0;
+    }
+}
+
+void PowerManager::begin() {
+    // On-time is counted in RTC2 ticks: timebase.begin() must have run
+    mutex = xSemaphoreCreateMutex();
+    lastUpdate = monotonicMs();
+    
+    // DC/DC instead of LDO where the board has the inductors. The SoftDevice
+    // is not enabled in this firmware, so the registers are written directly.
+    #if POWER_DCDC_REG0
+    NRF_POWER->DCDCEN0 = 1;
+    #endif
+    #if POWER_DCDC_REG1
+    NRF_POWER->DCDCEN = 1;
+    #endif
+    
+    // The rail comes up with its first user
+    pinMode(PIN_POWER_EN, OUTPUT);
+    digitalWrite(PIN_POWER_EN, LOW);
+    
+    #if DEBUG_SERIAL
+    Serial.print(F("[Power] DC/DC REG0 "));
+    Serial.print(POWER_DCDC_REG0 ? F("on") : F("off"));
+    Serial.print(F(", REG1 "));
+    Serial.println(POWER_DCDC_REG1 ? F("on") : F("off"));
+    #endif
+}
+
+void PowerManager::setHook(PowerDomain domain, PowerHook hook) {
+    hooks[domain] = hook;
+}
+
+void PowerManager::acquire(PowerDomain domain) {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    acquireLocked(domain);
+    if (mutex) xSemaphoreGive(mutex);
+}
+
+void PowerManager::release(PowerDomain domain) {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    releaseLocked(domain);
+    if (mutex) xSemaphoreGive(mutex);
+}
+
+void PowerManager::acquireLocked(PowerDomain domain) {
+    if (refs[domain]++ > 0) return;
+    
+    for (uint8_t i = 0; i < 2; i++) {
+        if (parents[domain][i] != POWER_DOMAIN_COUNT) acquireLocked(parents[domain][i]);
+    }
+    switchDomain(domain, true);
+}
+
+void PowerManager::releaseLocked(PowerDomain domain) {
+    if (refs[domain] == 0) {
+        #if DEBUG_SERIAL
+        Serial.print(F("[Power] Unbalanced release of "));
+        Serial.println(domainName(domain));
+        #endif
+        return;
+    }
+    if (--refs[domain] > 0) return;
+    
+    switchDomain(domain, false);
+    for (uint8_t i = 0; i < 2; i++) {
+        if (parents[domain][i] != POWER_DOMAIN_COUNT) releaseLocked(parents[domain][i]);
+    }
+}
+
+void PowerManager::switchDomain(PowerDomain domain, bool on) {
+    // Devices go to sleep while their bus/supply is still up
+    if (!on && hooks[domain]) hooks[domain](false);
+    
+    switch (domain) {
+        case POWER_RAIL:
+            digitalWrite(PIN_POWER_EN, on ? HIGH : LOW);
+            if (on) delay(POWER_RAIL_SETTLE_MS);
+            break;
+        case POWER_SPIM_RADIO:
+            // SPIClass keeps the pin and frequency setup; only ENABLE toggles
+            NRF_SPIM3->ENABLE = on ? SPIM_ENABLE_ENABLE_Enabled : SPIM_ENABLE_ENABLE_Disabled;
+            if (!on) {
+                // nRF52840 anomaly 195: SPIM3 keeps drawing current after disable
+                *(volatile uint32_t*)0x4002F004 = 1;
+            }
+            break;
+        case POWER_SPIM_EPD:
+            NRF_SPIM2->ENABLE = on ? SPIM_ENABLE_ENABLE_Enabled : SPIM_ENABLE_ENABLE_Disabled;
+            break;
+        default:
+            // The core's analogRead() and GPSUart enable their own peripherals
+            break;
+    }
+    
+    if (on && hooks[domain]) hooks[domain](true);
+}
+
+void PowerManager::update() {
+    uint64_t now = monotonicMs();
+    uint64_t elapsed = now - lastUpdate;
+    lastUpdate = now;
+    
+    totalMs += elapsed;
+    if (sleeping) totalSleepMs += elapsed;
+    for (uint8_t i = 0; i < POWER_DOMAIN_COUNT; i++) {
+        if (refs[i] == 0) continue;
+        onMs[i] += elapsed;
+        if (sleeping) sleepOnMs[i] += elapsed;
+    }
+}
+
+void PowerManager::sleepBegin() {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    sleeping = true;
+    
+    // Anything still up here burns current for the whole sleep
+    #if DEBUG_SERIAL
+    Serial.print(F("[Power] Sleeping with"));
+    bool any = false;
+    for (uint8_t i = 0; i < POWER_DOMAIN_COUNT; i++) {
+        if (refs[i] == 0) continue;
+        Serial.print(' ');
+        Serial.print(domainName((PowerDomain)i));
+        any = true;
+    }
+    Serial.println(any ? F("") : F(" nothing on"));
+    #endif
+    
+    if (mutex) xSemaphoreGive(mutex);
+}
+
+void PowerManager::sleepEnd() {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    sleeping = false;
+    if (mutex) xSemaphoreGive(mutex);
+}
+
+uint32_t PowerManager::getOnMs(PowerDomain domain) {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    uint32_t ms = (uint32_t)onMs[domain];
+    if (mutex) xSemaphoreGive(mutex);
+    return ms;
+}
+
+uint32_t PowerManager::getSleepOnMs(PowerDomain domain) {
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    uint32_t ms = (uint32_t)sleepOnMs[domain];
+    if (mutex) xSemaphoreGive(mutex);
+    return ms;
+}
+
+void PowerManager::logStats() {
+    #if DEBUG_SERIAL
+    if (mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    update();
+    
+    // On-time per domain: total and during sleep, in seconds and percent
+    Serial.print(F("[Power] Uptime "));
+    Serial.print((uint32_t)(totalMs / 1000));
+    Serial.print(F(" s, asleep "));
+    Serial.print((uint32_t)(totalSleepMs / 1000));
+    Serial.println(F(" s"));
+    for (uint8_t i = 0; i < POWER_DOMAIN_COUNT; i++) {
+        Serial.print(F("[Power]   "));
+        Serial.print(domainName((PowerDomain)i));
+        Serial.print(F(": on "));
+        Serial.print((uint32_t)(onMs[i] / 1000));
+        Serial.print(F(" s ("));
+        Serial.print(totalMs ? (uint32_t)(onMs[i] * 100 / totalMs) : 0);
+        Serial.print(F("%), in sleep "));
+        Serial.print((uint32_t)(sleepOnMs[i] / 1000));
+        Serial.print(F(" s ("));
+        Serial.print(totalSleepMs ? (uint32_t)(sleepOnMs[i] * 100 / totalSleepMs) : 0);
+        Serial.print(F("%), refs "));
+        Serial.println(refs[i]);
+    }
+    
+    if (mutex) xSemaphoreGive(mutex);
+    #endif
+}
+
+const char* PowerManager::domainName(PowerDomain domain) {
+    switch (domain) {
+        case POWER_RAIL:        return "RAIL";
+        case POWER_RADIO:       return "RADIO";
+        case POWER_GPS:         return "GPS";
+        case POWER_EPD:         return "EPD";
+        case POWER_UARTE:       return "UARTE1";
+        case POWER_SPIM_RADIO:  return "SPIM3";
+        case POWER_SPIM_EPD:    return "SPIM2";
+        case POWER_SAADC:       return "SAADC";
+        default:                return "?";
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+
+// Power domains, each switched on by its first user and off by its last
+enum PowerDomain {
+    POWER_RAIL,             // PIN_POWER_EN 3V3 peripheral rail
+    POWER_RADIO,            // SX1262 awake (off = warm sleep, config retained)
+    POWER_GPS,              // L76K tracking (off = standby/backup, see GPSPowerScheduler)
+    POWER_EPD,              // E-paper controller awake (off = hibernate)
+    POWER_UARTE,            // UARTE1 (GPS), enabled by GPSUart
+    POWER_SPIM_RADIO,       // SPIM3 (SX1262 bus)
+    POWER_SPIM_EPD,         // SPIM2 (e-paper bus)
+    POWER_SAADC,            // SAADC (battery measurement)
+    POWER_DOMAIN_COUNT
+};
+
+// Switches a domain's device; called with on = true after the domain's
+// parents are up, and with on = false before they go down. Runs under the
+// manager's lock, so it must not acquire or release domains itself.
+typedef void (*PowerHook)(bool on);
+
+// Central owner of the power domains.
+// Modules acquire() what they are about to use and release() it after; the
+// domain (and the domains it depends on) stays up while any reference is
+// held. The manager drives the rail GPIO and the SPIM enables itself, runs
+// the registered hook for device domains, and accumulates each domain's
+// on-time, separately for time spent in the sleep phase of the duty cycle.
+class PowerManager {
+public:
+    PowerManager();
+    
+    // Initialization (regulators, rail pin)
+    void begin();
+    
+    // Reference counting
+    void acquire(PowerDomain domain);
+    void release(PowerDomain domain);
+    void setHook(PowerDomain domain, PowerHook hook);
+    bool isOn(PowerDomain domain) { return refs[domain] > 0; }
+    uint8_t getRefs(PowerDomain domain) { return refs[domain]; }
+    
+    // Sleep phase markers (on-time inside them is what costs battery)
+    void sleepBegin();
+    void sleepEnd();
+    
+    // Accounting
+    uint32_t getOnMs(PowerDomain domain);
+    uint32_t getSleepOnMs(PowerDomain domain);
+    void logStats();
+    
+    static const char* domainName(PowerDomain domain);
+    
+private:
+    uint8_t refs[POWER_DOMAIN_COUNT];
+    PowerHook hooks[POWER_DOMAIN_COUNT];
+    uint64_t onMs[POWER_DOMAIN_COUNT];
+    uint64_t sleepOnMs[POWER_DOMAIN_COUNT];
+    uint64_t totalMs;
+    uint64_t totalSleepMs;
+    uint64_t lastUpdate;
+    bool sleeping;
+    SemaphoreHandle_t mutex;
+    
+    void update();
+    void switchDomain(PowerDomain domain, bool on);
+    void acquireLocked(PowerDomain domain);
+    void releaseLocked(PowerDomain domain);
+};
+
+// Global power manager instance
+extern PowerManager power;
+
+#endif // POWER_H
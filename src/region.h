@@ -0,0 +1,94 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <Arduino.h>
+#include <RadioLib.h>
+
+// Compile-time LoRaWAN band plan, selected by one REGION_* build flag
+// (platformio.ini). Only the selected region's traits exist in the image:
+// the members are constants and the per-DR tables are constexpr functions,
+// so lookups with a constant DR fold away and the others compile to a
+// compare chain. Values follow LoRaWAN Regional Parameters RP002-1.0.3;
+// maxPayload() is the application payload N (no FOpts) per uplink DR.
+// RX1/RX2 parameters are left to RadioLib's band() and the join accept.
+#if !defined(REGION_EU868) && !defined(REGION_US915) && !defined(REGION_AS923)
+#define REGION_EU868
+#endif
+
+#if defined(REGION_US915)
+
+// US915, TTN sub-band 2 (903.9-905.3 MHz + 904.6 MHz @ 500 kHz)
+struct Region {
+    static const LoRaWANBand_t* band() { return &US915; }
+    static constexpr const char* name = "US915";
+    static constexpr uint8_t subBand = 2;
+    static constexpr float frequencyMHz = 903.9f;       // First sub-band channel (RadioLib hops per uplink)
+    
+    // Uplink DRs: DR0..DR3 = SF10..SF7 @ 125 kHz, DR4 = SF8 @ 500 kHz
+    static constexpr uint8_t drMax = 4;
+    static constexpr uint8_t drDefault = 3;             // Fastest 125 kHz DR
+    static constexpr uint8_t drRobust = 0;
+    static constexpr uint8_t spreadingFactor(uint8_t dr) { return dr <= 3 ? 10 - dr : 8; }
+    static constexpr uint16_t bandwidthKHz(uint8_t dr) { return dr == 4 ? 500 : 125; }
+    static constexpr uint8_t maxPayload(uint8_t dr) { return dr == 0 ? 11 : dr == 1 ? 53 : dr == 2 ? 125 : 242; }
+    static constexpr uint8_t maxPayloadAll = 242;
+    
+    // FCC 15.247: no duty cycle, 400 ms dwell time per uplink
+    static constexpr int8_t txPowerMax = 30;            // dBm EIRP
+    static constexpr int8_t txPowerDefault = 20;
+    static constexpr uint32_t dutyCycleMsPerHour = 0;   // 0 = no duty-cycle limit
+    static constexpr uint16_t dwellTimeMs = 400;
+};
+
+#elif defined(REGION_AS923)
+
+// AS923-1 (923.2 / 923.4 MHz default channels), uplink dwell time off
+struct Region {
+    static const LoRaWANBand_t* band() { return &AS923; }
+    static constexpr const char* name = "AS923";
+    static constexpr uint8_t subBand = 0;
+    static constexpr float frequencyMHz = 923.2f;
+    
+    // Uplink DRs: DR0..DR5 = SF12..SF7 @ 125 kHz, DR6 = SF7 @ 250 kHz
+    static constexpr uint8_t drMax = 6;
+    static constexpr uint8_t drDefault = 5;
+    static constexpr uint8_t drRobust = 0;
+    static constexpr uint8_t spreadingFactor(uint8_t dr) { return dr <= 5 ? 12 - dr : 7; }
+    static constexpr uint16_t bandwidthKHz(uint8_t dr) { return dr == 6 ? 250 : 125; }
+    static constexpr uint8_t maxPayload(uint8_t dr) { return dr <= 2 ? 51 : dr == 3 ? 115 : 242; }
+    static constexpr uint8_t maxPayloadAll = 242;
+    
+    // Rules differ per country; 1% is the strictest common limit
+    static constexpr int8_t txPowerMax = 16;
+    static constexpr int8_t txPowerDefault = 14;
+    static constexpr uint32_t dutyCycleMsPerHour = 36000;   // 1%
+    static constexpr uint16_t dwellTimeMs = 0;          // 0 = no dwell-time limit
+};
+
+#else
+
+// EU868 (ETSI EN 300 220, 1% duty cycle on the default sub-band)
+struct Region {
+    static const LoRaWANBand_t* band() { return &EU868; }
+    static constexpr const char* name = "EU868";
+    static constexpr uint8_t subBand = 0;
+    static constexpr float frequencyMHz = 868.1f;
+    
+    // Uplink DRs: DR0..DR5 = SF12..SF7 @ 125 kHz, DR6 = SF7 @ 250 kHz
+    static constexpr uint8_t drMax = 6;
+    static constexpr uint8_t drDefault = 5;
+    static constexpr uint8_t drRobust = 0;
+    static constexpr uint8_t spreadingFactor(uint8_t dr) { return dr <= 5 ? 12 - dr : 7; }
+    static constexpr uint16_t bandwidthKHz(uint8_t dr) { return dr == 6 ? 250 : 125; }
+    static constexpr uint8_t maxPayload(uint8_t dr) { return dr <= 2 ? 51 : dr == 3 ? 115 : 242; }
+    static constexpr uint8_t maxPayloadAll = 242;
+    
+    static constexpr int8_t txPowerMax = 16;
+    static constexpr int8_t txPowerDefault = 14;
+    static constexpr uint32_t dutyCycleMsPerHour = 36000;   // 1%
+    static constexpr uint16_t dwellTimeMs = 0;
+};
+
+#endif
+
+#endif // REGION_H
@@ -0,0 +1,156 @@
+#include "sleep.h"
+#include "timebase.h"
+#include "../include/pins.h"
+#include "../include/config.h"
+
+SleepService sleepService;
+
+// FPSCR cumulative exception flags (IOC, DZC, OFC, UFC, IXC, IDC)
+#define FPSCR_EXCEPTION_MASK    0x0000009F
+
+static uint64_t monotonicMs() {
+    // RTC2 ticks keep counting through sleep
+    return timebase.ticks() * 1000 / TIMEBASE_HZ;
+}
+
+SleepService::SleepService()
+    : wakeSem(nullptr),
+      pendingSource(WAKE_TIMER),
+      sleeping(false),
+      sleeps(0),
+      requestedMs(0),
+      sleptMs(0),
+      startMs(0) {
+    for (uint8_t i = 0; i < WAKE_SOURCE_COUNT; i++) {
+        wakes[i] = 0;
+    }
+}
+
+void SleepService::begin() {
+    wakeSem = xSemaphoreCreateBinary();
+    startMs = monotonicMs();
+    
+    // DIO1 is hooked in LoRaHal::onDio1(); the button is ours
+    #if SLEEP_WAKE_BUTTON
+    pinMode(USER_BUTTON_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(USER_BUTTON_PIN), onButton, FALLING);
+    #endif
+}
+
+void SleepService::onButton() {
+    sleepService.wakeFromISR(WAKE_BUTTON);
+}
+
+void SleepService::wakeFromISR(WakeSource source) {
+    if (!sleeping || wakeSem == nullptr) return;
+    
+    pendingSource = source;
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(wakeSem, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void SleepService::clearFpuExceptions() {
+    // nRF52 FPU errata: a pending FPU interrupt wakes WFE at once, so the
+    // CPU would spin through the sleep at full current
+    __set_FPSCR(__get_FPSCR() & ~FPSCR_EXCEPTION_MASK);
+    (void)__get_FPSCR();
+    NVIC_ClearPendingIRQ(FPU_IRQn);
+}
+
+void SleepService::systemOff() {
+    #if DEBUG_SERIAL
+    Serial.println(F("[Sleep] System OFF"));
+    Serial.flush();
+    #endif
+    
+    // Only a pin DETECT signal ends System OFF: sense low on the PCF8563
+    // INT (open drain) and, if enabled, the button instead of its interrupt
+    pinMode(RTC_INT_PIN, INPUT_PULLUP_SENSE);
+    #if SLEEP_WAKE_BUTTON
+    detachInterrupt(digitalPinToInterrupt(USER_BUTTON_PIN));
+    pinMode(USER_BUTTON_PIN, INPUT_PULLUP_SENSE);
+    #endif
+    
+    clearFpuExceptions();
+    NRF_POWER->SYSTEMOFF = 1;
+    
+    // Entering System OFF takes a moment; nothing runs after it
+    __DSB();
+    for (;;) {
+        __WFE();
+    }
+}
+
+WakeSource SleepService::sleep(uint32_t ms) {
+    if (ms == 0 || wakeSem == nullptr) {
+        if (ms > 0) delay(ms);
+        return WAKE_TIMER;
+    }
+    
+    clearFpuExceptions();
+    
+    // A wake that came in while awake must not cut this sleep short
+    xSemaphoreTake(wakeSem, 0);
+    pendingSource = WAKE_TIMER;
+    sleeping = true;
+    
+    uint64_t start = monotonicMs();
+    bool woken = xSemaphoreTake(wakeSem, pdMS_TO_TICKS(ms)) == pdTRUE;
+    sleeping = false;
+    uint64_t slept = monotonicMs() - start;
+    
+    WakeSource source = woken ? pendingSource : WAKE_TIMER;
+    sleeps++;
+    wakes[source]++;
+    requestedMs += ms;
+    sleptMs += slept;
+    
+    #if DEBUG_SERIAL
+    if (source != WAKE_TIMER) {
+        Serial.print(F("[Sleep] Woken by "));
+        Serial.print(sourceName(source));
+        Serial.print(F(" after "));
+        Serial.print((uint32_t)slept);
+        Serial.print(F(" of "));
+        Serial.print(ms);
+        Serial.println(F(" ms"));
+    }
+    #endif
+    
+    return source;
+}
+
+void SleepService::logStats() {
+    #if DEBUG_SERIAL
+    uint64_t uptime = monotonicMs() - startMs;
+    
+    Serial.print(F("[Sleep] Residency "));
+    Serial.print(uptime ? (uint32_t)(sleptMs * 1000 / uptime) / 10.0 : 0.0, 1);
+    Serial.print(F("% ("));
+    Serial.print((uint32_t)(sleptMs / 1000));
+    Serial.print(F(" of "));
+    Serial.print((uint32_t)(uptime / 1000));
+    Serial.print(F(" s, "));
+    Serial.print(sleeps);
+    Serial.print(F(" sleeps, "));
+    Serial.print(requestedMs ? (uint32_t)(sleptMs * 100 / requestedMs) : 0);
+    Serial.print(F("% of requested), wakes:"));
+    for (uint8_t i = 0; i < WAKE_SOURCE_COUNT; i++) {
+        Serial.print(' ');
+        Serial.print(sourceName((WakeSource)i));
+        Serial.print('=');
+        Serial.print(wakes[i]);
+    }
+    Serial.println();
+    #endif
+}
+
+const char* SleepService::sourceName(WakeSource source) {
+    switch (source) {
+        case WAKE_TIMER:    return "RTC";
+        case WAKE_RADIO:    return "DIO1";
+        case WAKE_BUTTON:   return "BUTTON";
+        default:            return "?";
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#include <Arduino.h>
+
+// What ended a sleep
+enum WakeSource {
+    WAKE_TIMER,             // Requested time elapsed (RTC1 tick)
+    WAKE_RADIO,             // SX1262 DIO1
+    WAKE_BUTTON,            // User button
+    WAKE_SOURCE_COUNT
+};
+
+// System ON sleep between cycles.
+// The calling task blocks on a semaphore with the sleep time as timeout.
+// With every other task blocked as well, the core's tickless idle stops
+// the RTC1 tick and the CPU waits in WFE until the timeout or a registered
+// wake interrupt (DIO1, button) gives the semaphore. Before blocking,
+// pending FPU exceptions are cleared, because they would keep the CPU from
+// sleeping. Time spent asleep and the wake sources are recorded on the RTC2
+// clock as residency statistics.
+class SleepService {
+public:
+    SleepService();
+    
+    // Register the wake interrupts
+    void begin();
+    
+    // Sleep up to ms; returns the source that ended the sleep
+    WakeSource sleep(uint32_t ms);
+    
+    // Called from the ISRs of wake sources (ignored while awake)
+    void wakeFromISR(WakeSource source);
+    
+    // System OFF until RTC_INT_PIN (or the button) is pulled low. The wake
+    // is a reset through setup(), so this does not return.
+    void systemOff();
+    
+    // Residency: share of uptime spent in sleep()
+    uint32_t getSleptMs() { return (uint32_t)sleptMs; }
+    void logStats();
+    
+    static const char* sourceName(WakeSource source);
+    
+private:
+    SemaphoreHandle_t wakeSem;
+    volatile WakeSource pendingSource;
+    volatile bool sleeping;
+    
+    uint32_t sleeps;
+    uint32_t wakes[WAKE_SOURCE_COUNT];
+    uint64_t requestedMs;           // Asked for
+    uint64_t sleptMs;               // Actually spent asleep
+    uint64_t startMs;
+    
+    static void onButton();
+    static void clearFpuExceptions();
+};
+
+// Global sleep service instance
+extern SleepService sleepService;
+
+#endif // SLEEP_H
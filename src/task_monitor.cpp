@@ -0,0 +1,88 @@
+#include "task_monitor.h"
+#include "timebase.h"
+#include "../include/config.h"
+
+TaskMonitor taskMonitor;
+
+static uint64_t monotonicMs() {
+    // RTC2 ticks keep counting through sleep
+    return timebase.ticks() * 1000 / TIMEBASE_HZ;
+}
+
+TaskMonitor::TaskMonitor() : count(0), startMs(0) {
+    memset(tasks, 0, sizeof(tasks));
+}
+
+int8_t TaskMonitor::add(TaskHandle_t handle, const char* name, uint32_t stackWords) {
+    if (handle == nullptr || count >= TASK_MONITOR_SLOTS) return -1;
+    
+    taskENTER_CRITICAL();
+    if (count == 0) startMs = monotonicMs();
+    int8_t slot = count++;
+    tasks[slot].handle = handle;
+    tasks[slot].name = name;
+    tasks[slot].stackWords = stackWords;
+    taskEXIT_CRITICAL();
+    
+    return slot;
+}
+
+void TaskMonitor::busyBegin(int8_t slot) {
+    if (slot < 0) return;
+    
+    uint64_t now = monotonicMs();
+    taskENTER_CRITICAL();
+    tasks[slot].busySince = now;
+    tasks[slot].busy = true;
+    taskEXIT_CRITICAL();
+}
+
+void TaskMonitor::busyEnd(int8_t slot) {
+    if (slot < 0 || !tasks[slot].busy) return;
+    
+    // Only the owning task writes its entry; logStats() reads a snapshot
+    uint64_t now = monotonicMs();
+    taskENTER_CRITICAL();
+    tasks[slot].busyMs += now - tasks[slot].busySince;
+    tasks[slot].busy = false;
+    tasks[slot].runs++;
+    taskEXIT_CRITICAL();
+}
+
+void TaskMonitor::logStats() {
+    #if DEBUG_SERIAL
+    uint64_t now = monotonicMs();
+    uint64_t elapsed = now - startMs;
+    
+    for (uint8_t i = 0; i < count; i++) {
+        taskENTER_CRITICAL();
+        Entry e = tasks[i];
+        taskEXIT_CRITICAL();
+        
+        uint64_t busy = e.busyMs + (e.busy ? now - e.busySince : 0);
+        UBaseType_t freeWords = uxTaskGetStackHighWaterMark(e.handle);
+        
+        Serial.print(F("[Tasks] "));
+        Serial.print(e.name);
+        Serial.print(F(": stack "));
+        if (e.stackWords) {
+            Serial.print(e.stackWords - freeWords);
+            Serial.print(F("/"));
+            Serial.print(e.stackWords);
+            Serial.print(F(" words peak, "));
+        }
+        Serial.print(freeWords);
+        Serial.print(F(" words never used"));
+        if (e.runs > 0 || e.busy) {
+            Serial.print(F(", busy "));
+            Serial.print((uint32_t)(busy / 1000));
+            Serial.print(F(" s ("));
+            Serial.print(elapsed ? (uint32_t)(busy * 1000 / elapsed) / 10.0 : 0.0, 1);
+            Serial.print(F("%) over "));
+            Serial.print(e.runs);
+            Serial.print(F(" requests"));
+        }
+        Serial.println();
+    }
+    #endif
+}
@@ -0,0 +1,45 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+
+#define TASK_MONITOR_SLOTS  6           // loop, lora, gps, display, storage + one spare
+
+// Stack and run-time bookkeeping for the firmware's FreeRTOS tasks.
+// Each task registers its handle once; request-driven tasks bracket the
+// handling of one request with busyBegin()/busyEnd(), which accumulates
+// busy time on the RTC2 clock (the core builds FreeRTOS without run-time
+// stats). logStats() prints the busy share and the stack high-water mark,
+// i.e. the fewest words that were ever left free on the task's stack.
+class TaskMonitor {
+public:
+    TaskMonitor();
+    
+    // Returns the slot to pass to busyBegin()/busyEnd(), or -1 when full
+    int8_t add(TaskHandle_t handle, const char* name, uint32_t stackWords);
+    
+    void busyBegin(int8_t slot);
+    void busyEnd(int8_t slot);
+    
+    void logStats();
+    
+private:
+    struct Entry {
+        TaskHandle_t handle;
+        const char* name;
+        uint32_t stackWords;    // 0 = unknown (the core's loop task)
+        uint32_t runs;          // Requests handled
+        uint64_t busyMs;
+        uint64_t busySince;
+        bool busy;
+    };
+    
+    Entry tasks[TASK_MONITOR_SLOTS];
+    uint8_t count;
+    uint64_t startMs;
+};
+
+// Global task monitor instance
+extern TaskMonitor taskMonitor;
+
+#endif // TASK_MONITOR_H
@@ -0,0 +1,174 @@
+#include "timebase.h"
+#include "../include/pins.h"
+#include "../include/config.h"
+
+Timebase timebase;
+
+extern "C" void RTC2_IRQHandler(void) {
+    if (NRF_RTC2->EVENTS_OVRFLW) {
+        NRF_RTC2->EVENTS_OVRFLW = 0;
+        timebase.handleOverflow();
+    }
+}
+
+static void onPPS() {
+    timebase.handlePPS();
+}
+
+Timebase::Timebase()
+    : overflows(0),
+      ppsTicks(0),
+      ppsCount(0),
+      valid(false),
+      disciplined(false),
+      refTicks(0),
+      refUtc(0),
+      refUncertaintyMs(0),
+      hasAnchor(false),
+      anchorTicks(0),
+      anchorUtc(0),
+      driftPPB(0),
+      driftKnown(false) {
+}
+
+bool Timebase::begin() {
+    // RTC2 is free: RTC0 belongs to the SoftDevice, RTC1 to the FreeRTOS tick
+    NRF_RTC2->TASKS_STOP = 1;
+    NRF_RTC2->TASKS_CLEAR = 1;
+    NRF_RTC2->PRESCALER = 0;
+    NRF_RTC2->EVENTS_OVRFLW = 0;
+    NRF_RTC2->EVTENSET = RTC_EVTEN_OVRFLW_Msk;
+    NRF_RTC2->INTENSET = RTC_INTENSET_OVRFLW_Msk;
+    NVIC_SetPriority(RTC2_IRQn, 3);
+    NVIC_EnableIRQ(RTC2_IRQn);
+    NRF_RTC2->TASKS_START = 1;
+    
+    // PPS edges are captured by GPIOTE
+    pinMode(GPS_PPS_PIN, INPUT);
+    attachInterrupt(GPS_PPS_PIN, onPPS, RISING);
+    
+    #if DEBUG_SERIAL
+    Serial.println(F("[Time] RTC2 timebase started, PPS capture on P1.4"));
+    #endif
+    
+    return true;
+}
+
+uint64_t Timebase::ticks() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    
+    uint32_t ovf = overflows;
+    uint32_t counter = NRF_RTC2->COUNTER;
+    if (NRF_RTC2->EVENTS_OVRFLW) {
+        // Overflow happened but its interrupt has not run yet
+        counter = NRF_RTC2->COUNTER;
+        ovf++;
+    }
+    
+    __set_PRIMASK(primask);
+    return ((uint64_t)ovf << 24) | counter;
+}
+
+void Timebase::handlePPS() {
+    ppsTicks = ticks();
+    ppsCount++;
+}
+
+void Timebase::onGPSTime(uint32_t utc) {
+    uint64_t now = ticks();
+    
+    // The PPS interrupt writes the 64-bit edge in two halves
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t edge = ppsTicks;
+    uint32_t edges = ppsCount;
+    __set_PRIMASK(primask);
+    
+    // RMC for second N arrives a few hundred ms after the PPS edge of N
+    if (edges == 0 || now - edge >= TIMEBASE_HZ) {
+        setUTC(utc, 1000);
+        return;
+    }
+    
+    if (hasAnchor && utc - anchorUtc >= TIMEBASE_DRIFT_MIN_S) {
+        int64_t expected = (int64_t)(utc - anchorUtc) * TIMEBASE_HZ;
+        int64_t measured = (int64_t)(edge - anchorTicks);
+        int32_t ppb = (int32_t)((measured - expected) * 1000000000LL / expected);
+        driftPPB = driftKnown ? (driftPPB * 3 + ppb) / 4 : ppb;
+        driftKnown = true;
+        anchorTicks = edge;
+        anchorUtc = utc;
+    } else if (!hasAnchor) {
+        anchorTicks = edge;
+        anchorUtc = utc;
+        hasAnchor = true;
+    }
+    
+    refTicks = edge;
+    refUtc = utc;
+    refUncertaintyMs = 1;
+    valid = true;
+    disciplined = true;
+}
+
+void Timebase::setUTC(uint32_t utc, uint32_t uncertaintyMs) {
+    setUTCAt((uint64_t)utc * 1000, ticks(), uncertaintyMs);
+}
+
+void Timebase::setUTCAt(uint64_t utcMs, uint64_t atTicks, uint32_t uncertaintyMs) {
+    // Never replace a better reference with a worse one
+    if (valid && uncertaintyMs > getUncertaintyMs()) return;
+    
+    // The reference is kept on a whole second: step back to it
+    uint32_t utc = (uint32_t)(utcMs / 1000);
+    uint64_t subTicks = (utcMs % 1000) * TIMEBASE_HZ / 1000;
+    
+    bool wasValid = valid;
+    refTicks = atTicks - subTicks;
+    refUtc = utc;
+    refUncertaintyMs = uncertaintyMs;
+    valid = true;
+    disciplined = false;
+    
+    #if DEBUG_SERIAL
+    if (wasValid) return;
+    Serial.print(F("[Time] UTC set to "));
+    Serial.print(utc);
+    Serial.print(F(" (+/- "));
+    Serial.print(uncertaintyMs);
+    Serial.println(F(" ms)"));
+    #endif
+}
+
+bool Timebase::nowMs(uint64_t& utcMs) {
+    if (!valid) return false;
+    
+    uint64_t elapsedMs = (ticks() - refTicks) * 1000 / TIMEBASE_HZ;
+    int64_t correction = (int64_t)elapsedMs * driftPPB / 1000000000LL;
+    utcMs = (uint64_t)refUtc * 1000 + elapsedMs - correction;
+    return true;
+}
+
+uint32_t Timebase::nowUTC() {
+    uint64_t utcMs;
+    if (!nowMs(utcMs)) return 0;
+    return (uint32_t)(utcMs / 1000);
+}
+
+uint32_t Timebase::getUncertaintyMs() {
+    if (!valid) return 0xFFFFFFFF;
+    
+    // Residual drift after correction is assumed to be ~1 ppm
+    uint32_t elapsedS = (uint32_t)((ticks() - refTicks) / TIMEBASE_HZ);
+    uint32_t ppm = driftKnown ? 1 : TIMEBASE_CRYSTAL_PPM;
+    return refUncertaintyMs + elapsedS * ppm / 1000;
+}
+
+uint32_t Timebase::msUntilSlot(uint32_t periodMs, uint32_t offsetMs) {
+    uint64_t utcMs;
+    if (!nowMs(utcMs) || periodMs == 0) return periodMs;
+    
+    uint32_t phase = (uint32_t)((utcMs + periodMs - (offsetMs % periodMs)) % periodMs);
+    return periodMs - phase;
+}
@@ -0,0 +1,66 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <Arduino.h>
+
+// UTC timebase on RTC2 (32.768 kHz, extended to 64 bits by the overflow IRQ).
+// GPS PPS edges are timestamped in the GPIOTE interrupt; when the following
+// RMC sentence names that second, the edge becomes a reference point. Two
+// reference points at least TIMEBASE_DRIFT_MIN_S apart give the crystal
+// drift, which is then applied while the GPS is off.
+#define TIMEBASE_HZ             32768
+#define TIMEBASE_DRIFT_MIN_S    60          // Minimum span for a drift measurement
+#define TIMEBASE_CRYSTAL_PPM    20          // Uncertainty growth before drift is known
+
+class Timebase {
+public:
+    Timebase();
+    
+    // Initialization (starts RTC2 and the PPS capture)
+    bool begin();
+    
+    // Time sources
+    void onGPSTime(uint32_t utc);                   // RMC second (pairs with last PPS)
+    void setUTC(uint32_t utc, uint32_t uncertaintyMs);  // Any other source
+    void setUTCAt(uint64_t utcMs, uint64_t atTicks, uint32_t uncertaintyMs);  // Sub-second, at a past tick
+    
+    // UTC queries
+    bool isValid() { return valid; }
+    bool isDisciplined() { return disciplined; }
+    bool nowMs(uint64_t& utcMs);
+    uint32_t nowUTC();                              // Unix seconds, 0 if unknown
+    uint32_t getUncertaintyMs();
+    int32_t getDriftPPB() { return driftPPB; }
+    
+    // Milliseconds until the next UTC multiple of periodMs (shifted by offsetMs)
+    uint32_t msUntilSlot(uint32_t periodMs, uint32_t offsetMs);
+    
+    // Raw 32.768 kHz tick count
+    uint64_t ticks();
+    
+    // Called from interrupts
+    void handleOverflow() { overflows++; }
+    void handlePPS();
+
+private:
+    volatile uint32_t overflows;
+    volatile uint64_t ppsTicks;
+    volatile uint32_t ppsCount;
+    
+    bool valid;
+    bool disciplined;               // Reference came from a PPS edge
+    uint64_t refTicks;              // Tick count at refUtc
+    uint32_t refUtc;
+    uint32_t refUncertaintyMs;
+    
+    bool hasAnchor;                 // PPS reference used for drift measurement
+    uint64_t anchorTicks;
+    uint32_t anchorUtc;
+    int32_t driftPPB;               // RTC rate error, positive = runs fast
+    bool driftKnown;
+};
+
+// Global timebase instance
+extern Timebase timebase;
+
+#endif // TIMEBASE_H
@@ -5,6 +5,40 @@ function decodeUplink(input) {
   var decoded = {};
   var bytes = input.bytes;
   
+  // Replayed fixes from the flash queue (FLASH_QUEUE_PORT in config.h)
+  if (input.fPort === 3) {
+    var replayed = decodeReplay(bytes);
+    if (replayed === null) {
+      return {
+        data: {},
+        warnings: [],
+        errors: ["Invalid replay payload length: " + bytes.length]
+      };
+    }
+    return {
+      data: { points: replayed },
+      warnings: [],
+      errors: []
+    };
+  }
+  
+  // Batch frames (BATCH_PORT in config.h)
+  if (input.fPort === 2) {
+    var points = decodeBatch(bytes);
+    if (points === null) {
+      return {
+        data: {},
+        warnings: [],
+        errors: ["Malformed batch payload"]
+      };
+    }
+    return {
+      data: { points: points },
+      warnings: [],
+      errors: []
+    };
+  }
+  
   // Check payload length
   if (bytes.length !== 9) {
     return {
@@ -44,10 +78,126 @@ function decodeUplink(input) {
   };
 }
 
+// Batch format: count, UTC of first point, first point in the 9-byte
+// layout above, then per point zigzag varint dLat/dLon/dAlt, HDOP, varint dt
+function decodeBatch(bytes) {
+  if (bytes.length < 14) {
+    return null;
+  }
+  
+  var count = bytes[0];
+  var time = ((bytes[1] << 24) >>> 0) + (bytes[2] << 16) + (bytes[3] << 8) + bytes[4];
+  var lat = (bytes[5] << 16) | (bytes[6] << 8) | bytes[7];
+  var lon = (bytes[8] << 16) | (bytes[9] << 8) | bytes[10];
+  var alt = (bytes[11] << 8) | bytes[12];
+  if (alt & 0x8000) {
+    alt -= 0x10000;
+  }
+  var hdop = bytes[13];
+  var pos = 14;
+  
+  function varint() {
+    var value = 0;
+    var shift = 0;
+    while (pos < bytes.length) {
+      var b = bytes[pos++];
+      value += (b & 0x7F) * Math.pow(2, shift);
+      if (!(b & 0x80)) {
+        return value;
+      }
+      shift += 7;
+    }
+    throw new Error("truncated varint");
+  }
+  
+  function zigzag() {
+    var v = varint();
+    return (v % 2) ? -(v + 1) / 2 : v / 2;
+  }
+  
+  var points = [];
+  try {
+    for (var i = 0; i < count; i++) {
+      if (i > 0) {
+        lat += zigzag();
+        lon += zigzag();
+        alt += zigzag();
+        if (pos >= bytes.length) {
+          return null;
+        }
+        hdop = bytes[pos++];
+        var dt = varint();
+        time = time ? time + dt : 0;
+      }
+      var point = {
+        latitude: ((lat / 16777215.0) * 180.0) - 90.0,
+        longitude: ((lon / 16777215.0) * 360.0) - 180.0,
+        altitude: alt,
+        hdop: hdop / 10.0
+      };
+      if (time) {
+        point.time = new Date(time * 1000).toISOString();
+      }
+      points.push(point);
+    }
+  } catch (e) {
+    return null;
+  }
+  
+  return points;
+}
+
+// Replay format: repeated 13-byte records of UTC (uint32 seconds)
+// followed by the 9-byte layout above
+function decodeReplay(bytes) {
+  if (bytes.length === 0 || bytes.length % 13 !== 0) {
+    return null;
+  }
+  
+  var points = [];
+  for (var i = 0; i < bytes.length; i += 13) {
+    var time = ((bytes[i] << 24) >>> 0) + (bytes[i + 1] << 16) + (bytes[i + 2] << 8) + bytes[i + 3];
+    var latRaw = (bytes[i + 4] << 16) | (bytes[i + 5] << 8) | bytes[i + 6];
+    var lonRaw = (bytes[i + 7] << 16) | (bytes[i + 8] << 8) | bytes[i + 9];
+    var alt = (bytes[i + 10] << 8) | bytes[i + 11];
+    if (alt & 0x8000) {
+      alt -= 0x10000;
+    }
+    var point = {
+      latitude: ((latRaw / 16777215.0) * 180.0) - 90.0,
+      longitude: ((lonRaw / 16777215.0) * 360.0) - 180.0,
+      altitude: alt,
+      hdop: bytes[i + 12] / 10.0
+    };
+    if (time) {
+      point.time = new Date(time * 1000).toISOString();
+    }
+    points.push(point);
+  }
+  
+  return points;
+}
+
 // For TTN v2 compatibility (legacy)
 function Decoder(bytes, port) {
   var decoded = {};
   
+  if (port === 3) {
+    var replayed = decodeReplay(bytes);
+    if (replayed !== null) {
+      decoded.points = replayed;
+    }
+    return decoded;
+  }
+  
+  if (port === 2) {
+    var points = decodeBatch(bytes);
+    if (points !== null) {
+      decoded.points = points;
+    }
+    return decoded;
+  }
+  
   if (bytes.length !== 9) {
     return decoded;
   }